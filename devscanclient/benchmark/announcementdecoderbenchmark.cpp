@@ -0,0 +1,118 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <json/value.h>
+#include <json/reader.h>
+
+#include "hbm/jsonrpc/jsonrpc_defines.h"
+
+#include "devscan/announcementdecoder.h"
+#include "devscan/defines.h"
+
+using namespace hbm::devscan;
+
+/// announcements as captured from real devices
+static const char* announcements[] = {
+	// QuantumX MX440A
+	"{\"jsonrpc\":\"2.0\",\"method\":\"announce\",\"params\":{\"apiVersion\":\"1.0\",\"device\":{\"familyType\":\"QuantumX\","
+	"\"firmwareVersion\":\"4.1.3.21715\",\"hardwareId\":\"MX440A_R0\",\"name\":\"TA02_MX440A\",\"type\":\"MX440A\",\"uuid\":\"0009E5001C49\"},"
+	"\"expiration\":15,\"netSettings\":{\"defaultGateway\":{\"ipv4Address\":\"172.19.169.254\"},\"interface\":{\"configurationMethod\":\"dhcp\","
+	"\"description\":\"ethernet front side\",\"ipv4\":[{\"address\":\"172.19.191.121\",\"netmask\":\"255.255.0.0\"},"
+	"{\"address\":\"169.254.80.58\",\"netmask\":\"255.255.0.0\"}],\"ipv6\":[{\"address\":\"fe80::209:e5ff:fe00:13c4\",\"prefix\":64}],"
+	"\"name\":\"eth1\",\"type\":\"ethernet\"}},\"router\":{\"uuid\":\"0009E50013C3\"},\"services\":[{\"port\":50320,\"type\":\"daqStream\"},"
+	"{\"port\":50321,\"type\":\"daqStreamWS\"},{\"port\":50322,\"type\":\"hbmProtocol\"},{\"port\":50323,\"type\":\"http\"},"
+	"{\"port\":50324,\"type\":\"jetd\"},{\"port\":50325,\"type\":\"jetws\"},{\"port\":50326,\"type\":\"ssh\"}]}}\n",
+
+	// QuantumX CX27 announcing itself via firewire
+	"{\"jsonrpc\":\"2.0\",\"method\":\"announce\",\"params\":{\"apiVersion\":\"1.0\",\"device\":{\"familyType\":\"QuantumX\","
+	"\"firmwareVersion\":\"4.1.3.21715\",\"hardwareId\":\"CX27_R1\",\"name\":\"CX27 Gateway\",\"type\":\"CX27\",\"uuid\":\"0009E50013C3\"},"
+	"\"expiration\":15,\"netSettings\":{\"defaultGateway\":{\"ipv4Address\":\"\"},\"interface\":{\"configurationMethod\":\"manual\","
+	"\"description\":\"firewire\",\"ipv4\":[{\"address\":\"10.1.0.1\",\"netmask\":\"255.255.255.0\"}],\"ipv6\":[],"
+	"\"name\":\"fw0\",\"type\":\"firewire\"}},\"services\":[{\"port\":5001,\"type\":\"hbmProtocol\"},{\"port\":80,\"type\":\"http\"},"
+	"{\"port\":11122,\"type\":\"jetd\"},{\"port\":11123,\"type\":\"jetws\"},{\"port\":22,\"type\":\"ssh\"}]}}\n",
+
+	// PMX
+	"{\r\n   \"jsonrpc\" : \"2.0\",\r\n   \"method\" : \"announce\",\r\n   \"params\" : {\r\n      \"apiVersion\" : \"1.0\",\r\n"
+	"      \"device\" : {\r\n         \"familyType\" : \"PMX\",\r\n         \"firmwareVersion\" : \"1.12.2002\",\r\n"
+	"         \"hardwareId\" : \"WGX002\",\r\n         \"name\" : \"PMX Test Rack\",\r\n         \"type\" : \"WGX002\",\r\n"
+	"         \"uuid\" : \"0009E5062A7F\"\r\n      },\r\n      \"expiration\" : 20,\r\n      \"netSettings\" : {\r\n"
+	"         \"defaultGateway\" : {\r\n            \"ipv4Address\" : \"192.168.169.254\"\r\n         },\r\n"
+	"         \"interface\" : {\r\n            \"configurationMethod\" : \"manual\",\r\n            \"description\" : \"ethernet\",\r\n"
+	"            \"ipv4\" : [\r\n               {\r\n                  \"address\" : \"192.168.169.27\",\r\n"
+	"                  \"netmask\" : \"255.255.255.0\"\r\n               }\r\n            ],\r\n"
+	"            \"ipv6\" : [\r\n               {\r\n                  \"address\" : \"fe80::209:e5ff:fe06:2a7f\",\r\n"
+	"                  \"prefix\" : 64\r\n               }\r\n            ],\r\n            \"name\" : \"eth0\",\r\n"
+	"            \"type\" : \"ethernet\"\r\n         }\r\n      },\r\n      \"services\" : [\r\n"
+	"         {\r\n            \"port\" : 80,\r\n            \"type\" : \"http\"\r\n         },\r\n"
+	"         {\r\n            \"port\" : 55000,\r\n            \"type\" : \"hbmProtocol\"\r\n         },\r\n"
+	"         {\r\n            \"port\" : 11122,\r\n            \"type\" : \"jetd\"\r\n         }\r\n      ]\r\n   }\r\n}\r\n"
+};
+
+static const size_t announcementCount = sizeof(announcements)/sizeof(announcements[0]);
+
+/// keeps the compiler from optimizing away the work
+static size_t checksum = 0;
+
+static void decodeWithJsonReader(const std::string& message)
+{
+	Json::Value announcement;
+	if (Json::Reader().parse(message.c_str(), message.c_str()+message.length(), announcement)==false) {
+		return;
+	}
+	const Json::Value& params = announcement[hbm::jsonrpc::PARAMS];
+	checksum += announcement[hbm::jsonrpc::METHOD].asString().length();
+	checksum += params[TAG_NetSettings][TAG_Interface][TAG_Name].asString().length();
+	checksum += params[TAG_Device][TAG_Uuid].asString().length();
+	checksum += params[TAG_Router][TAG_Uuid].asString().length();
+	checksum += params[TAG_Expiration].asUInt();
+}
+
+static void decodeWithAnnouncementDecoder(const std::string& message)
+{
+	AnnouncementDecoder decoder;
+	if (decoder.decode(message.c_str(), message.length())==false) {
+		return;
+	}
+	checksum += decoder.getMethod().str().length();
+	checksum += decoder.getSendingInterfaceName().str().length();
+	checksum += decoder.getUuid().str().length();
+	checksum += decoder.getRouter().str().length();
+	checksum += decoder.getExpiration();
+}
+
+static void run(const std::string& name, void (*decode)(const std::string&), const std::string& message, unsigned int iterations)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i<iterations; ++i) {
+		decode(message);
+	}
+	std::chrono::nanoseconds duration = std::chrono::duration_cast < std::chrono::nanoseconds > (std::chrono::steady_clock::now()-start);
+	std::cout << "  " << name << ": " << duration.count()/iterations << " ns per announcement" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int iterations = 100000;
+	if (argc>1) {
+		iterations = static_cast < unsigned int > (strtoul(argv[1], NULL, 10));
+	}
+	if (iterations==0) {
+		std::cerr << "syntax: " << argv[0] << " [<iterations>]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	for (size_t index = 0; index<announcementCount; ++index) {
+		std::string message(announcements[index]);
+		std::cout << "announcement " << index << " (" << message.length() << " bytes)" << std::endl;
+		run("Json::Reader", &decodeWithJsonReader, message, iterations);
+		run("AnnouncementDecoder", &decodeWithAnnouncementDecoder, message, iterations);
+	}
+	std::cout << "checksum " << checksum << std::endl;
+	return EXIT_SUCCESS;
+}
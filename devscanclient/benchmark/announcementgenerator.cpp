@@ -0,0 +1,151 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "announcementgenerator.h"
+
+
+namespace hbm {
+	namespace devscan {
+		/// %u firmware revision, %06X serial number (name), %06X serial number (uuid), %u expiration, %s router, %u.%u ip address
+		static const char ANNOUNCEMENT_FORMAT[] =
+			"{\"jsonrpc\":\"2.0\",\"method\":\"announce\",\"params\":{\"apiVersion\":\"1.0\",\"device\":{\"familyType\":\"QuantumX\","
+			"\"firmwareVersion\":\"4.1.%u.21715\",\"hardwareId\":\"MX440A_R0\",\"name\":\"MX440A_%06X\",\"type\":\"MX440A\",\"uuid\":\"0009E5%06X\"},"
+			"\"expiration\":%u,%s\"netSettings\":{\"defaultGateway\":{\"ipv4Address\":\"172.19.169.254\"},\"interface\":{\"configurationMethod\":\"dhcp\","
+			"\"description\":\"ethernet front side\",\"ipv4\":[{\"address\":\"172.19.%u.%u\",\"netmask\":\"255.255.0.0\"}],"
+			"\"ipv6\":[{\"address\":\"fe80::209:e5ff:fe00:13c4\",\"prefix\":64}],\"name\":\"eth0\",\"type\":\"ethernet\"}},"
+			"\"services\":[{\"port\":5001,\"type\":\"hbmProtocol\"},{\"port\":80,\"type\":\"http\"},{\"port\":11122,\"type\":\"jetd\"},"
+			"{\"port\":11123,\"type\":\"jetws\"},{\"port\":22,\"type\":\"ssh\"}]}}\n";
+
+		/// %u number of the router
+		static const char ROUTER_FORMAT[] = "\"router\":{\"uuid\":\"0009E5FFFF%02u\"},";
+
+		bool AnnouncementGenerator::lessPosition(const positionedDevice_t& first, const positionedDevice_t& second)
+		{
+			return first.first < second.first;
+		}
+
+		AnnouncementGenerator::AnnouncementGenerator(unsigned int deviceCount, double changeRate, double expiryRate, unsigned int expiration)
+			: m_devices(deviceCount)
+			, m_changeRate(changeRate)
+			, m_expiryRate(expiryRate)
+			, m_expiration(expiration)
+			, m_expirationSpread(0)
+			, m_routerRate(0.0)
+			, m_jitter(0.0)
+			, m_nextSerialNumber(0)
+			, m_position(0)
+			, m_random()
+			, m_probability(0.0, 1.0)
+		{
+			for (devices_t::iterator iter = m_devices.begin(); iter != m_devices.end(); ++iter) {
+				createDevice(*iter);
+			}
+		}
+
+		void AnnouncementGenerator::setExpirationSpread(unsigned int spread)
+		{
+			m_expirationSpread = spread;
+			for (devices_t::iterator iter = m_devices.begin(); iter != m_devices.end(); ++iter) {
+				configureDevice(*iter);
+			}
+		}
+
+		void AnnouncementGenerator::setRouterRate(double routerRate)
+		{
+			m_routerRate = routerRate;
+			for (devices_t::iterator iter = m_devices.begin(); iter != m_devices.end(); ++iter) {
+				configureDevice(*iter);
+			}
+		}
+
+		void AnnouncementGenerator::setJitter(double jitter)
+		{
+			m_jitter = jitter;
+		}
+
+		void AnnouncementGenerator::createDevice(device_t& device)
+		{
+			device.serialNumber = m_nextSerialNumber++;
+			device.firmwareRevision = 0;
+			configureDevice(device);
+		}
+
+		void AnnouncementGenerator::configureDevice(device_t& device)
+		{
+			device.expiration = m_expiration;
+			device.router = 0;
+
+			// random numbers are drawn only if asked for. This keeps the sequence of the defaults unchanged.
+			if (m_expirationSpread>0) {
+				device.expiration += static_cast < unsigned int > (m_probability(m_random) * (m_expirationSpread+1)) % (m_expirationSpread+1);
+			}
+			if ((m_routerRate>0.0) && (m_probability(m_random)<m_routerRate)) {
+				device.router = 1 + device.serialNumber % ROUTER_COUNT;
+			}
+		}
+
+		void AnnouncementGenerator::replaceDevices()
+		{
+			for (devices_t::iterator iter = m_devices.begin(); iter != m_devices.end(); ++iter) {
+				if (m_probability(m_random)<m_expiryRate) {
+					createDevice(*iter);
+				}
+			}
+		}
+
+		void AnnouncementGenerator::shuffleDevices()
+		{
+			double maxShift = m_jitter * static_cast < double > (m_devices.size());
+			std::vector < positionedDevice_t > positionedDevices;
+			positionedDevices.reserve(m_devices.size());
+			for (size_t i = 0; i < m_devices.size(); ++i) {
+				double shift = (m_probability(m_random)*2.0-1.0) * maxShift;
+				positionedDevices.push_back(positionedDevice_t(static_cast < double > (i) + shift, m_devices[i]));
+			}
+			std::stable_sort(positionedDevices.begin(), positionedDevices.end(), &lessPosition);
+			for (size_t i = 0; i < m_devices.size(); ++i) {
+				m_devices[i] = positionedDevices[i].second;
+			}
+		}
+
+		size_t AnnouncementGenerator::next(char* pBuffer, size_t bufferSize)
+		{
+			if (m_devices.empty()) {
+				return 0;
+			}
+
+			if (m_position==m_devices.size()) {
+				m_position = 0;
+				replaceDevices();
+				if (m_jitter>0.0) {
+					shuffleDevices();
+				}
+			}
+
+			device_t& device = m_devices[m_position++];
+			if (m_probability(m_random)<m_changeRate) {
+				++device.firmwareRevision;
+			}
+
+			// room for the widest number of the router
+			char router[sizeof(ROUTER_FORMAT) + std::numeric_limits < unsigned int >::digits10 + 1] = "";
+			if (device.router>0) {
+				snprintf(router, sizeof(router), ROUTER_FORMAT, device.router);
+			}
+
+			unsigned int serialNumber = device.serialNumber & 0xffffff;
+			int length = snprintf(pBuffer, bufferSize, ANNOUNCEMENT_FORMAT, device.firmwareRevision, serialNumber, serialNumber, device.expiration, router, (serialNumber>>8) & 0xff, serialNumber & 0xff);
+			if ((length<0) || (static_cast < size_t > (length)>=bufferSize)) {
+				return 0;
+			}
+			return static_cast < size_t > (length);
+		}
+	}
+}
@@ -0,0 +1,104 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef _ANNOUNCEMENTGENERATOR_H
+#define _ANNOUNCEMENTGENERATOR_H
+
+#include <random>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+
+
+namespace hbm {
+	namespace devscan {
+
+		/// \brief synthesizes announcements of simulated devices.
+		///
+		/// Devices announce in rounds, one after the other. Announcements look like those of a QuantumX MX440A.
+		/// Each announcement might carry a change (new firmware revision). At the start of each round,
+		/// some devices go silent (their announcements expire) and are replaced by new ones.
+		/// The sequence is reproducible. It depends on the parameters only.
+		class AnnouncementGenerator
+		{
+		public:
+			/// \param deviceCount number of devices announcing at the same time
+			/// \param changeRate fraction (0..1) of announcements that differ from the previous one of the same device
+			/// \param expiryRate fraction (0..1) of devices being replaced per round
+			/// \param expiration announced expiration time in s
+			AnnouncementGenerator(unsigned int deviceCount, double changeRate, double expiryRate, unsigned int expiration);
+
+			/// each device announces an expiration time between expiration and expiration+spread.
+			void setExpirationSpread(unsigned int spread);
+
+			/// fraction (0..1) of devices announcing via one of ROUTER_COUNT routers.
+			void setRouterRate(double routerRate);
+
+			/// Without jitter, devices announce in the same order each round.
+			/// With jitter, each device announces up to jitter*deviceCount positions earlier or later than in the previous round.
+			/// \param jitter 0..1
+			void setJitter(double jitter);
+
+			/// writes the next announcement
+			/// \return length of the announcement. 0 if the buffer is too small.
+			size_t next(char* pBuffer, size_t bufferSize);
+
+			/// \return true if the last announcement was the first of a round
+			bool isNewRound() const
+			{
+				return m_position==1;
+			}
+
+			unsigned int getDeviceCount() const
+			{
+				return static_cast < unsigned int > (m_devices.size());
+			}
+
+			/// number of different routers devices announce via
+			static const unsigned int ROUTER_COUNT = 4;
+
+		private:
+			struct device_t {
+				unsigned int serialNumber;
+				unsigned int firmwareRevision;
+				unsigned int expiration;
+				/// 0 if announcing directly, otherwise number of the router
+				unsigned int router;
+			};
+
+			typedef std::vector < device_t > devices_t;
+
+			/// a device with its position in the next round
+			typedef std::pair < double, device_t > positionedDevice_t;
+
+			static bool lessPosition(const positionedDevice_t& first, const positionedDevice_t& second);
+
+			/// gives the device a new identity
+			void createDevice(device_t& device);
+
+			/// chooses expiration and router of the device
+			void configureDevice(device_t& device);
+
+			/// replaces a fraction of the devices by new ones
+			void replaceDevices();
+
+			/// reorders the devices according to the jitter
+			void shuffleDevices();
+
+			devices_t m_devices;
+			double m_changeRate;
+			double m_expiryRate;
+			unsigned int m_expiration;
+			unsigned int m_expirationSpread;
+			double m_routerRate;
+			double m_jitter;
+			unsigned int m_nextSerialNumber;
+			/// device to announce next
+			size_t m_position;
+			std::minstd_rand m_random;
+			std::uniform_real_distribution < double > m_probability;
+		};
+	}
+}
+#endif
@@ -0,0 +1,155 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "devscan/announcementtable.h"
+
+using namespace hbm::devscan;
+
+/// each path is looked up this many times in each measurement
+static const unsigned int LOOKUPS_PER_PATH = 10;
+
+/// what DeviceMonitor used to keep per communication path in a std::unordered_map
+struct expiringEntry {
+	PayloadArena::handle_t payload;
+	std::chrono::steady_clock::time_point timeOfExpiry;
+	std::chrono::seconds expiration;
+	uint64_t fingerprint;
+	size_t heapPosition;
+};
+
+struct communicationPathHash {
+	size_t operator()(const communicationPath& path) const
+	{
+		return static_cast < size_t > (path.hash);
+	}
+};
+
+typedef std::unordered_map < communicationPath, expiringEntry, communicationPathHash > announcements_t;
+
+typedef std::vector < communicationPath > paths_t;
+
+static double getSeconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast < std::chrono::duration < double > > (std::chrono::steady_clock::now()-start).count();
+}
+
+static void printResult(const char* name, size_t operations, double seconds)
+{
+	printf("  %-28s %8.1f M/s\n", name, static_cast < double > (operations) / seconds / 1000000.0);
+}
+
+/// lookups are done in random order. Otherwise the map would profit from the order of insertion.
+static void runMap(const paths_t& paths, const std::vector < size_t >& order)
+{
+	announcements_t announcements;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (paths_t::const_iterator iter = paths.begin(); iter != paths.end(); ++iter) {
+		expiringEntry entry = expiringEntry();
+		announcements.insert(announcements_t::value_type(*iter, entry));
+	}
+	printResult("std::unordered_map insert", paths.size(), getSeconds(start));
+
+	uint64_t found = 0;
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < LOOKUPS_PER_PATH; ++i) {
+		for (std::vector < size_t >::const_iterator iter = order.begin(); iter != order.end(); ++iter) {
+			announcements_t::const_iterator entry = announcements.find(paths[*iter]);
+			if (entry!=announcements.end()) {
+				found += entry->second.payload;
+			}
+		}
+	}
+	printResult("std::unordered_map lookup", order.size()*LOOKUPS_PER_PATH, getSeconds(start));
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	start = now;
+	for (unsigned int i = 0; i < LOOKUPS_PER_PATH; ++i) {
+		for (std::vector < size_t >::const_iterator iter = order.begin(); iter != order.end(); ++iter) {
+			announcements_t::iterator entry = announcements.find(paths[*iter]);
+			entry->second.timeOfExpiry = now + entry->second.expiration;
+		}
+	}
+	printResult("std::unordered_map update", order.size()*LOOKUPS_PER_PATH, getSeconds(start));
+
+	if (found==1) {
+		// keeps the compiler from dropping the lookups
+		std::cout << std::endl;
+	}
+}
+
+static void runTable(const paths_t& paths, const std::vector < size_t >& order)
+{
+	AnnouncementTable announcements;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (paths_t::const_iterator iter = paths.begin(); iter != paths.end(); ++iter) {
+		announcements.insert(*iter);
+	}
+	printResult("AnnouncementTable insert", paths.size(), getSeconds(start));
+
+	uint64_t found = 0;
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < LOOKUPS_PER_PATH; ++i) {
+		for (std::vector < size_t >::const_iterator iter = order.begin(); iter != order.end(); ++iter) {
+			AnnouncementTable::entry_t entry = announcements.find(paths[*iter]);
+			if (entry!=AnnouncementTable::NO_ENTRY) {
+				found += announcements.getPayload(entry);
+			}
+		}
+	}
+	printResult("AnnouncementTable lookup", order.size()*LOOKUPS_PER_PATH, getSeconds(start));
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	start = now;
+	for (unsigned int i = 0; i < LOOKUPS_PER_PATH; ++i) {
+		for (std::vector < size_t >::const_iterator iter = order.begin(); iter != order.end(); ++iter) {
+			AnnouncementTable::entry_t entry = announcements.find(paths[*iter]);
+			announcements.setTimeOfExpiry(entry, now + announcements.getExpiration(entry));
+		}
+	}
+	printResult("AnnouncementTable update", order.size()*LOOKUPS_PER_PATH, getSeconds(start));
+
+	if (found==1) {
+		std::cout << std::endl;
+	}
+}
+
+int main()
+{
+	static const size_t pathCounts[] = { 10000, 100000, 1000000 };
+
+	hbm::string::Interner strings;
+	hbm::string::Interner::id_t receivingInterface = strings.acquire("eth0");
+	hbm::string::Interner::id_t sendingInterface = strings.acquire("eth0");
+	hbm::string::Interner::id_t noRouter = strings.acquire("");
+	std::minstd_rand random;
+
+	for (unsigned int i = 0; i < sizeof(pathCounts)/sizeof(pathCounts[0]); ++i) {
+		size_t pathCount = pathCounts[i];
+		paths_t paths;
+		paths.reserve(pathCount);
+		std::vector < size_t > order;
+		order.reserve(pathCount);
+		for (size_t path = 0; path < pathCount; ++path) {
+			char uuid[16];
+			snprintf(uuid, sizeof(uuid), "0009E5%06X", static_cast < unsigned int > (path));
+			paths.push_back(communicationPath(receivingInterface, sendingInterface, strings.acquire(uuid), noRouter));
+			order.push_back(path);
+		}
+		std::shuffle(order.begin(), order.end(), random);
+
+		std::cout << pathCount << " communication paths" << std::endl;
+		runMap(paths, order);
+		runTable(paths, order);
+	}
+	return 0;
+}
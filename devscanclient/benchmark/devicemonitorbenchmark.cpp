@@ -0,0 +1,360 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hbm/communication/multicastserver.h"
+#include "hbm/communication/netadapterlist.h"
+#include "hbm/sys/eventloop.h"
+
+#include "devscan/announcementcollector.h"
+#include "devscan/devicemonitor.h"
+#include "devscan/receivermetrics.h"
+#include "devscan/defines.h"
+
+#include "announcementgenerator.h"
+
+using namespace hbm::devscan;
+
+/// counts all allocations of the process
+static std::atomic < uint64_t > allocationCount(0);
+
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	void* pMemory = malloc(size);
+	if (pMemory==NULL) {
+		throw std::bad_alloc();
+	}
+	return pMemory;
+}
+
+void operator delete(void* pMemory) throw()
+{
+	free(pMemory);
+}
+
+/// the receiving interface of all announcements processed directly
+static const std::string RECEIVING_INTERFACE_NAME = "eth0";
+
+/// announcements sent but not yet received in multicast mode. Keeps the receive buffer from overflowing.
+static const uint64_t SEND_WINDOW = 256;
+
+static const int RECEIVE_BUFFER_SIZE = 4*1024*1024;
+
+struct options_t {
+	unsigned int deviceCount;
+	uint64_t messageCount;
+	double changeRate;
+	double expiryRate;
+	unsigned int expiration;
+	/// announcements to replay instead of synthesized ones
+	std::string captureFileName;
+	bool multicast;
+	/// interface to send via in multicast mode. Empty for the first one known.
+	std::string interfaceAddress;
+};
+
+/// either synthesized or replayed announcements
+struct source_t {
+	source_t(const options_t& options)
+		: generator(options.deviceCount, options.changeRate, options.expiryRate, options.expiration)
+		, captured()
+		, position(0)
+	{
+	}
+
+	/// \return length of the announcement
+	size_t next(char* pBuffer, size_t bufferSize)
+	{
+		if (captured.empty()) {
+			return generator.next(pBuffer, bufferSize);
+		}
+		const std::string& announcement = captured[position];
+		position = (position+1) % captured.size();
+		size_t length = std::min(announcement.length(), bufferSize);
+		memcpy(pBuffer, announcement.c_str(), length);
+		return length;
+	}
+
+	/// \return true if each device did announce once since the last time
+	bool isNewRound() const
+	{
+		if (captured.empty()) {
+			return generator.isNewRound();
+		}
+		return position==1;
+	}
+
+	AnnouncementGenerator generator;
+	std::vector < std::string > captured;
+	size_t position;
+};
+
+static void announceCb(const std::string&, const std::string&, const std::string&, const std::string&, const std::string&)
+{
+}
+
+static void expireCb(const std::string&, const std::string&, const std::string&, const std::string&)
+{
+}
+
+static void printUsage(const char* name)
+{
+	std::cerr << "syntax: " << name << " [-d <devices>] [-n <announcements>] [-c <change rate>] [-e <expiry rate>] [-x <expiration>] [-f <capture file>] [-m [-i <interface address>]]" << std::endl;
+	std::cerr << "  -d number of simulated devices (default 1000)" << std::endl;
+	std::cerr << "  -n number of announcements to process (default 1000000)" << std::endl;
+	std::cerr << "  -c fraction of announcements carrying a change (default 0.01)" << std::endl;
+	std::cerr << "  -e fraction of devices replaced by new ones after each round (default 0.001)" << std::endl;
+	std::cerr << "  -x announced expiration time in s (default 2)" << std::endl;
+	std::cerr << "  -f replay announcements from file, one per line, instead of synthesizing them" << std::endl;
+	std::cerr << "  -m send announcements via multicast (loop back) to a receiving socket instead of processing them directly" << std::endl;
+	std::cerr << "  -i interface to send via in multicast mode" << std::endl;
+}
+
+/// \return false on error
+static bool parseOptions(int argc, char* argv[], options_t& options)
+{
+	options.deviceCount = 1000;
+	options.messageCount = 1000000;
+	options.changeRate = 0.01;
+	options.expiryRate = 0.001;
+	options.expiration = 2;
+	options.multicast = false;
+
+	for (int i = 1; i<argc; ++i) {
+		std::string option(argv[i]);
+		if (option=="-m") {
+			options.multicast = true;
+			continue;
+		}
+		if (i+1>=argc) {
+			return false;
+		}
+		const char* pValue = argv[++i];
+		if (option=="-d") {
+			options.deviceCount = static_cast < unsigned int > (strtoul(pValue, NULL, 10));
+		} else if (option=="-n") {
+			options.messageCount = strtoull(pValue, NULL, 10);
+		} else if (option=="-c") {
+			options.changeRate = strtod(pValue, NULL);
+		} else if (option=="-e") {
+			options.expiryRate = strtod(pValue, NULL);
+		} else if (option=="-x") {
+			options.expiration = static_cast < unsigned int > (strtoul(pValue, NULL, 10));
+		} else if (option=="-f") {
+			options.captureFileName = pValue;
+		} else if (option=="-i") {
+			options.interfaceAddress = pValue;
+		} else {
+			return false;
+		}
+	}
+	return (options.deviceCount>0) && (options.messageCount>0) && (options.expiration>0);
+}
+
+/// \return false if the file could not be read or is empty
+static bool loadCaptureFile(const std::string& fileName, std::vector < std::string >& announcements)
+{
+	std::ifstream file(fileName.c_str());
+	if (!file) {
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty()==false) {
+			announcements.push_back(line + "\n");
+		}
+	}
+	return announcements.empty()==false;
+}
+
+static void printCounters(const ReceiverMetrics::snapshot_t& snapshot)
+{
+	std::cout << "  new " << snapshot.counters[ReceiverMetrics::NEW]
+		<< " changed " << snapshot.counters[ReceiverMetrics::CHANGED]
+		<< " repeated " << snapshot.counters[ReceiverMetrics::REPEATED]
+		<< " expired " << snapshot.counters[ReceiverMetrics::EXPIRED]
+		<< " parse failures " << snapshot.counters[ReceiverMetrics::PARSE_FAILURES]
+		<< " by JSON parser " << snapshot.counters[ReceiverMetrics::PARSED_BY_FALLBACK]
+		<< std::endl;
+}
+
+static void printLatency(const std::string& name, const ReceiverMetrics::histogram_t& histogram)
+{
+	std::cout << "  " << name << " latency p50 " << histogram.getPercentile(0.5) << "ns p99 " << histogram.getPercentile(0.99) << "ns max " << histogram.getPercentile(1.0) << "ns" << std::endl;
+}
+
+/// DeviceMonitor::processReceivedAnnouncement() is called directly
+static void runDirect(const options_t& options, source_t& source)
+{
+	ReceiverMetrics metrics;
+	DeviceMonitor deviceMonitor;
+	deviceMonitor.setMetrics(&metrics);
+	deviceMonitor.setAnnounceCb(&announceCb);
+	deviceMonitor.setExpireCb(&expireCb);
+
+	std::vector < uint32_t > latencies(static_cast < size_t > (options.messageCount));
+	char buffer[hbm::communication::MAX_DATAGRAM_SIZE];
+	std::chrono::nanoseconds processingTime(0);
+
+	uint64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+	for (uint64_t i = 0; i<options.messageCount; ++i) {
+		size_t length = source.next(buffer, sizeof(buffer));
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (source.isNewRound()) {
+			deviceMonitor.checkForExpiredAnnouncements();
+		}
+		deviceMonitor.processReceivedAnnouncement(RECEIVING_INTERFACE_NAME, buffer, length);
+		std::chrono::nanoseconds duration = std::chrono::duration_cast < std::chrono::nanoseconds > (std::chrono::steady_clock::now()-start);
+		processingTime += duration;
+		latencies[static_cast < size_t > (i)] = static_cast < uint32_t > (std::min < int64_t > (duration.count(), UINT32_MAX));
+	}
+	uint64_t allocations = allocationCount.load(std::memory_order_relaxed)-allocationsBefore;
+
+	std::sort(latencies.begin(), latencies.end());
+	double seconds = std::chrono::duration_cast < std::chrono::duration < double > > (processingTime).count();
+
+	std::cout << "direct processing" << std::endl;
+	std::cout << "  " << static_cast < double > (options.messageCount) / seconds << " announcements/s" << std::endl;
+	std::cout << "  " << static_cast < double > (allocations) / static_cast < double > (options.messageCount) << " allocations per announcement" << std::endl;
+	DeviceMonitor::memoryUsage_t memoryUsage = deviceMonitor.getMemoryUsage();
+	std::cout << "  " << memoryUsage.deviceCount << " devices tracked, " << memoryUsage.getResidentBytes() << " bytes resident, " << memoryUsage.getBytesPerDevice() << " bytes per device" << std::endl;
+	std::cout << "  latency p50 " << latencies[latencies.size()/2] << "ns p99 " << latencies[latencies.size()*99/100] << "ns max " << latencies.back() << "ns" << std::endl;
+	printCounters(metrics.getSnapshot());
+}
+
+/// \return address of the first interface with an IPv4 address. Empty if there is none.
+static std::string getFirstInterfaceAddress(const hbm::communication::NetadapterList& adapters)
+{
+	hbm::communication::NetadapterList::tAdapters adapterMap = adapters.get();
+	for (hbm::communication::NetadapterList::tAdapters::const_iterator iter = adapterMap.begin(); iter != adapterMap.end(); ++iter) {
+		const hbm::communication::addressesWithNetmask_t& addresses = iter->second.getIpv4Addresses();
+		if (addresses.empty()==false) {
+			return addresses.front().address;
+		}
+	}
+	return "";
+}
+
+/// announcements are sent via multicast and received by an AnnouncementCollector executed by another thread
+static void runMulticast(const options_t& options, source_t& source)
+{
+	hbm::communication::NetadapterList adapters;
+	std::string interfaceAddress = options.interfaceAddress;
+	if (interfaceAddress.empty()) {
+		interfaceAddress = getFirstInterfaceAddress(adapters);
+	}
+	if (interfaceAddress.empty()) {
+		std::cerr << "no interface to send via" << std::endl;
+		return;
+	}
+
+	ReceiverMetrics metrics;
+	hbm::sys::EventLoop eventloop;
+	AnnouncementCollector collector(adapters, eventloop);
+	collector.setMetrics(&metrics);
+	collector.setAnnounceCb(&announceCb);
+	collector.setExpireCb(&expireCb);
+	collector.setReceiveBufferSize(RECEIVE_BUFFER_SIZE);
+	collector.start();
+	collector.addAllInterfaces();
+	std::thread worker(&hbm::sys::EventLoop::execute, &eventloop);
+
+	hbm::sys::EventLoop senderEventloop;
+	hbm::communication::MulticastServer sender(adapters, senderEventloop);
+	sender.setMulticastLoop(true);
+	sender.start(ANNOUNCE_IPV4_ADDRESS, ANNOUNCE_UDP_PORT, hbm::communication::MulticastServer::DataHandler_t());
+
+	char buffer[hbm::communication::MAX_DATAGRAM_SIZE];
+	uint64_t received = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	uint64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+	for (uint64_t sent = 0; sent<options.messageCount; ++sent) {
+		size_t length = source.next(buffer, sizeof(buffer));
+		sender.sendOverInterfaceByAddress(interfaceAddress, buffer, length);
+
+		if ((sent % (SEND_WINDOW/4))==0) {
+			std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+			while (true) {
+				received = metrics.getSnapshot().counters[ReceiverMetrics::TELEGRAMS];
+				if ((received+SEND_WINDOW>sent) || (std::chrono::steady_clock::now()-waitStart>std::chrono::seconds(1))) {
+					break;
+				}
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	// wait for the rest. Dropped ones will never arrive.
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point lastProgress = end;
+	while (std::chrono::steady_clock::now()-lastProgress<std::chrono::milliseconds(200)) {
+		uint64_t current = metrics.getSnapshot().counters[ReceiverMetrics::TELEGRAMS];
+		if (current!=received) {
+			received = current;
+			lastProgress = end = std::chrono::steady_clock::now();
+		}
+		if (received>=options.messageCount) {
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	uint64_t allocations = allocationCount.load(std::memory_order_relaxed)-allocationsBefore;
+
+	sender.stop();
+	eventloop.stop();
+	worker.join();
+	collector.stop();
+
+	ReceiverMetrics::snapshot_t snapshot = metrics.getSnapshot();
+	double seconds = std::chrono::duration_cast < std::chrono::duration < double > > (end-start).count();
+
+	std::cout << "multicast via " << interfaceAddress << std::endl;
+	std::cout << "  " << static_cast < double > (received) / seconds << " announcements/s received" << std::endl;
+	std::cout << "  " << received << " of " << options.messageCount << " received, kernel drops " << collector.getKernelDropCount() << std::endl;
+	std::cout << "  " << static_cast < double > (allocations) / static_cast < double > (options.messageCount) << " allocations per announcement (sending and receiving)" << std::endl;
+	printLatency("socket to parse", snapshot.latencies[ReceiverMetrics::RECEIVE_TO_PARSE]);
+	printLatency("parse to update", snapshot.latencies[ReceiverMetrics::PARSE_TO_UPDATE]);
+	printCounters(snapshot);
+}
+
+int main(int argc, char* argv[])
+{
+	options_t options;
+	if (parseOptions(argc, argv, options)==false) {
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	source_t source(options);
+	if (options.captureFileName.empty()==false) {
+		if (loadCaptureFile(options.captureFileName, source.captured)==false) {
+			std::cerr << "could not load announcements from " << options.captureFileName << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::cout << "replaying " << source.captured.size() << " announcements from " << options.captureFileName << std::endl;
+	} else {
+		std::cout << options.deviceCount << " devices, change rate " << options.changeRate << ", expiry rate " << options.expiryRate << ", expiration " << options.expiration << "s" << std::endl;
+	}
+	std::cout << options.messageCount << " announcements" << std::endl;
+
+	if (options.multicast) {
+		runMulticast(options, source);
+	} else {
+		runDirect(options, source);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hbm/communication/multicastserver.h"
+#include "hbm/communication/netadapterlist.h"
+#include "hbm/sys/eventloop.h"
+
+#include "devscan/defines.h"
+
+#include "benchmark/announcementgenerator.h"
+
+/// statistics are printed in this interval
+static const std::chrono::seconds PRINT_INTERVAL(1);
+
+struct options_t {
+	unsigned int deviceCount;
+	/// datagrams per second
+	unsigned int rate;
+	unsigned int batchSize;
+	double changeRate;
+	double expiryRate;
+	unsigned int expiration;
+	unsigned int expirationSpread;
+	double jitter;
+	double routerRate;
+	/// in s, 0 runs forever
+	unsigned int duration;
+	std::string interfaceAddress;
+};
+
+static void printUsage(const char* name)
+{
+	std::cout << "Emulates many devices by sending announcements to " << hbm::devscan::ANNOUNCE_IPV4_ADDRESS << ":" << hbm::devscan::ANNOUNCE_UDP_PORT << std::endl;
+	std::cout << "Announcements are delivered to receivers on this host too." << std::endl;
+	std::cout << "syntax: " << name << " [options]" << std::endl;
+	std::cout << "  -d number of devices (default 1000)" << std::endl;
+	std::cout << "  -r announcements per second (default 1000)" << std::endl;
+	std::cout << "  -b announcements sent with one system call (default 32, at most " << hbm::communication::MAX_TELEGRAMS_PER_BATCH << ")" << std::endl;
+	std::cout << "  -c fraction of announcements carrying a firmware change (default 0.001)" << std::endl;
+	std::cout << "  -e fraction of devices replaced by new ones after each round (default 0.01)" << std::endl;
+	std::cout << "  -x announced expiration time in s (default 15)" << std::endl;
+	std::cout << "  -s devices announce expiration times up to this many s longer (default 0)" << std::endl;
+	std::cout << "  -j fraction of a round a device announces earlier or later than in the previous one (default 0.1)" << std::endl;
+	std::cout << "  -R fraction of devices announcing via a router (default 0.1)" << std::endl;
+	std::cout << "  -t run for this many s (default 0: until stopped)" << std::endl;
+	std::cout << "  -i IP address of the interface to send via (default: first interface with an IPv4 address)" << std::endl;
+}
+
+/// \return false on error
+static bool parseOptions(int argc, char* argv[], options_t& options)
+{
+	options.deviceCount = 1000;
+	options.rate = 1000;
+	options.batchSize = 32;
+	options.changeRate = 0.001;
+	options.expiryRate = 0.01;
+	options.expiration = 15;
+	options.expirationSpread = 0;
+	options.jitter = 0.1;
+	options.routerRate = 0.1;
+	options.duration = 0;
+
+	for (int i = 1; i<argc; ++i) {
+		std::string option(argv[i]);
+		if (i+1>=argc) {
+			return false;
+		}
+		const char* pValue = argv[++i];
+		if (option=="-d") {
+			options.deviceCount = static_cast < unsigned int > (strtoul(pValue, NULL, 10));
+		} else if (option=="-r") {
+			options.rate = static_cast < unsigned int > (strtoul(pValue, NULL, 10));
+		} else if (option=="-b") {
+			options.batchSize = static_cast < unsigned int > (strtoul(pValue, NULL, 10));
+		} else if (option=="-c") {
+			options.changeRate = strtod(pValue, NULL);
+		} else if (option=="-e") {
+			options.expiryRate = strtod(pValue, NULL);
+		} else if (option=="-x") {
+			options.expiration = static_cast < unsigned int > (strtoul(pValue, NULL, 10));
+		} else if (option=="-s") {
+			options.expirationSpread = static_cast < unsigned int > (strtoul(pValue, NULL, 10));
+		} else if (option=="-j") {
+			options.jitter = strtod(pValue, NULL);
+		} else if (option=="-R") {
+			options.routerRate = strtod(pValue, NULL);
+		} else if (option=="-t") {
+			options.duration = static_cast < unsigned int > (strtoul(pValue, NULL, 10));
+		} else if (option=="-i") {
+			options.interfaceAddress = pValue;
+		} else {
+			return false;
+		}
+	}
+
+	if (options.batchSize>hbm::communication::MAX_TELEGRAMS_PER_BATCH) {
+		options.batchSize = hbm::communication::MAX_TELEGRAMS_PER_BATCH;
+	}
+	return (options.deviceCount>0) && (options.rate>0) && (options.batchSize>0) && (options.expiration>0);
+}
+
+/// \return address of the first interface with an IPv4 address. Empty if there is none.
+static std::string getFirstInterfaceAddress(const hbm::communication::NetadapterList& adapters)
+{
+	hbm::communication::NetadapterList::tAdapters adapterMap = adapters.get();
+	for (hbm::communication::NetadapterList::tAdapters::const_iterator iter = adapterMap.begin(); iter != adapterMap.end(); ++iter) {
+		const hbm::communication::addressesWithNetmask_t& addresses = iter->second.getIpv4Addresses();
+		if (addresses.empty()==false) {
+			return addresses.front().address;
+		}
+	}
+	return "";
+}
+
+int main(int argc, char* argv[])
+{
+	options_t options;
+	if (parseOptions(argc, argv, options)==false) {
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	hbm::communication::NetadapterList adapters;
+	std::string interfaceAddress = options.interfaceAddress;
+	if (interfaceAddress.empty()) {
+		interfaceAddress = getFirstInterfaceAddress(adapters);
+	}
+	if (interfaceAddress.empty()) {
+		std::cerr << "no interface to send via" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	hbm::devscan::AnnouncementGenerator generator(options.deviceCount, options.changeRate, options.expiryRate, options.expiration);
+	generator.setExpirationSpread(options.expirationSpread);
+	generator.setRouterRate(options.routerRate);
+	generator.setJitter(options.jitter);
+
+	hbm::sys::EventLoop eventloop;
+	hbm::communication::MulticastServer sender(adapters, eventloop);
+	sender.setMulticastLoop(true);
+	if (sender.start(hbm::devscan::ANNOUNCE_IPV4_ADDRESS, hbm::devscan::ANNOUNCE_UDP_PORT, hbm::communication::MulticastServer::DataHandler_t())<0) {
+		std::cerr << "could not start sending" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << options.deviceCount << " devices announcing " << options.rate << "/s via " << interfaceAddress << std::endl;
+
+	// one buffer per announcement of a batch
+	std::vector < char > buffers(options.batchSize*hbm::communication::MAX_DATAGRAM_SIZE);
+	std::vector < hbm::communication::sendTelegram_t > telegrams(options.batchSize);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point end = start + std::chrono::seconds(options.duration);
+	std::chrono::steady_clock::time_point nextPrint = start + PRINT_INTERVAL;
+	uint64_t sent = 0;
+	uint64_t failed = 0;
+	uint64_t sentAtLastPrint = 0;
+
+	while ((options.duration==0) || (std::chrono::steady_clock::now()<end)) {
+		// the schedule is kept independent of the time needed for sending. Sending late catches up.
+		std::chrono::steady_clock::time_point due = start + std::chrono::duration_cast < std::chrono::steady_clock::duration > (std::chrono::duration < double > (static_cast < double > (sent+failed) / options.rate));
+		std::this_thread::sleep_until(due);
+
+		for (unsigned int i = 0; i < options.batchSize; ++i) {
+			char* pBuffer = &buffers[i*hbm::communication::MAX_DATAGRAM_SIZE];
+			telegrams[i].pData = pBuffer;
+			telegrams[i].length = generator.next(pBuffer, hbm::communication::MAX_DATAGRAM_SIZE);
+		}
+
+		ssize_t result = sender.sendTelegramsOverInterfaceByAddress(interfaceAddress, &telegrams[0], options.batchSize);
+		if (result<0) {
+			failed += options.batchSize;
+		} else {
+			sent += static_cast < uint64_t > (result);
+			failed += options.batchSize - static_cast < uint64_t > (result);
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now>=nextPrint) {
+			double seconds = std::chrono::duration_cast < std::chrono::duration < double > > (now-nextPrint+PRINT_INTERVAL).count();
+			std::cout << "sent " << sent << " failed " << failed << " announcements/s " << static_cast < double > (sent-sentAtLastPrint) / seconds << std::endl;
+			sentAtLastPrint = sent;
+			nextPrint = now + PRINT_INTERVAL;
+		}
+	}
+
+	sender.stop();
+	return EXIT_SUCCESS;
+}
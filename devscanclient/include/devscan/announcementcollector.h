@@ -0,0 +1,186 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef _ANNOUNCEMENTCOLLECTOR_H
+#define _ANNOUNCEMENTCOLLECTOR_H
+
+
+#include <string>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+
+#include "hbm/communication/multicastserver.h"
+#include "hbm/communication/netadapterlist.h"
+#include "hbm/string/interner.h"
+#include "hbm/sys/eventloop.h"
+#include "hbm/sys/timer.h"
+
+
+#include "receiver_if.h"
+#include "callbackdispatcher.h"
+#include "devicemonitor.h"
+#include "receivermetrics.h"
+
+
+namespace hbm {
+	namespace devscan {
+
+		/// \brief Receives announcements via one socket and keeps track of them using a DeviceMonitor.
+		/// Receiving and retiring announcements is done by the given event loop.
+		/// Callbacks might be set from any thread. The DeviceMonitor is locked while it is being used.
+		/// Notifications are collected while the DeviceMonitor is locked and are delivered after unlocking it.
+		/// Hence callbacks may call any method of this object.
+		class AnnouncementCollector
+		{
+		public:
+			AnnouncementCollector(communication::NetadapterList& netadapterList, sys::EventLoop& eventLoop);
+
+			void setAnnounceCb(announceCb_t cb);
+			void setExpireCb(expireCb_t cb);
+			void setErrorCb(errorCb_t cb);
+
+			/// Callbacks are executed by a separate thread from now on. Slow callbacks do not stall receiving announcements.
+			/// \see CallbackDispatcher
+			void startDispatching(size_t capacity, CallbackDispatcher::overflowPolicy_t overflowPolicy);
+
+			/// Executes all pending callbacks. Callbacks are executed directly from now on.
+			void stopDispatching();
+
+			/// \param pMetrics receiving and processing of announcements is counted here. NULL to stop counting.
+			void setMetrics(ReceiverMetrics* pMetrics);
+
+			/// To be called before start().
+			/// \see communication::MulticastServer::setReceiveBufferSize()
+			void setReceiveBufferSize(int size, int maxSize = 0);
+
+			/// \return number of announcements dropped by the kernel because the receive buffer was full
+			uint64_t getKernelDropCount() const
+			{
+				return m_scanner.getKernelDropCount();
+			}
+
+			/// \see DeviceMonitor::getMemoryUsage()
+			DeviceMonitor::memoryUsage_t getMemoryUsage() const;
+
+			/// \param receiveAllMemberships false to receive only via the interfaces added to this object.
+			/// \see communication::MulticastServer::setReceiveAllMemberships()
+			int start(bool receiveAllMemberships = true);
+
+			void stop();
+
+			int addInterface(const std::string& interfaceAddress);
+			int dropInterface(const std::string& interfaceAddress);
+			void addAllInterfaces();
+			void dropAllInterfaces();
+			/// \see communication::MulticastServer::updateInterfaces()
+			void updateInterfaces(const communication::MulticastServer::interfaceAddresses_t& interfaceAddresses);
+			/// \see communication::MulticastServer::updateAllInterfaces()
+			void updateAllInterfaces();
+
+		private:
+			/// objects must not be copied
+			AnnouncementCollector(const AnnouncementCollector& op);
+
+			/// objects must not be assigned
+			AnnouncementCollector& operator=(const AnnouncementCollector& op);
+
+			communication::NetadapterList& m_netadapterList;
+			communication::MulticastServer m_scanner;
+			sys::Timer m_timer;
+			DeviceMonitor m_deviceMonitor;
+			mutable std::mutex m_deviceMonitorMtx;
+
+			/// not owned by this object
+			ReceiverMetrics* m_pMetrics;
+
+			/// the callbacks of the user. m_deviceMonitor reports to this object instead.
+			announceCb_t m_announceCb;
+			expireCb_t m_expireCb;
+			errorCb_t m_errorCb;
+
+			/// executes the callbacks if dispatching was started. Shared with deliveries in progress.
+			std::shared_ptr < CallbackDispatcher > m_pDispatcher;
+
+			typedef std::vector < CallbackDispatcher::event_t > events_t;
+
+			/// notifications of m_deviceMonitor not delivered yet
+			events_t m_pendingEvents;
+
+			/// notifications taken out of this object in order to be delivered without holding m_deviceMonitorMtx
+			struct notifications_t {
+				notifications_t()
+					: events()
+					, pDispatcher()
+					, announceCb()
+					, expireCb()
+					, errorCb()
+					, pMetrics(NULL)
+				{
+				}
+
+				events_t events;
+				/// if set, the events are pushed into it. Otherwise the callbacks are executed directly.
+				std::shared_ptr < CallbackDispatcher > pDispatcher;
+				announceCb_t announceCb;
+				expireCb_t expireCb;
+				errorCb_t errorCb;
+				/// executing the callbacks directly is timed here
+				ReceiverMetrics* pMetrics;
+			};
+
+			void collectAnnouncement(const std::string& uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router, const std::string& announcement);
+			void collectExpiry(const std::string& uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router);
+			void collectError(uint32_t errorCode, const std::string& userMessage, const std::string& receivedData);
+
+			/// to be called with m_deviceMonitorMtx locked
+			void takeNotifications(notifications_t& notifications);
+
+			/// to be called without m_deviceMonitorMtx locked
+			static void deliverNotifications(notifications_t& notifications);
+
+			/// number of announcements received with one system call
+			static const unsigned int RECEIVE_BATCH_SIZE = 16;
+
+			/// receive buffers for RECEIVE_BATCH_SIZE datagrams.
+			std::vector < char > m_receiveBuffer;
+			communication::receivedTelegram_t m_telegrams[RECEIVE_BATCH_SIZE];
+
+			/// interface index is the key. NO_ID for interfaces not known.
+			typedef std::unordered_map < unsigned int, string::Interner::id_t > interfaceIds_t;
+
+			/// ids of the receiving interfaces as interned by m_deviceMonitor.
+			/// Each interface name is interned once and looked up by interface index afterwards.
+			interfaceIds_t m_interfaceIds;
+
+			/// m_interfaceIds is valid for this generation of m_netadapterList
+			uint64_t m_netadapterGeneration;
+
+			/// \return string::Interner::NO_ID if there is no such interface
+			string::Interner::id_t getInterfaceId(unsigned int adapterIndex);
+
+			/// releases all cached ids
+			void clearInterfaceIds();
+
+			/// the timer is armed for this point in time. std::chrono::steady_clock::time_point::max() if not armed.
+			std::chrono::steady_clock::time_point m_expiryTimerDeadline;
+
+			ssize_t receiveEventHandler(communication::MulticastServer *pMcs);
+
+			/// feeds the received telegrams into m_deviceMonitor. To be called with m_deviceMonitorMtx locked.
+			void processTelegrams(ssize_t count);
+
+			/// called when the next announcement is due to expire
+			void expiryTimerCb(bool fired);
+
+			/// arms the timer for the next announcement to expire if it expires before the timer fires.
+			/// There is no timer running if there is nothing to expire.
+			void armExpiryTimer();
+		};
+	}
+}
+#endif
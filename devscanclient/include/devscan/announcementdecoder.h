@@ -0,0 +1,131 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef _ANNOUNCEMENTDECODER_H
+#define _ANNOUNCEMENTDECODER_H
+
+#include <cstddef>
+#include <string>
+
+
+namespace hbm {
+	namespace devscan {
+
+		/// \brief extracts the fields of an announcement needed by the DeviceMonitor without building a JSON document.
+		///
+		/// Everything else in the announcement is checked for correct JSON syntax and skipped.
+		/// Nothing is copied, the extracted strings refer to the decoded data.
+		/// Decoding fails on anything unusual (i.e. escape sequences within the relevant fields, comments, unexpected types).
+		/// Use a complete JSON parser to find out what is wrong then.
+		class AnnouncementDecoder
+		{
+		public:
+			/// a string within the decoded data
+			struct field_t {
+				const char* pData;
+				size_t length;
+
+				bool empty() const
+				{
+					return length==0;
+				}
+
+				std::string str() const
+				{
+					return std::string(pData, length);
+				}
+
+				bool equals(const char* pString) const;
+			};
+
+			AnnouncementDecoder();
+
+			/// \return false if the data could not be decoded.
+			bool decode(const char* pData, size_t length);
+
+			/// "method", empty if missing
+			const field_t& getMethod() const
+			{
+				return m_method;
+			}
+
+			/// "params"."netSettings"."interface"."name", empty if missing
+			const field_t& getSendingInterfaceName() const
+			{
+				return m_sendingInterfaceName;
+			}
+
+			/// "params"."device"."uuid", empty if missing
+			const field_t& getUuid() const
+			{
+				return m_uuid;
+			}
+
+			/// "params"."router"."uuid", empty if missing
+			const field_t& getRouter() const
+			{
+				return m_router;
+			}
+
+			/// "params"."expiration" in seconds, 0 if missing
+			unsigned int getExpiration() const
+			{
+				return m_expiration;
+			}
+
+		private:
+			/// the objects containing relevant fields
+			enum context_t {
+				CONTEXT_ROOT,
+				CONTEXT_PARAMS,
+				CONTEXT_NETSETTINGS,
+				CONTEXT_INTERFACE,
+				CONTEXT_DEVICE,
+				CONTEXT_ROUTER,
+				CONTEXT_OTHER
+			};
+
+			/// the relevant fields
+			enum target_t {
+				TARGET_NONE,
+				TARGET_METHOD,
+				TARGET_SENDINGINTERFACENAME,
+				TARGET_UUID,
+				TARGET_ROUTER,
+				TARGET_EXPIRATION
+			};
+
+			/// maximum nesting of objects and arrays
+			static const unsigned int MAX_DEPTH = 64;
+
+			void skipWhitespace();
+
+			/// a generic value within an object of no interest
+			bool parseValue(unsigned int depth);
+			bool parseObject(context_t context, unsigned int depth);
+			bool parseArray(unsigned int depth);
+			/// \param[out] hasEscapes true if the string contains any escape sequence
+			bool parseString(field_t& string, bool& hasEscapes);
+			bool parseNumber();
+			bool parseLiteral(const char* pLiteral);
+
+			/// \return false if the value does not have the type expected for the target
+			bool parseTarget(target_t target);
+
+			/// determines the meaning of the member with the given key
+			/// \return index of the key within the object, -1 if the key is of no interest
+			static int lookupKey(context_t context, const field_t& key, context_t& childContext, target_t& target);
+
+			const char* m_pPosition;
+			const char* m_pEnd;
+
+			field_t m_method;
+			field_t m_sendingInterfaceName;
+			field_t m_uuid;
+			field_t m_router;
+			unsigned int m_expiration;
+		};
+	}
+}
+#endif
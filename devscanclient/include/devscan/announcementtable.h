@@ -0,0 +1,206 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef _ANNOUNCEMENTTABLE_H
+#define _ANNOUNCEMENTTABLE_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hbm/string/interner.h"
+
+#include "payloadarena.h"
+
+
+namespace hbm {
+	namespace devscan {
+		/// FNV-1a hash, continues hashing with the given hash value
+		inline uint64_t fnv1a(const char* pData, size_t length, uint64_t hash = 14695981039346656037ULL)
+		{
+			for (size_t i = 0; i < length; ++i) {
+				hash ^= static_cast < unsigned char > (pData[i]);
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+		/// each announcement can be uniquely identified by the so called communication path.
+		/// The communication path is made up of the uuid of the sending device, the name of the sending interface, the name of the receiving interface and the routing device
+		/// We choose the interface names instead of interface addresses because an interface might have several or no IP addresses.
+		/// All strings are interned (see DeviceMonitor). Hence comparing the ids is sufficient. A missing router is the interned empty string.
+		struct communicationPath {
+			/// an invalid path
+			communicationPath();
+
+			communicationPath(string::Interner::id_t receivingInterface, string::Interner::id_t sendingInterface, string::Interner::id_t uuid, string::Interner::id_t router);
+
+			bool operator==(const communicationPath& op) const;
+
+			string::Interner::id_t receivingInterface;
+			string::Interner::id_t sendingInterface;
+			string::Interner::id_t uuid;
+			string::Interner::id_t router;
+
+			/// calculated once on construction
+			uint64_t hash;
+		};
+
+		/// \brief open addressing hash table holding everything DeviceMonitor knows about an announcement.
+		///
+		/// Each announcement gets an entry. Entries are identified by a number that does not change while the entry exists.
+		/// Hence, they might be referenced from elsewhere (expiry heap, fingerprints). Numbers of erased entries are reused.
+		/// The fields of the entries are stored in separate arrays (structure of arrays). Refreshing the time of expiry touches the expiry times only.
+		///
+		/// The index is a separate array of slots holding hash and entry number. It is searched by linear probing.
+		/// Comparing the hashes first, most probes do not touch the communication paths at all.
+		/// Erasing shifts the following slots back. Hence there are no tombstones slowing down lookups over time.
+		/// \warning not thread-safe!
+		class AnnouncementTable
+		{
+		public:
+			typedef uint32_t entry_t;
+
+			static const entry_t NO_ENTRY = 0xffffffff;
+
+			AnnouncementTable();
+
+			/// \return NO_ENTRY if there is no entry for the communication path
+			entry_t find(const communicationPath& path) const;
+
+			/// adds an entry for a communication path not known yet. All fields besides the path are to be set by the caller.
+			entry_t insert(const communicationPath& path);
+
+			void erase(entry_t entry);
+
+			/// \return number of entries
+			size_t size() const
+			{
+				return m_size;
+			}
+
+			/// entry numbers are below this limit
+			entry_t getEntryLimit() const
+			{
+				return static_cast < entry_t > (m_paths.size());
+			}
+
+			/// \return false if the entry number is not in use
+			bool isUsed(entry_t entry) const
+			{
+				return m_paths[entry].receivingInterface!=string::Interner::NO_ID;
+			}
+
+			const communicationPath& getPath(entry_t entry) const
+			{
+				return m_paths[entry];
+			}
+
+			std::chrono::steady_clock::time_point getTimeOfExpiry(entry_t entry) const
+			{
+				return m_timesOfExpiry[entry];
+			}
+
+			void setTimeOfExpiry(entry_t entry, std::chrono::steady_clock::time_point timeOfExpiry)
+			{
+				m_timesOfExpiry[entry] = timeOfExpiry;
+			}
+
+			/// expiration as announced. Used to refresh the time of expiry without parsing repeated announcements.
+			std::chrono::seconds getExpiration(entry_t entry) const
+			{
+				return m_expirations[entry];
+			}
+
+			void setExpiration(entry_t entry, std::chrono::seconds expiration)
+			{
+				m_expirations[entry] = expiration;
+			}
+
+			/// the announcement as received, stored in a PayloadArena
+			PayloadArena::handle_t getPayload(entry_t entry) const
+			{
+				return m_payloads[entry];
+			}
+
+			void setPayload(entry_t entry, PayloadArena::handle_t payload)
+			{
+				m_payloads[entry] = payload;
+			}
+
+			/// hash over receiving interface id and announcement
+			uint64_t getFingerprint(entry_t entry) const
+			{
+				return m_fingerprints[entry];
+			}
+
+			void setFingerprint(entry_t entry, uint64_t fingerprint)
+			{
+				m_fingerprints[entry] = fingerprint;
+			}
+
+			/// position in the expiry heap
+			size_t getHeapPosition(entry_t entry) const
+			{
+				return m_heapPositions[entry];
+			}
+
+			void setHeapPosition(entry_t entry, size_t heapPosition)
+			{
+				m_heapPositions[entry] = static_cast < uint32_t > (heapPosition);
+			}
+
+			/// \return bytes allocated from the heap for the index and the entries. Interned strings are not included.
+			size_t getResidentBytes() const;
+
+		private:
+			typedef std::vector < uint64_t > hashes_t;
+			typedef std::vector < entry_t > entries_t;
+
+			/// objects must not be copied
+			AnnouncementTable(const AnnouncementTable& op);
+
+			/// objects must not be assigned
+			AnnouncementTable& operator=(const AnnouncementTable& op);
+
+			/// \return the slot to start probing at
+			size_t getHomeSlot(uint64_t hash) const
+			{
+				// multiplicative hashing spreads hashes with differences in the upper bits only
+				return static_cast < size_t > ((hash * 0x9e3779b97f4a7c15ULL) >> m_shift);
+			}
+
+			/// \param slotCount power of 2
+			void rehash(size_t slotCount);
+
+			/// puts the entry into the first free slot
+			void insertSlot(uint64_t hash, entry_t entry);
+
+			/// number of entries in use
+			size_t m_size;
+
+			/// the index, NO_ENTRY marks a free slot
+			hashes_t m_slotHashes;
+			entries_t m_slotEntries;
+			/// m_slotEntries.size()-1
+			size_t m_slotMask;
+			/// 64 - log2(slot count)
+			unsigned int m_shift;
+
+			/// the entries, one array per field
+			std::vector < communicationPath > m_paths;
+			std::vector < std::chrono::steady_clock::time_point > m_timesOfExpiry;
+			std::vector < std::chrono::seconds > m_expirations;
+			std::vector < PayloadArena::handle_t > m_payloads;
+			std::vector < uint64_t > m_fingerprints;
+			std::vector < uint32_t > m_heapPositions;
+
+			/// numbers of erased entries to be reused
+			entries_t m_freeEntries;
+		};
+	}
+}
+#endif
@@ -0,0 +1,152 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef _CALLBACKDISPATCHER_H
+#define _CALLBACKDISPATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <stdint.h>
+
+
+#include "receiver_if.h"
+#include "receivermetrics.h"
+
+
+namespace hbm {
+	namespace devscan {
+
+		/// \brief executes announce, expire and error callbacks by a separate thread.
+		///
+		/// Events are pushed into a bounded lock-free ring buffer (multiple producers, single consumer) and are
+		/// delivered by a worker thread in the order they were pushed. Slow callbacks do not stall the pushing thread.
+		/// If the ring buffer is full, the overflow policy decides what happens. Dropped events are reported
+		/// to the error callback with cb_t::DATA_DROPPED | cb_t::ERROR_OVERFLOW.
+		class CallbackDispatcher
+		{
+		public:
+			enum eventType_t {
+				EVENT_ANNOUNCE,
+				EVENT_EXPIRE,
+				EVENT_ERROR
+			};
+
+			/// a callback to be executed with its arguments
+			struct event_t {
+				eventType_t type;
+				std::string uuid;
+				std::string receivingInterfaceName;
+				std::string sendingInterfaceName;
+				std::string router;
+				/// announcement or received data of an error
+				std::string data;
+				std::string userMessage;
+				uint32_t errorCode;
+				/// when a new or changed announcement was stored. Default for anything else.
+				std::chrono::steady_clock::time_point updated;
+			};
+
+			enum overflowPolicy_t {
+				/// the event to be pushed is dropped
+				OVERFLOW_DROP,
+				/// the pushing thread waits until there is room
+				OVERFLOW_WAIT
+			};
+
+			/// starts the worker thread
+			/// \param capacity maximum number of queued events. Rounded up to the next power of 2.
+			CallbackDispatcher(size_t capacity, overflowPolicy_t overflowPolicy);
+
+			/// delivers all queued events and stops the worker thread
+			virtual ~CallbackDispatcher();
+
+			void setAnnounceCb(announceCb_t cb);
+			void setExpireCb(expireCb_t cb);
+			void setErrorCb(errorCb_t cb);
+
+			/// \param pMetrics executing callbacks is counted here. NULL to stop counting.
+			void setMetrics(ReceiverMetrics* pMetrics);
+
+			void pushAnnouncement(const std::string& uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router, const std::string& announcement);
+			void pushExpiry(const std::string& uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router);
+			void pushError(uint32_t errorCode, const std::string& userMessage, const std::string& receivedData);
+			/// the event is moved into the ring buffer
+			void push(event_t& event);
+
+			/// executes the callback matching the event directly. Exceptions thrown by the callback are swallowed.
+			/// \param pMetrics announce and expire callbacks are timed here. NULL for not timing them.
+			static void execute(const event_t& event, const announceCb_t& announceCb, const expireCb_t& expireCb, const errorCb_t& errorCb, ReceiverMetrics* pMetrics);
+
+			/// \return number of events dropped since construction
+			uint64_t getDroppedCount() const
+			{
+				return m_droppedCount.load(std::memory_order_relaxed);
+			}
+
+		private:
+			/// element of the ring buffer. The sequence tells whether the cell is to be written or to be read.
+			struct cell_t {
+				std::atomic < size_t > sequence;
+				event_t event;
+			};
+
+			/// objects must not be copied
+			CallbackDispatcher(const CallbackDispatcher& op);
+			/// objects must not be assigned
+			CallbackDispatcher& operator=(const CallbackDispatcher& op);
+
+			/// \return false if the ring buffer is full
+			bool tryPush(event_t& event);
+			/// to be called by the worker thread only
+			/// \return false if the ring buffer is empty
+			bool tryPop(event_t& event);
+			/// to be called by the worker thread only
+			bool isEmpty() const;
+
+			/// wakes up the worker thread if it is waiting
+			void wakeUp();
+
+			void deliver(const event_t& event);
+			void reportDroppedEvents();
+			void run();
+
+			std::unique_ptr < cell_t[] > m_cells;
+			size_t m_mask;
+			overflowPolicy_t m_overflowPolicy;
+
+			/// producers and consumer work on different cache lines
+			char m_padding0[64];
+			std::atomic < size_t > m_enqueuePosition;
+			char m_padding1[64];
+			size_t m_dequeuePosition;
+			char m_padding2[64];
+
+			std::atomic < uint64_t > m_droppedCount;
+			/// number of dropped events already reported
+			uint64_t m_reportedDroppedCount;
+
+			/// the worker thread sleeps only if there is nothing to do
+			std::atomic < bool > m_workerWaiting;
+			std::mutex m_wakeUpMtx;
+			std::condition_variable m_wakeUpCondition;
+			bool m_stopRequested;
+
+			/// guards the callbacks. Not held while a callback is being executed.
+			std::mutex m_callbackMtx;
+			announceCb_t m_announceCb;
+			expireCb_t m_expireCb;
+			errorCb_t m_errorCb;
+			/// not owned by this object
+			ReceiverMetrics* m_pMetrics;
+
+			std::thread m_worker;
+		};
+	}
+}
+#endif
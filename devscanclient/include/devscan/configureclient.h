@@ -5,22 +5,41 @@
 #ifndef _ConfigureClient_H
 #define _ConfigureClient_H
 
+#include <atomic>
 #include <string>
 #include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "hbm/communication/multicastserver.h"
 #include "hbm/communication/netadapterlist.h"
 #include "hbm/sys/eventloop.h"
+#include "hbm/sys/notifier.h"
+#include "hbm/sys/timer.h"
 namespace hbm {
 	namespace devscan {
-		/// this class sends HBM scan network configuration requests, and waits for the response.
+		/// \brief this class sends HBM scan network configuration requests, and waits for the response.
+		///
+		/// Requests might be executed asynchronously. Many requests might be outstanding at the same time.
+		/// Responses are received by a thread of this object. Each request is matched with its response by the id of the request.
 		class ConfigureClient
 		{
 		public:
-			/// starts the multicast server listening for incoming messages
+			/// called once for each asynchronous request. Executed by the receiving thread of this object.
+			/// Requests still outstanding on destruction are completed by the destroying thread.
+			/// \warning do not call the synchronous requests from within. They wait for the receiving thread executing the callback.
+			/// \param response empty string if no answer was received in time. Otherwise JSON rpc response from device.
+			typedef std::function < void (const std::string& response) > responseCb_t;
+
+			/// starts the multicast server listening for incoming messages and the thread receiving the responses
 			ConfigureClient();
 
-			/// stops the multicast server
+			/// stops the multicast server. Requests still outstanding are completed with an empty response.
 			~ConfigureClient();
 
 			/// \brief sets the interface configuration-method of a device
@@ -78,26 +97,104 @@ namespace hbm {
 			/// sends a request to multicast group CONFIG_IPV4_ADDRESS and waits some time (TIMETOWAITFORANSWERS) for the answer
 			/// \param outgoingInterfaceIp  IP address of the interface to use leave empty ("") in order to send over all interfaces
 			/// \param ttl  number of maximum hops to the receiver (1 do not scan behind network routers)
-			/// \param id  a (unique) string identifying the request to send and match the corresponding response
+			/// \param id  a (unique) string identifying the request to send and match the corresponding response. The id carried by message.
 			/// \param message  complete JSOM-message to send, as a plain string
 			/// \return empty string if no answer was received. Otherwise JSON rpc response from device.
 			/// \throws std::runtime_error
-			std::string executeRequest(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& message);
+			std::string executeRequest(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& id, const std::string& message);
+
+			/// \brief sends a request and returns without waiting for the answer
+			///
+			/// The request is completed when the answer is received or when the time to wait has elapsed.
+			/// Requests sent before do not delay this one.
+			/// \param id the id carried by message
+			/// \param message complete JSON-message to send, as a plain string
+			/// \param timeToWait how long to wait for the answer
+			/// \param responseCb optional, called on completion
+			/// \return gets the JSON rpc response from the device. Empty string if no answer was received.
+			std::future < std::string > executeRequestAsync(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& id, const std::string& message, std::chrono::milliseconds timeToWait, responseCb_t responseCb = responseCb_t());
+
+			/// asynchronous variants of the requests above. Each waits TIMETOWAITFORANSWERS for the answer.
+			/// \see executeRequestAsync
+			std::future < std::string > setInterfaceConfigurationMethodAsync(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& method, responseCb_t responseCb = responseCb_t());
+			std::future < std::string > setDefaultGatewayAsync(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& ipv4DefaultGateWay, responseCb_t responseCb = responseCb_t());
+			std::future < std::string > setInterfaceManualConfigurationAsync(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& address, const std::string& netmask, responseCb_t responseCb = responseCb_t());
+			std::future < std::string > setInterfaceConfigurationAsync(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& method, const std::string& manualAddress, const std::string& manualNetmask, responseCb_t responseCb = responseCb_t());
+
+			/// \return number of requests waiting for their answer
+			size_t getOutstandingRequestCount() const;
 
 		private:
+			typedef std::shared_ptr < std::promise < std::string > > promisePtr_t;
+
+			/// ordered by the point in time the request expires
+			typedef std::multimap < std::chrono::steady_clock::time_point, std::string > deadlines_t;
+
+			struct outstandingRequest_t {
+				promisePtr_t pPromise;
+				responseCb_t responseCb;
+				/// the position in m_deadlines
+				deadlines_t::iterator deadline;
+			};
+
+			/// outstanding requests by id
+			typedef std::unordered_map < std::string, outstandingRequest_t > outstandingRequests_t;
+
+			/// objects must not be copied
+			ConfigureClient(const ConfigureClient& op);
+
+			/// objects must not be assigned
+			ConfigureClient& operator=(const ConfigureClient& op);
+
 			/// Each json rpc request carries an id. The response to each request will carry the id of the request.
 			/// We are sending/receiving multicast messages. Hence we see responses for requests from other other clients that are not meant for us.
 			/// The id created herein is a bit more noisy in order recognize the correct response.
 			std::string createId() const;
 
+			/// the messages of the requests above. The id of the request is to be given.
+			static std::string createInterfaceConfigurationMethodRequest(unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& method, const std::string& id);
+			static std::string createDefaultGatewayRequest(unsigned char ttl, const std::string& uuid, const std::string& ipv4DefaultGateWay, const std::string& id);
+			static std::string createInterfaceManualConfigurationRequest(unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& address, const std::string& netmask, const std::string& id);
+			static std::string createInterfaceConfigurationRequest(unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& method, const std::string& manualAddress, const std::string& manualNetmask, const std::string& id);
+
+			/// fulfils the promise and calls the callback of a request that is not outstanding anymore
+			static void completeRequest(const outstandingRequest_t& request, const std::string& response);
+
 			int recvCb(communication::MulticastServer* mcs);
 
+			/// executed by the receiving thread after a request was added
+			void requestAddedCb();
+
+			/// completes all requests that expired
+			void expirationTimerCb(bool fired);
+
+			/// arms the expiration timer for the request expiring next. To be called by the receiving thread.
+			void armExpirationTimer();
+
 			sys::EventLoop m_eventloop;
 			communication::NetadapterList m_netadapterList;
 			communication::MulticastServer m_MulticastServer;
 
-			std::string m_id;
-			std::string m_response;
+			/// serializes sending of requests from several threads
+			std::mutex m_sendMtx;
+
+			outstandingRequests_t m_outstandingRequests;
+			deadlines_t m_deadlines;
+			/// protects m_outstandingRequests and m_deadlines
+			mutable std::mutex m_outstandingRequestsMtx;
+
+			/// tells the receiving thread about requests added
+			sys::Notifier m_requestAddedNotifier;
+			sys::Timer m_expirationTimer;
+			/// the point in time the expiration timer is armed for. Only used by the receiving thread.
+			std::chrono::steady_clock::time_point m_expirationTimerDeadline;
+			bool m_expirationTimerArmed;
+
+			/// executes m_eventloop
+			std::thread m_receiver;
+
+			/// makes ids of requests created within the same second unique
+			mutable std::atomic < unsigned int > m_requestCount;
 
 			static const std::chrono::milliseconds TIMETOWAITFORANSWERS;
 		};
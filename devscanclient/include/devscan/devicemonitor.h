@@ -7,11 +7,20 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <functional>
 #include <chrono>
+#include <stdint.h>
 
 
+#include "hbm/string/interner.h"
+
 #include "receiver_if.h"
+#include "announcementdecoder.h"
+#include "announcementtable.h"
+#include "nodepool.h"
+#include "payloadarena.h"
+#include "receivermetrics.h"
 
 
 namespace hbm {
@@ -23,6 +32,27 @@ namespace hbm {
 		class DeviceMonitor
 		{
 		public:
+			/// heap memory used for keeping track of the announcements
+			struct memoryUsage_t {
+				memoryUsage_t();
+
+				/// \return sum of all parts
+				size_t getResidentBytes() const;
+
+				/// Devices announcing via several interfaces or routers are counted once per communication path.
+				/// \return 0 if no device is being tracked
+				size_t getBytesPerDevice() const;
+
+				/// number of communication paths being tracked
+				size_t deviceCount;
+				/// slabs holding the announcements
+				size_t payloadBytes;
+				/// chunks holding the nodes of the fingerprint map
+				size_t nodeBytes;
+				/// announcement table, bucket array of the fingerprint map and expiry heap
+				size_t indexBytes;
+			};
+
 			DeviceMonitor();
 
 			/// \brief sets the callback, that is to be executed on each new or changed announcement
@@ -46,55 +76,122 @@ namespace hbm {
 			/// \param message  the data, as it was received from the network
 			/// \see setAnnounceCb
 			/// \see setErrorCb
-			void processReceivedAnnouncement(std::string interfaceName, const std::string &message);
+			void processReceivedAnnouncement(const std::string& interfaceName, const std::string &message);
+
+			/// \brief same as above but works on the receive buffer directly.
+			/// The message is copied only if it is new or has changed.
+			/// \param interfaceName  name of the networ interface which received the data
+			/// \param pMessage  the data, as it was received from the network
+			/// \param messageLength  number of bytes in pMessage
+			/// \param timeOfArrival  when the message arrived at the socket. Used for metrics only. Default for unknown.
+			void processReceivedAnnouncement(const std::string& interfaceName, const char* pMessage, size_t messageLength, std::chrono::system_clock::time_point timeOfArrival = std::chrono::system_clock::time_point());
+
+			/// \brief same as above but the receiving interface is identified by an id.
+			/// Nothing is looked up by name. Strings are resolved only when calling callbacks.
+			/// \param interfaceId  id of the network interface which received the data
+			/// \see acquireInterfaceId()
+			void processReceivedAnnouncement(string::Interner::id_t interfaceId, const char* pMessage, size_t messageLength, std::chrono::system_clock::time_point timeOfArrival = std::chrono::system_clock::time_point());
+
+			/// \return id of the interface name to be used with processReceivedAnnouncement(). Valid until released.
+			string::Interner::id_t acquireInterfaceId(const std::string& interfaceName);
+
+			/// each id acquired is to be released once
+			void releaseInterfaceId(string::Interner::id_t interfaceId);
 
 			/// \brief checks all announcements for missing refresh, considering expiration time.
-			/// walks through all known announcements. Each expired entry will
+			/// Only announcements that are due are being touched. Each expired entry will
 			/// be removed and expire callback will be fired.
 			/// \see setExpireCb
 			void checkForExpiredAnnouncements();
 
 			void checkForExpiredTimerCb(bool fired);
 
-		private:
-			struct expiringEntry {
-				std::string announcement;
-				std::chrono::steady_clock::time_point timeOfExpiry;
-			};
+			/// \param pMetrics processing of announcements is counted here. NULL to stop counting.
+			/// \param timeCallbacks false if the callbacks only hand over the notifications. Whoever executes them times them instead.
+			void setMetrics(ReceiverMetrics* pMetrics, bool timeCallbacks = true);
 
-			/// each announcement can be uniquely identified by the so called communication path.
-			/// The communication path is made up of the uuid of the sending device, the name of the sending interface, the name of the receiving interface and the routing device
-			/// We choose the interface names instead of interface addresses because an interface might have several or no IP addresses.
-			struct communicationPath {
-				/// \throws on invalid communication path
-				communicationPath(const std::string &communicationPath);
-
-				std::string receivingInterface;
-				std::string uuid;
-				std::string sendingInterface;
-				std::string router;
-			};
+			/// \return the point in time when the next announcement is going to expire if not being refreshed before.
+			/// std::chrono::steady_clock::time_point::max() if there is no announcement.
+			std::chrono::steady_clock::time_point getNextExpiry() const;
 
+			memoryUsage_t getMemoryUsage() const;
+
+		private:
 			/// objects must not be copied
 			DeviceMonitor(const DeviceMonitor& op);
 
 			/// objects must not be assigned
 			DeviceMonitor& operator=(const DeviceMonitor& op);
 
-			/// communication path (<receiving interface name>:<sending interface name>:<uuid of sender>:<uuid of router empty for none>) is key
-			typedef std::unordered_map < std::string, expiringEntry > announcements_t;
+			/// nodes of m_fingerprints. Declared before it in order to be destructed after it.
+			NodePool m_nodePool;
+
+			/// announcements of all entries of m_announcements
+			PayloadArena m_payloads;
 
 			/// we keep all current announcements in order to detect changed announcements.
 			/// \warning access is not synchronized!
-			announcements_t m_announcements;
+			AnnouncementTable m_announcements;
+
+			/// interface names, uuids and routers of all communication paths.
+			/// Each entry of m_announcements holds a reference to each string of its path.
+			string::Interner m_strings;
+
+			/// releases the references held by the path
+			void releasePath(const communicationPath& path);
+
+			/// \return copy of the announcement of the entry
+			std::string getAnnouncement(AnnouncementTable::entry_t entry) const;
+
+			typedef PoolAllocator < std::pair < const uint64_t, AnnouncementTable::entry_t > > fingerprintsAllocator_t;
+
+			/// fingerprint of receiving interface id and announcement is the key
+			typedef std::unordered_map < uint64_t, AnnouncementTable::entry_t, std::hash < uint64_t >, std::equal_to < uint64_t >, fingerprintsAllocator_t > fingerprints_t;
+
+			/// Most announcements received are repetitions of known ones.
+			/// Those are recognized by their fingerprint without parsing them.
+			fingerprints_t m_fingerprints;
+
+			/// \return true if the announcement is a repetition of a known one. Its time of expiry got refreshed.
+			bool refreshRepeatedAnnouncement(uint64_t fingerprint, string::Interner::id_t receivingInterface, const char* pMessage, size_t messageLength, std::chrono::steady_clock::time_point now);
+
+			void eraseFingerprint(AnnouncementTable::entry_t entry);
+
+			/// adds a new announcement or updates the known one with the same communication path.
+			/// Strings are interned only when adding a new communication path.
+			void updateAnnouncement(string::Interner::id_t receivingInterface, const AnnouncementDecoder::field_t& sendingInterfaceName, const AnnouncementDecoder::field_t& sendingUuid, const AnnouncementDecoder::field_t& router, std::chrono::seconds expire, const char* pMessage, size_t messageLength, uint64_t fingerprint, std::chrono::steady_clock::time_point now);
+
+			typedef std::vector < AnnouncementTable::entry_t > expiryHeap_t;
+
+			/// binary min-heap of all announcements ordered by time of expiry.
+			/// Each entry knows its position in the heap. Hence a refreshed entry can be moved to its new position directly.
+			expiryHeap_t m_expiryHeap;
+
+			void expiryHeapPush(AnnouncementTable::entry_t entry);
+			/// to be called after changing the time of expiry of an entry
+			void expiryHeapUpdate(size_t position);
+			void expiryHeapPop();
+			void expiryHeapSwap(size_t position1, size_t position2);
+			/// \return new position
+			size_t expiryHeapSiftUp(size_t position);
+			void expiryHeapSiftDown(size_t position);
 
 			announceCb_t m_announceCb;
 			expireCb_t   m_expireCb;
 			errorCb_t    m_errorCb;
 
+			/// not owned by this object
+			ReceiverMetrics* m_pMetrics;
+			/// callbacks and UPDATE_TO_CALLBACK_RETURN are counted
+			bool m_timeCallbacks;
+
+			void notifyAnnouncement(const communicationPath& path, const std::string& announcement);
+			void notifyExpiry(const communicationPath& path);
+
 			/// for convenience: report an 'internal' error via the error callback.
 			/// Has no effect in case no error callback was set.
 			void callErrorCb(uint32_t errorCode, const std::string& userMessage, const std::string& announcement);
+			void callErrorCb(uint32_t errorCode, const std::string& userMessage, const char* pAnnouncement, size_t announcementLength);
 		};
 	}
 }
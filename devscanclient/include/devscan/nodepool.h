@@ -0,0 +1,151 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef _NODEPOOL_H
+#define _NODEPOOL_H
+
+#include <memory>
+#include <new>
+#include <vector>
+#include <stddef.h>
+
+
+namespace hbm {
+	namespace devscan {
+
+		/// \brief hands out blocks of fixed size carved from large chunks.
+		///
+		/// Meant for the nodes of node based containers (std::unordered_map). Instead of one heap allocation per node,
+		/// there is one per CHUNK_SIZE bytes. Freed blocks are kept in a free list per block size and reused by the next allocation.
+		/// Hence, a churning population of constant size does not grow or fragment the heap.
+		/// Chunks are freed on destruction only.
+		/// \warning not thread-safe!
+		class NodePool
+		{
+		public:
+			static const size_t CHUNK_SIZE = 16*1024;
+
+			/// block sizes are rounded up to a multiple of this
+			static const size_t ALIGNMENT = 16;
+
+			NodePool();
+
+			void* allocate(size_t size);
+
+			/// \param size as given to allocate()
+			void deallocate(void* pBlock, size_t size);
+
+			/// \return bytes allocated from the heap for chunks
+			size_t getResidentBytes() const
+			{
+				return m_residentBytes;
+			}
+
+			/// \return bytes of all blocks currently handed out
+			size_t getUsedBytes() const
+			{
+				return m_usedBytes;
+			}
+
+		private:
+			/// free blocks are linked through their first bytes
+			struct freeBlock_t {
+				freeBlock_t* pNext;
+			};
+
+			struct sizeClass_t {
+				size_t blockSize;
+				freeBlock_t* pFree;
+				/// not yet used part of the last chunk of this size class
+				char* pUnused;
+				char* pEnd;
+			};
+
+			typedef std::vector < sizeClass_t > sizeClasses_t;
+			typedef std::vector < std::unique_ptr < char[] > > chunks_t;
+
+			/// objects must not be copied
+			NodePool(const NodePool& op);
+
+			/// objects must not be assigned
+			NodePool& operator=(const NodePool& op);
+
+			sizeClass_t& getSizeClass(size_t blockSize);
+
+			/// there are just a few different node sizes
+			sizeClasses_t m_sizeClasses;
+			chunks_t m_chunks;
+			size_t m_residentBytes;
+			size_t m_usedBytes;
+		};
+
+		/// \brief allocator for node based containers. Single objects are taken from a NodePool, arrays (i.e. bucket arrays) from the heap.
+		template < typename T >
+		class PoolAllocator
+		{
+		public:
+			typedef T value_type;
+			typedef T* pointer;
+			typedef const T* const_pointer;
+			typedef T& reference;
+			typedef const T& const_reference;
+			typedef size_t size_type;
+			typedef ptrdiff_t difference_type;
+
+			template < typename U >
+			struct rebind {
+				typedef PoolAllocator < U > other;
+			};
+
+			explicit PoolAllocator(NodePool& pool)
+				: m_pPool(&pool)
+			{
+			}
+
+			template < typename U >
+			PoolAllocator(const PoolAllocator < U >& op)
+				: m_pPool(op.getPool())
+			{
+			}
+
+			T* allocate(size_t count)
+			{
+				if (count==1) {
+					return static_cast < T* > (m_pPool->allocate(sizeof(T)));
+				}
+				return static_cast < T* > (::operator new(count*sizeof(T)));
+			}
+
+			void deallocate(T* pObject, size_t count)
+			{
+				if (count==1) {
+					m_pPool->deallocate(pObject, sizeof(T));
+				} else {
+					::operator delete(pObject);
+				}
+			}
+
+			NodePool* getPool() const
+			{
+				return m_pPool;
+			}
+
+			template < typename U >
+			bool operator==(const PoolAllocator < U >& op) const
+			{
+				return m_pPool==op.getPool();
+			}
+
+			template < typename U >
+			bool operator!=(const PoolAllocator < U >& op) const
+			{
+				return m_pPool!=op.getPool();
+			}
+
+		private:
+			NodePool* m_pPool;
+		};
+	}
+}
+#endif
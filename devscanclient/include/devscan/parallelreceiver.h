@@ -0,0 +1,157 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef _PARALLELRECEIVER_H
+#define _PARALLELRECEIVER_H
+
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+#include "hbm/communication/netadapterlist.h"
+#include "hbm/communication/netlink.h"
+#include "hbm/sys/eventloop.h"
+#include "hbm/sys/timer.h"
+
+
+#include "receiver_if.h"
+#include "announcementcollector.h"
+#include "receivermetrics.h"
+
+
+namespace hbm {
+	namespace devscan {
+
+
+		/// \class ParallelReceiver
+		/// \brief Like Receiver but announcements are received and processed by several worker threads.
+		///
+		/// Meant for hosts receiving lots of announcements via many interfaces (i.e. VLANs).
+		/// Each worker thread runs its own event loop with its own receiving socket and DeviceMonitor.
+		/// The receiving interfaces are distributed among the workers by interface index.
+		/// Each socket receives only via the interfaces of its worker (IP_MULTICAST_ALL is reset). Since the
+		/// receiving interface is part of the communication path, each announcement is kept by exactly one worker.
+		/// Workers without interface stay idle. Hence there is no benefit from more workers than receiving interfaces.
+		///
+		/// Threading contract:
+		/// <ul>
+		/// <li> Announce, expire and error callbacks are executed by the worker threads.
+		///      When setting the announce callback, it is executed for all current announcements by the thread setting the callback.
+		/// <li> Callbacks are never executed concurrently. The callbacks of one communication path arrive in order.
+		/// <li> Callbacks must not set callbacks of this object.
+		/// </ul>
+		class ParallelReceiver: public ReceiverIf
+		{
+		public:
+			/// \param workerCount number of worker threads. 0 for one per processor core.
+			ParallelReceiver(unsigned int workerCount = 0);
+
+			/// set the callback method to be called on arrival of new or change of an already known announcement
+			virtual void setAnnounceCb(announceCb_t cb);
+			/// set the callback method to be called on expiration of an announcement
+			virtual void setExpireCb(expireCb_t cb);
+			/// set the callback method to be called on errors in the received network telegram
+			virtual void setErrorCb(errorCb_t cb);
+
+			/// Callbacks are executed by a separate thread per worker from now on. Still, they are not executed concurrently.
+			/// \see AnnouncementCollector::startDispatching()
+			void startDispatching(size_t capacity, CallbackDispatcher::overflowPolicy_t overflowPolicy);
+
+			/// Executes all pending callbacks. Callbacks are executed directly from now on.
+			void stopDispatching();
+
+			/// To be called before start(). Each worker has its own receive buffer of this size.
+			/// \see communication::MulticastServer::setReceiveBufferSize()
+			void setReceiveBufferSize(int size, int maxSize = 0);
+
+			/// \return counters of receiving and processing announcements, including the drops of the kernel
+			ReceiverMetrics::snapshot_t getMetrics() const;
+
+			/// The callback is executed periodically by the event loop with the current and the previous metrics. To be called before start().
+			/// \param cb empty callback to stop
+			/// \see ReceiverMetrics::format()
+			void setMetricsCb(metricsCb_t cb, std::chrono::milliseconds interval);
+
+			/// \return number of announcements dropped by the kernel because the receive buffer of a worker was full
+			uint64_t getKernelDropCount() const;
+
+			/// Start worker threads that collect announcements, retire expired announcements.
+			/// Under Linux network events (like new network interfaces) are handled by the calling thread.
+			/// Returns after the specified time, on execution of stop() or if an error occurs.
+			/// \param timeOfExecution amount of time in ms to execute.
+			virtual void start_for(std::chrono::milliseconds timeOfExecution);
+
+			/// Start worker threads that collect announcements, retire expired announcements.
+			/// Under Linux network events (like new network interfaces) are handled by the calling thread.
+			/// Returns on execution of stop() or if an error occurs.
+			virtual void start();
+
+			virtual void stop();
+
+			unsigned int getWorkerCount() const
+			{
+				return static_cast < unsigned int > (m_workers.size());
+			}
+
+		private:
+			struct worker_t {
+				worker_t(communication::NetadapterList& netadapterList);
+
+				sys::EventLoop eventloop;
+				AnnouncementCollector collector;
+				std::thread thread;
+			};
+
+			typedef std::vector < std::unique_ptr < worker_t > > workers_t;
+
+			/// objects must not be copied
+			ParallelReceiver(const ParallelReceiver& op);
+
+			/// objects must not be assigned
+			ParallelReceiver& operator=(const ParallelReceiver& op);
+
+			/// \return the index of the worker responsible for the interface
+			size_t getWorkerIndex(unsigned int adapterIndex) const;
+
+			void netLinkEventHandler(Netlink::event_t event);
+
+			/// each interface is added to the worker responsible for it. Each worker leaves the group via the interfaces that are gone.
+			void updateAllInterfaces();
+
+			/// starts the workers, executes the event loop of the calling thread and waits for the workers to finish
+			/// \param timeOfExecution 0 to execute until stop() is called
+			void execute(std::chrono::milliseconds timeOfExecution);
+
+			/// the callbacks of all workers. Serialize execution of the user provided callbacks.
+			void announceCb(const std::string uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router, const std::string& announcement);
+			void expireCb(const std::string uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router);
+			void errorCb(uint32_t errorCode, const std::string& userMessage, const std::string& receivedData);
+
+			/// executed by the thread executing start()
+			void metricsTimerCb(bool fired);
+
+			sys::EventLoop m_eventloop;
+			communication::NetadapterList m_netadapterList;
+			Netlink m_netlink;
+			/// shared by all workers
+			ReceiverMetrics m_metrics;
+			workers_t m_workers;
+
+			sys::Timer m_metricsTimer;
+			metricsCb_t m_metricsCb;
+			ReceiverMetrics::snapshot_t m_previousMetrics;
+
+			std::mutex m_callbackMtx;
+			announceCb_t m_announceCb;
+			expireCb_t m_expireCb;
+			errorCb_t m_errorCb;
+		};
+	}
+}
+#endif
@@ -0,0 +1,113 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef _PAYLOADARENA_H
+#define _PAYLOADARENA_H
+
+#include <memory>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace hbm {
+	namespace devscan {
+
+		/// \brief stores byte strings (announcements) in large slabs instead of one heap allocation each.
+		///
+		/// Payloads are referenced by handles. Payloads are appended to the current slab. Space of released payloads is not reused directly.
+		/// Once more than half of the space used is garbage, all payloads are moved into new slabs (compaction) and the old slabs are freed.
+		/// Handles stay valid during compaction. Hence, memory stays bounded by about twice the size of the live payloads
+		/// no matter how often devices come and go.
+		/// \warning not thread-safe!
+		class PayloadArena
+		{
+		public:
+			typedef uint32_t handle_t;
+
+			static const handle_t NO_HANDLE = 0xffffffff;
+
+			/// payloads are allocated from slabs of this size. Larger payloads get a slab of their own.
+			static const size_t SLAB_SIZE = 64*1024;
+
+			PayloadArena();
+
+			/// copies the payload into the arena
+			/// \return handle to the payload
+			handle_t store(const char* pData, size_t length);
+
+			/// the handle might be reused by the next payload stored
+			void release(handle_t handle);
+
+			/// \warning valid until the next call of store(), release() or compact()
+			const char* getData(handle_t handle) const
+			{
+				const payload_t& payload = m_payloads[handle];
+				return m_slabs[payload.slab].pData.get() + payload.offset;
+			}
+
+			size_t getLength(handle_t handle) const
+			{
+				return m_payloads[handle].length;
+			}
+
+			/// \return true if the payload is equal to the data given
+			bool equals(handle_t handle, const char* pData, size_t length) const;
+
+			/// moves all payloads into as few slabs as possible. Done automatically by release() if there is too much garbage.
+			void compact();
+
+			/// \return sum of the length of all payloads stored
+			size_t getPayloadBytes() const
+			{
+				return m_payloadBytes;
+			}
+
+			/// \return bytes allocated from the heap for slabs and handles
+			size_t getResidentBytes() const;
+
+		private:
+			struct payload_t {
+				/// NO_SLAB if the handle is not in use
+				uint32_t slab;
+				uint32_t offset;
+				uint32_t length;
+			};
+
+			struct slab_t {
+				std::unique_ptr < char[] > pData;
+				size_t size;
+			};
+
+			static const uint32_t NO_SLAB = 0xffffffff;
+
+			typedef std::vector < payload_t > payloads_t;
+			typedef std::vector < slab_t > slabs_t;
+			typedef std::vector < handle_t > handles_t;
+
+			/// objects must not be copied
+			PayloadArena(const PayloadArena& op);
+
+			/// objects must not be assigned
+			PayloadArena& operator=(const PayloadArena& op);
+
+			/// appends to the last slab, adds a slab if there is not enough space left
+			/// \param[out] payload slab and offset are set
+			/// \return where to copy the payload to
+			static char* allocate(slabs_t& slabs, size_t& slabUsed, size_t length, payload_t& payload);
+
+			/// indexed by handle
+			payloads_t m_payloads;
+			/// handles not in use
+			handles_t m_freeHandles;
+			slabs_t m_slabs;
+			/// bytes used in the last slab
+			size_t m_slabUsed;
+			/// bytes used in all slabs, including released payloads
+			size_t m_usedBytes;
+			size_t m_payloadBytes;
+		};
+	}
+}
+#endif
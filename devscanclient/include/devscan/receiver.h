@@ -10,7 +10,6 @@
 #include <chrono>
 
 
-#include "hbm/communication/multicastserver.h"
 #include "hbm/communication/netadapterlist.h"
 #include "hbm/communication/netlink.h"
 #include "hbm/sys/eventloop.h"
@@ -18,7 +17,8 @@
 
 
 #include "receiver_if.h"
-#include "devicemonitor.h"
+#include "announcementcollector.h"
+#include "receivermetrics.h"
 
 
 namespace hbm {
@@ -29,6 +29,14 @@ namespace hbm {
 		/// \brief The main class for HBM Scan Clients.
 		/// It receives announcements interprets them and notifies about new,
 		/// changed and expired announcements.
+		///
+		/// Threading contract:
+		/// <ul>
+		/// <li> Announce, expire and error callbacks are executed by the thread executing start() or start_for().
+		///      When setting the announce callback, it is executed for all current announcements by the thread setting the callback.
+		/// <li> No lock is held while a callback is executed. Callbacks may call any method of this object.
+		///      Callbacks executed by the dispatcher thread must not start or stop dispatching though.
+		/// </ul>
 		class Receiver: public ReceiverIf
 		{
 		public:
@@ -41,6 +49,29 @@ namespace hbm {
 			/// set the callback method to be called on errors in the received network telegram
 			virtual void setErrorCb(errorCb_t cb);
 
+			/// Callbacks are executed by a separate thread from now on. Slow callbacks do not stall receiving announcements.
+			/// With CallbackDispatcher::OVERFLOW_WAIT, receiving waits for the dispatcher without holding any lock.
+			/// \see CallbackDispatcher
+			void startDispatching(size_t capacity, CallbackDispatcher::overflowPolicy_t overflowPolicy);
+
+			/// Executes all pending callbacks. Callbacks are executed directly from now on.
+			void stopDispatching();
+
+			/// To be called before start().
+			/// \see communication::MulticastServer::setReceiveBufferSize()
+			void setReceiveBufferSize(int size, int maxSize = 0);
+
+			/// \return counters of receiving and processing announcements, including the drops of the kernel
+			ReceiverMetrics::snapshot_t getMetrics() const;
+
+			/// The callback is executed periodically by the event loop with the current and the previous metrics. To be called before start().
+			/// \param cb empty callback to stop
+			/// \see ReceiverMetrics::format()
+			void setMetricsCb(metricsCb_t cb, std::chrono::milliseconds interval);
+
+			/// \return number of announcements dropped by the kernel because the receive buffer was full
+			uint64_t getKernelDropCount() const;
+
 			/// Start event loop that collects announcements, retires expired announcements.
 			/// Under Linux network events (like new network interfaces) are handled too.
 			/// Returns after the specified time, on execution of stop() or if an error occurs.
@@ -57,15 +88,18 @@ namespace hbm {
 		private:
 			sys::EventLoop m_eventloop;
 			communication::NetadapterList m_netadapterList;
-			communication::MulticastServer m_scanner;
-			sys::Timer m_timer;
-			DeviceMonitor m_deviceMonitor;
+			ReceiverMetrics m_metrics;
+			AnnouncementCollector m_collector;
 
 			Netlink m_netlink;
-			
-			void netLinkEventHandler(Netlink::event_t event, unsigned int adapterIndex, const std::string& ipv4Address);
-			ssize_t receiveEventHandler(communication::MulticastServer *pMcs);
-			ssize_t retireEventHandler();
+
+			sys::Timer m_metricsTimer;
+			metricsCb_t m_metricsCb;
+			ReceiverMetrics::snapshot_t m_previousMetrics;
+
+			void netLinkEventHandler(Netlink::event_t event);
+
+			void metricsTimerCb(bool fired);
 		};
 	}
 }
@@ -160,6 +160,8 @@ namespace hbm {
 			static const uint32_t E_EXCEPTION1 = 0x00000006;
 			/// \brief Error: An internal exception occurred
 			static const uint32_t E_EXCEPTION2 = 0x00000007;
+			/// \brief Error: Callback events were dropped because the dispatch queue was full
+			static const uint32_t ERROR_OVERFLOW = 0x00000008;
 		};
 
 		/// \typedef errorCb_t
@@ -0,0 +1,155 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef _RECEIVERMETRICS_H
+#define _RECEIVERMETRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <stdint.h>
+
+
+namespace hbm {
+	namespace devscan {
+
+		/// \brief counts what happens on the receive path of Receiver and ParallelReceiver.
+		///
+		/// Counting is lock-free. All counters are relaxed atomics. In order to keep threads from fighting for the same cache line,
+		/// each thread counts in its own shard (chosen by thread id). A snapshot sums up all shards.
+		/// Counters are never reset. Rates are calculated from the difference of two snapshots.
+		///
+		/// Latencies are collected in histograms with logarithmic buckets each split into linear sub buckets (like HdrHistogram).
+		/// The relative error of a recorded value is below 1/SUB_BUCKET_COUNT.
+		class ReceiverMetrics
+		{
+		public:
+			enum counter_t {
+				/// system calls that received at least one telegram
+				RECEIVE_CALLS,
+				TELEGRAMS,
+				BYTES,
+				/// telegrams received via an interface not known (yet)
+				UNKNOWN_INTERFACE,
+				/// repetitions of known announcements, recognized without parsing
+				REPEATED,
+				NEW,
+				CHANGED,
+				/// announcements that needed the complete JSON parser
+				PARSED_BY_FALLBACK,
+				/// telegrams dropped because they are no valid announcement
+				PARSE_FAILURES,
+				EXPIRED,
+				/// announce and expire callbacks executed
+				CALLBACKS,
+				/// time spent in callbacks in ns
+				CALLBACK_TIME,
+				COUNTER_COUNT
+			};
+
+			enum latency_t {
+				/// duration of announce and expire callbacks
+				CALLBACK_LATENCY,
+				/// arrival at the socket until processing by the DeviceMonitor starts
+				RECEIVE_TO_PARSE,
+				/// start of processing until the announcement is stored (including fingerprinting and parsing)
+				PARSE_TO_UPDATE,
+				/// announcement stored until the announce callback returned. Only for new and changed announcements.
+				UPDATE_TO_CALLBACK_RETURN,
+				LATENCY_COUNT
+			};
+
+			/// number of linear sub buckets per power of 2
+			static const unsigned int SUB_BUCKET_BITS = 4;
+			static const unsigned int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+			/// durations up to 2^MAX_LATENCY_BITS ns (about 68s) are distinguished. The last bucket counts anything longer.
+			static const unsigned int MAX_LATENCY_BITS = 36;
+			static const unsigned int LATENCY_BUCKET_COUNT = SUB_BUCKET_COUNT * (MAX_LATENCY_BITS - SUB_BUCKET_BITS + 1);
+
+			struct histogram_t {
+				histogram_t();
+
+				/// \return number of recorded values
+				uint64_t getCount() const;
+
+				/// \return largest value in ns the given fraction (0..1) of all recorded values is less or equal to. 0 if there is none.
+				uint64_t getPercentile(double fraction) const;
+
+				uint64_t buckets[LATENCY_BUCKET_COUNT];
+			};
+
+			struct snapshot_t {
+				snapshot_t();
+
+				/// \return ratio of repeated to all processed announcements. 0 if there was none.
+				double getDuplicateRatio() const;
+
+				/// when the snapshot was taken
+				std::chrono::steady_clock::time_point time;
+				uint64_t counters[COUNTER_COUNT];
+				histogram_t latencies[LATENCY_COUNT];
+				/// datagrams dropped by the kernel because the receive buffer was full. Filled by the receiver.
+				uint64_t kernelDrops;
+				/// communication paths being tracked. Filled by the receiver.
+				uint64_t deviceCount;
+				/// heap memory used for tracking them. Filled by the receiver.
+				uint64_t residentBytes;
+			};
+
+			ReceiverMetrics();
+
+			void increment(counter_t counter, uint64_t value = 1)
+			{
+				getShard().counters[counter].fetch_add(value, std::memory_order_relaxed);
+			}
+
+			/// counts a callback and its duration
+			void addCallback(std::chrono::steady_clock::duration duration);
+
+			void addLatency(latency_t latency, std::chrono::nanoseconds duration);
+
+			/// \return the sum of all shards
+			snapshot_t getSnapshot() const;
+
+			/// \return one line of text with the rates in between both snapshots and the totals of the current one
+			static std::string format(const snapshot_t& current, const snapshot_t& previous);
+
+			/// \return one line per latency with count and percentiles
+			static std::string formatLatencies(const snapshot_t& snapshot);
+
+			/// \return index of the bucket counting the value
+			static unsigned int getBucketIndex(uint64_t nanoseconds);
+
+			/// \return largest value in ns counted by the bucket
+			static uint64_t getBucketUpperBound(unsigned int index);
+
+		private:
+			static const unsigned int SHARD_COUNT = 16;
+
+			struct shard_t {
+				std::atomic < uint64_t > counters[COUNTER_COUNT];
+				std::atomic < uint64_t > latencies[LATENCY_COUNT][LATENCY_BUCKET_COUNT];
+				/// shards are on different cache lines
+				char padding[64];
+			};
+
+			/// objects must not be copied
+			ReceiverMetrics(const ReceiverMetrics& op);
+			/// objects must not be assigned
+			ReceiverMetrics& operator=(const ReceiverMetrics& op);
+
+			/// \return the shard of the calling thread
+			shard_t& getShard();
+
+			/// about 270kB. Hence not part of the object itself.
+			std::unique_ptr < shard_t[] > m_shards;
+		};
+
+		/// called periodically with the current and the previous snapshot
+		typedef std::function < void (const ReceiverMetrics::snapshot_t& current, const ReceiverMetrics::snapshot_t& previous) > metricsCb_t;
+	}
+}
+#endif
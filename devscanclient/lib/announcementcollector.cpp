@@ -0,0 +1,358 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <string>
+#include <functional>
+#include <mutex>
+
+#include "hbm/sys/eventloop.h"
+
+#include "announcementcollector.h"
+#include "devicemonitor.h"
+
+#include "defines.h"
+
+namespace hbm {
+	namespace devscan {
+
+		AnnouncementCollector::AnnouncementCollector(communication::NetadapterList& netadapterList, sys::EventLoop& eventLoop)
+			: m_netadapterList(netadapterList)
+			, m_scanner(netadapterList, eventLoop)
+			, m_timer(eventLoop)
+			, m_deviceMonitor()
+			, m_deviceMonitorMtx()
+			, m_pMetrics(NULL)
+			, m_announceCb()
+			, m_expireCb()
+			, m_errorCb()
+			, m_pDispatcher()
+			, m_pendingEvents()
+			, m_receiveBuffer(RECEIVE_BATCH_SIZE * communication::MAX_DATAGRAM_SIZE)
+			, m_interfaceIds()
+			, m_netadapterGeneration(netadapterList.getGeneration())
+			, m_expiryTimerDeadline(std::chrono::steady_clock::time_point::max())
+		{
+			for (unsigned int i = 0; i < RECEIVE_BATCH_SIZE; ++i) {
+				m_telegrams[i].pBuffer = &m_receiveBuffer[i * communication::MAX_DATAGRAM_SIZE];
+				m_telegrams[i].bufferSize = communication::MAX_DATAGRAM_SIZE;
+			}
+		}
+
+		void AnnouncementCollector::collectAnnouncement(const std::string& uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router, const std::string& announcement)
+		{
+			CallbackDispatcher::event_t event;
+			event.type = CallbackDispatcher::EVENT_ANNOUNCE;
+			event.uuid = uuid;
+			event.receivingInterfaceName = receivingInterfaceName;
+			event.sendingInterfaceName = sendingInterfaceName;
+			event.router = router;
+			event.data = announcement;
+			event.errorCode = 0;
+			// m_deviceMonitor reports right after storing the announcement
+			event.updated = std::chrono::steady_clock::now();
+			m_pendingEvents.push_back(std::move(event));
+		}
+
+		void AnnouncementCollector::collectExpiry(const std::string& uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router)
+		{
+			CallbackDispatcher::event_t event;
+			event.type = CallbackDispatcher::EVENT_EXPIRE;
+			event.uuid = uuid;
+			event.receivingInterfaceName = receivingInterfaceName;
+			event.sendingInterfaceName = sendingInterfaceName;
+			event.router = router;
+			event.errorCode = 0;
+			m_pendingEvents.push_back(std::move(event));
+		}
+
+		void AnnouncementCollector::collectError(uint32_t errorCode, const std::string& userMessage, const std::string& receivedData)
+		{
+			CallbackDispatcher::event_t event;
+			event.type = CallbackDispatcher::EVENT_ERROR;
+			event.data = receivedData;
+			event.userMessage = userMessage;
+			event.errorCode = errorCode;
+			m_pendingEvents.push_back(std::move(event));
+		}
+
+		void AnnouncementCollector::takeNotifications(notifications_t& notifications)
+		{
+			if (m_pendingEvents.empty()) {
+				return;
+			}
+			notifications.events.swap(m_pendingEvents);
+			if (m_pDispatcher) {
+				notifications.pDispatcher = m_pDispatcher;
+			} else {
+				notifications.announceCb = m_announceCb;
+				notifications.expireCb = m_expireCb;
+				notifications.errorCb = m_errorCb;
+				notifications.pMetrics = m_pMetrics;
+			}
+		}
+
+		void AnnouncementCollector::deliverNotifications(notifications_t& notifications)
+		{
+			for (events_t::iterator iter = notifications.events.begin(); iter != notifications.events.end(); ++iter) {
+				if (notifications.pDispatcher) {
+					notifications.pDispatcher->push(*iter);
+				} else {
+					CallbackDispatcher::execute(*iter, notifications.announceCb, notifications.expireCb, notifications.errorCb, notifications.pMetrics);
+				}
+			}
+		}
+
+		string::Interner::id_t AnnouncementCollector::getInterfaceId(unsigned int adapterIndex)
+		{
+			interfaceIds_t::const_iterator iter = m_interfaceIds.find(adapterIndex);
+			if (iter!=m_interfaceIds.end()) {
+				return iter->second;
+			}
+
+			// received on an interface we do not know (yet) is remembered as NO_ID until the adapters get updated.
+			string::Interner::id_t interfaceId = string::Interner::NO_ID;
+			communication::NetadapterList::tInterfaceIdentitiesPtr pIdentities = m_netadapterList.getInterfaceIdentities();
+			communication::NetadapterList::tInterfaceIdentities::const_iterator identity = pIdentities->find(adapterIndex);
+			if (identity!=pIdentities->end()) {
+				interfaceId = m_deviceMonitor.acquireInterfaceId(identity->second.name);
+			}
+			m_interfaceIds[adapterIndex] = interfaceId;
+			return interfaceId;
+		}
+
+		void AnnouncementCollector::clearInterfaceIds()
+		{
+			for (interfaceIds_t::const_iterator iter = m_interfaceIds.begin(); iter != m_interfaceIds.end(); ++iter) {
+				if (iter->second!=string::Interner::NO_ID) {
+					m_deviceMonitor.releaseInterfaceId(iter->second);
+				}
+			}
+			m_interfaceIds.clear();
+		}
+
+		ssize_t AnnouncementCollector::receiveEventHandler(communication::MulticastServer* pMcs)
+		{
+			// receive a batch of announcements with one system call.
+			// As long as something was received, the event loop calls us again without waiting for the next event.
+			ssize_t count = pMcs->receiveTelegrams(m_telegrams, RECEIVE_BATCH_SIZE);
+			if (count<=0) {
+				return count;
+			}
+
+			notifications_t notifications;
+			{
+				std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+				processTelegrams(count);
+				takeNotifications(notifications);
+			}
+			deliverNotifications(notifications);
+			return count;
+		}
+
+		void AnnouncementCollector::processTelegrams(ssize_t count)
+		{
+			if (m_pMetrics) {
+				m_pMetrics->increment(ReceiverMetrics::RECEIVE_CALLS);
+				m_pMetrics->increment(ReceiverMetrics::TELEGRAMS, static_cast < uint64_t > (count));
+			}
+			// interface indexes might have been reassigned
+			uint64_t netadapterGeneration = m_netadapterList.getGeneration();
+			if (netadapterGeneration!=m_netadapterGeneration) {
+				clearInterfaceIds();
+				m_netadapterGeneration = netadapterGeneration;
+			}
+			for (ssize_t i = 0; i < count; ++i) {
+				const communication::receivedTelegram_t& telegram = m_telegrams[i];
+				if (m_pMetrics) {
+					m_pMetrics->increment(ReceiverMetrics::BYTES, telegram.length);
+				}
+				string::Interner::id_t interfaceId = getInterfaceId(telegram.adapterIndex);
+				if (interfaceId==string::Interner::NO_ID) {
+					if (m_pMetrics) {
+						m_pMetrics->increment(ReceiverMetrics::UNKNOWN_INTERFACE);
+					}
+					continue;
+				}
+				m_deviceMonitor.processReceivedAnnouncement(interfaceId, static_cast < const char* > (telegram.pBuffer), telegram.length, telegram.timeOfArrival);
+			}
+			armExpiryTimer();
+		}
+
+		void AnnouncementCollector::expiryTimerCb(bool fired)
+		{
+			if (fired==false) {
+				return;
+			}
+
+			notifications_t notifications;
+			{
+				std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+				m_expiryTimerDeadline = std::chrono::steady_clock::time_point::max();
+				m_deviceMonitor.checkForExpiredAnnouncements();
+				armExpiryTimer();
+				takeNotifications(notifications);
+			}
+			deliverNotifications(notifications);
+		}
+
+		void AnnouncementCollector::armExpiryTimer()
+		{
+			// Refreshing announcements moves the next expiry to a later point in time. We do not re-arm the timer for this.
+			// If the timer fires too early, nothing expires and the timer gets armed for the next expiry.
+			std::chrono::steady_clock::time_point nextExpiry = m_deviceMonitor.getNextExpiry();
+			if (nextExpiry<m_expiryTimerDeadline) {
+				m_expiryTimerDeadline = nextExpiry;
+				m_timer.set(nextExpiry, std::bind(&AnnouncementCollector::expiryTimerCb, this, std::placeholders::_1));
+			}
+		}
+
+		void AnnouncementCollector::setAnnounceCb(announceCb_t cb)
+		{
+			notifications_t notifications;
+			{
+				std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+				m_announceCb = cb;
+				if (m_pDispatcher) {
+					m_pDispatcher->setAnnounceCb(cb);
+				}
+				// all known announcements are collected for the new callback
+				if (m_announceCb) {
+					m_deviceMonitor.setAnnounceCb(std::bind(&AnnouncementCollector::collectAnnouncement, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+				} else {
+					m_deviceMonitor.setAnnounceCb(announceCb_t());
+				}
+				// those were not updated
+				for (events_t::iterator iter = m_pendingEvents.begin(); iter != m_pendingEvents.end(); ++iter) {
+					iter->updated = std::chrono::steady_clock::time_point();
+				}
+				takeNotifications(notifications);
+			}
+			deliverNotifications(notifications);
+		}
+
+		void AnnouncementCollector::setExpireCb(expireCb_t cb)
+		{
+			std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+			m_expireCb = cb;
+			if (m_pDispatcher) {
+				m_pDispatcher->setExpireCb(cb);
+			}
+			if (m_expireCb) {
+				m_deviceMonitor.setExpireCb(std::bind(&AnnouncementCollector::collectExpiry, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+			} else {
+				m_deviceMonitor.setExpireCb(expireCb_t());
+			}
+		}
+
+		void AnnouncementCollector::setErrorCb(errorCb_t cb)
+		{
+			std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+			m_errorCb = cb;
+			if (m_pDispatcher) {
+				m_pDispatcher->setErrorCb(cb);
+			}
+			if (m_errorCb) {
+				m_deviceMonitor.setErrorCb(std::bind(&AnnouncementCollector::collectError, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+			} else {
+				m_deviceMonitor.setErrorCb(errorCb_t());
+			}
+		}
+
+		void AnnouncementCollector::startDispatching(size_t capacity, CallbackDispatcher::overflowPolicy_t overflowPolicy)
+		{
+			// events of a previous dispatcher are to be executed first
+			stopDispatching();
+			std::shared_ptr < CallbackDispatcher > pDispatcher(new CallbackDispatcher(capacity, overflowPolicy));
+			{
+				std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+				pDispatcher->setAnnounceCb(m_announceCb);
+				pDispatcher->setExpireCb(m_expireCb);
+				pDispatcher->setErrorCb(m_errorCb);
+				pDispatcher->setMetrics(m_pMetrics);
+				// the dispatcher of a concurrent start is destructed after unlocking
+				m_pDispatcher.swap(pDispatcher);
+			}
+		}
+
+		void AnnouncementCollector::stopDispatching()
+		{
+			std::shared_ptr < CallbackDispatcher > pDispatcher;
+			{
+				std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+				m_pDispatcher.swap(pDispatcher);
+			}
+			// pending callbacks are executed without holding the lock. They might call us.
+			pDispatcher.reset();
+		}
+
+		void AnnouncementCollector::setMetrics(ReceiverMetrics* pMetrics)
+		{
+			std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+			m_pMetrics = pMetrics;
+			// the callbacks of m_deviceMonitor only collect notifications. Those are timed when being executed.
+			m_deviceMonitor.setMetrics(pMetrics, false);
+			if (m_pDispatcher) {
+				m_pDispatcher->setMetrics(pMetrics);
+			}
+		}
+
+		DeviceMonitor::memoryUsage_t AnnouncementCollector::getMemoryUsage() const
+		{
+			std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+			return m_deviceMonitor.getMemoryUsage();
+		}
+
+		void AnnouncementCollector::setReceiveBufferSize(int size, int maxSize)
+		{
+			m_scanner.setReceiveBufferSize(size, maxSize);
+		}
+
+		int AnnouncementCollector::start(bool receiveAllMemberships)
+		{
+			m_scanner.setReceiveAllMemberships(receiveAllMemberships);
+			int result = m_scanner.start(ANNOUNCE_IPV4_ADDRESS, ANNOUNCE_UDP_PORT, std::bind(&AnnouncementCollector::receiveEventHandler, this, std::placeholders::_1));
+
+			std::lock_guard < std::mutex > lock(m_deviceMonitorMtx);
+			m_expiryTimerDeadline = std::chrono::steady_clock::time_point::max();
+			armExpiryTimer();
+			return result;
+		}
+
+		void AnnouncementCollector::stop()
+		{
+			m_scanner.stop();
+			m_timer.cancel();
+		}
+
+		int AnnouncementCollector::addInterface(const std::string& interfaceAddress)
+		{
+			return m_scanner.addInterface(interfaceAddress);
+		}
+
+		int AnnouncementCollector::dropInterface(const std::string& interfaceAddress)
+		{
+			return m_scanner.dropInterface(interfaceAddress);
+		}
+
+		void AnnouncementCollector::addAllInterfaces()
+		{
+			m_scanner.addAllInterfaces();
+		}
+
+		void AnnouncementCollector::dropAllInterfaces()
+		{
+			m_scanner.dropAllInterfaces();
+		}
+
+		void AnnouncementCollector::updateInterfaces(const communication::MulticastServer::interfaceAddresses_t& interfaceAddresses)
+		{
+			m_scanner.updateInterfaces(interfaceAddresses);
+		}
+
+		void AnnouncementCollector::updateAllInterfaces()
+		{
+			m_scanner.updateAllInterfaces();
+		}
+	}
+}
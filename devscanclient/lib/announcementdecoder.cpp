@@ -0,0 +1,438 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <cctype>
+#include <cstring>
+#include <climits>
+
+#include "hbm/jsonrpc/jsonrpc_defines.h"
+
+#include "announcementdecoder.h"
+#include "defines.h"
+
+
+namespace hbm {
+	namespace devscan {
+		bool AnnouncementDecoder::field_t::equals(const char* pString) const
+		{
+			size_t stringLength = strlen(pString);
+			if (stringLength!=length) {
+				return false;
+			}
+			return memcmp(pData, pString, length)==0;
+		}
+
+		AnnouncementDecoder::AnnouncementDecoder()
+			: m_pPosition(NULL)
+			, m_pEnd(NULL)
+			, m_method()
+			, m_sendingInterfaceName()
+			, m_uuid()
+			, m_router()
+			, m_expiration(0)
+		{
+		}
+
+		bool AnnouncementDecoder::decode(const char* pData, size_t length)
+		{
+			static const field_t emptyField = { "", 0 };
+
+			m_pPosition = pData;
+			m_pEnd = pData+length;
+			m_method = emptyField;
+			m_sendingInterfaceName = emptyField;
+			m_uuid = emptyField;
+			m_router = emptyField;
+			m_expiration = 0;
+
+			skipWhitespace();
+			if ((m_pPosition==m_pEnd) || (*m_pPosition!='{')) {
+				return false;
+			}
+			if (parseObject(CONTEXT_ROOT, 0)==false) {
+				return false;
+			}
+
+			// there must not be anything behind the document
+			skipWhitespace();
+			return m_pPosition==m_pEnd;
+		}
+
+		int AnnouncementDecoder::lookupKey(context_t context, const field_t& key, context_t& childContext, target_t& target)
+		{
+			struct keyInfo_t {
+				context_t context;
+				const char* pKey;
+				context_t childContext;
+				target_t target;
+			};
+
+			static const keyInfo_t keyInfos[] = {
+				{ CONTEXT_ROOT, hbm::jsonrpc::METHOD, CONTEXT_OTHER, TARGET_METHOD },
+				{ CONTEXT_ROOT, hbm::jsonrpc::PARAMS, CONTEXT_PARAMS, TARGET_NONE },
+				{ CONTEXT_PARAMS, TAG_NetSettings, CONTEXT_NETSETTINGS, TARGET_NONE },
+				{ CONTEXT_PARAMS, TAG_Device, CONTEXT_DEVICE, TARGET_NONE },
+				{ CONTEXT_PARAMS, TAG_Router, CONTEXT_ROUTER, TARGET_NONE },
+				{ CONTEXT_PARAMS, TAG_Expiration, CONTEXT_OTHER, TARGET_EXPIRATION },
+				{ CONTEXT_NETSETTINGS, TAG_Interface, CONTEXT_INTERFACE, TARGET_NONE },
+				{ CONTEXT_INTERFACE, TAG_Name, CONTEXT_OTHER, TARGET_SENDINGINTERFACENAME },
+				{ CONTEXT_DEVICE, TAG_Uuid, CONTEXT_OTHER, TARGET_UUID },
+				{ CONTEXT_ROUTER, TAG_Uuid, CONTEXT_OTHER, TARGET_ROUTER }
+			};
+
+			for (unsigned int index = 0; index<sizeof(keyInfos)/sizeof(keyInfos[0]); ++index) {
+				const keyInfo_t& keyInfo = keyInfos[index];
+				if ((keyInfo.context==context) && (key.equals(keyInfo.pKey))) {
+					childContext = keyInfo.childContext;
+					target = keyInfo.target;
+					return static_cast < int > (index);
+				}
+			}
+
+			childContext = CONTEXT_OTHER;
+			target = TARGET_NONE;
+			return -1;
+		}
+
+		void AnnouncementDecoder::skipWhitespace()
+		{
+			while (m_pPosition<m_pEnd) {
+				switch (*m_pPosition) {
+				case ' ':
+				case '\t':
+				case '\n':
+				case '\r':
+					++m_pPosition;
+					break;
+				default:
+					return;
+				}
+			}
+		}
+
+		bool AnnouncementDecoder::parseObject(context_t context, unsigned int depth)
+		{
+			if (depth>MAX_DEPTH) {
+				return false;
+			}
+
+			// skip '{'
+			++m_pPosition;
+			skipWhitespace();
+			if ((m_pPosition<m_pEnd) && (*m_pPosition=='}')) {
+				++m_pPosition;
+				return true;
+			}
+
+			// relevant keys must appear only once. Otherwise the last one would win with the complete JSON parser.
+			unsigned int keysSeen = 0;
+
+			while (true) {
+				skipWhitespace();
+				if ((m_pPosition==m_pEnd) || (*m_pPosition!='"')) {
+					return false;
+				}
+
+				field_t key;
+				bool hasEscapes = false;
+				if (parseString(key, hasEscapes)==false) {
+					return false;
+				}
+
+				context_t childContext = CONTEXT_OTHER;
+				target_t target = TARGET_NONE;
+				if (context!=CONTEXT_OTHER) {
+					if (hasEscapes) {
+						// this might be a relevant key written with escape sequences
+						return false;
+					}
+					int keyIndex = lookupKey(context, key, childContext, target);
+					if (keyIndex>=0) {
+						unsigned int keyBit = 1u << keyIndex;
+						if (keysSeen & keyBit) {
+							return false;
+						}
+						keysSeen |= keyBit;
+					}
+				}
+
+				skipWhitespace();
+				if ((m_pPosition==m_pEnd) || (*m_pPosition!=':')) {
+					return false;
+				}
+				++m_pPosition;
+				skipWhitespace();
+				if (m_pPosition==m_pEnd) {
+					return false;
+				}
+
+				bool result;
+				if (target!=TARGET_NONE) {
+					result = parseTarget(target);
+				} else if (childContext!=CONTEXT_OTHER) {
+					// containers of relevant fields might be null, which is the same as not being there.
+					if (*m_pPosition=='{') {
+						result = parseObject(childContext, depth+1);
+					} else {
+						result = parseLiteral("null");
+					}
+				} else {
+					result = parseValue(depth+1);
+				}
+				if (result==false) {
+					return false;
+				}
+
+				skipWhitespace();
+				if (m_pPosition==m_pEnd) {
+					return false;
+				}
+				if (*m_pPosition==',') {
+					++m_pPosition;
+				} else if (*m_pPosition=='}') {
+					++m_pPosition;
+					return true;
+				} else {
+					return false;
+				}
+			}
+		}
+
+		bool AnnouncementDecoder::parseArray(unsigned int depth)
+		{
+			if (depth>MAX_DEPTH) {
+				return false;
+			}
+
+			// skip '['
+			++m_pPosition;
+			skipWhitespace();
+			if ((m_pPosition<m_pEnd) && (*m_pPosition==']')) {
+				++m_pPosition;
+				return true;
+			}
+
+			while (true) {
+				skipWhitespace();
+				if (m_pPosition==m_pEnd) {
+					return false;
+				}
+				if (parseValue(depth+1)==false) {
+					return false;
+				}
+				skipWhitespace();
+				if (m_pPosition==m_pEnd) {
+					return false;
+				}
+				if (*m_pPosition==',') {
+					++m_pPosition;
+				} else if (*m_pPosition==']') {
+					++m_pPosition;
+					return true;
+				} else {
+					return false;
+				}
+			}
+		}
+
+		bool AnnouncementDecoder::parseValue(unsigned int depth)
+		{
+			field_t string;
+			bool hasEscapes;
+
+			switch (*m_pPosition) {
+			case '{':
+				return parseObject(CONTEXT_OTHER, depth);
+			case '[':
+				return parseArray(depth);
+			case '"':
+				return parseString(string, hasEscapes);
+			case 't':
+				return parseLiteral("true");
+			case 'f':
+				return parseLiteral("false");
+			case 'n':
+				return parseLiteral("null");
+			default:
+				return parseNumber();
+			}
+		}
+
+		bool AnnouncementDecoder::parseString(field_t& string, bool& hasEscapes)
+		{
+			// skip '"'
+			++m_pPosition;
+			const char* pStart = m_pPosition;
+			hasEscapes = false;
+
+			while (m_pPosition<m_pEnd) {
+				char character = *m_pPosition;
+				if (character=='"') {
+					string.pData = pStart;
+					string.length = static_cast < size_t > (m_pPosition-pStart);
+					++m_pPosition;
+					return true;
+				} else if (character=='\\') {
+					hasEscapes = true;
+					++m_pPosition;
+					if (m_pPosition==m_pEnd) {
+						return false;
+					}
+					switch (*m_pPosition) {
+					case '"':
+					case '\\':
+					case '/':
+					case 'b':
+					case 'f':
+					case 'n':
+					case 'r':
+					case 't':
+						++m_pPosition;
+						break;
+					case 'u':
+						++m_pPosition;
+						for (unsigned int i = 0; i<4; ++i) {
+							if ((m_pPosition==m_pEnd) || (isxdigit(static_cast < unsigned char > (*m_pPosition))==0)) {
+								return false;
+							}
+							++m_pPosition;
+						}
+						break;
+					default:
+						return false;
+					}
+				} else if (static_cast < unsigned char > (character)<0x20) {
+					// control characters are to be escaped
+					return false;
+				} else {
+					++m_pPosition;
+				}
+			}
+			return false;
+		}
+
+		bool AnnouncementDecoder::parseNumber()
+		{
+			if ((m_pPosition<m_pEnd) && (*m_pPosition=='-')) {
+				++m_pPosition;
+			}
+
+			// integral part
+			if (m_pPosition==m_pEnd) {
+				return false;
+			}
+			if (*m_pPosition=='0') {
+				++m_pPosition;
+			} else if ((*m_pPosition>='1') && (*m_pPosition<='9')) {
+				while ((m_pPosition<m_pEnd) && (*m_pPosition>='0') && (*m_pPosition<='9')) {
+					++m_pPosition;
+				}
+			} else {
+				return false;
+			}
+
+			// fraction
+			if ((m_pPosition<m_pEnd) && (*m_pPosition=='.')) {
+				++m_pPosition;
+				const char* pDigits = m_pPosition;
+				while ((m_pPosition<m_pEnd) && (*m_pPosition>='0') && (*m_pPosition<='9')) {
+					++m_pPosition;
+				}
+				if (m_pPosition==pDigits) {
+					return false;
+				}
+			}
+
+			// exponent
+			if ((m_pPosition<m_pEnd) && ((*m_pPosition=='e') || (*m_pPosition=='E'))) {
+				++m_pPosition;
+				if ((m_pPosition<m_pEnd) && ((*m_pPosition=='+') || (*m_pPosition=='-'))) {
+					++m_pPosition;
+				}
+				const char* pDigits = m_pPosition;
+				while ((m_pPosition<m_pEnd) && (*m_pPosition>='0') && (*m_pPosition<='9')) {
+					++m_pPosition;
+				}
+				if (m_pPosition==pDigits) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool AnnouncementDecoder::parseLiteral(const char* pLiteral)
+		{
+			size_t length = strlen(pLiteral);
+			if (static_cast < size_t > (m_pEnd-m_pPosition)<length) {
+				return false;
+			}
+			if (memcmp(m_pPosition, pLiteral, length)!=0) {
+				return false;
+			}
+			m_pPosition += length;
+			return true;
+		}
+
+		bool AnnouncementDecoder::parseTarget(target_t target)
+		{
+			if (*m_pPosition=='n') {
+				// null is the same as not being there
+				return parseLiteral("null");
+			}
+
+			if (target==TARGET_EXPIRATION) {
+				// only plain unsigned integers. Anything else is left to the complete JSON parser.
+				if ((*m_pPosition<'0') || (*m_pPosition>'9')) {
+					return false;
+				}
+				if ((*m_pPosition=='0') && (m_pPosition+1<m_pEnd) && (m_pPosition[1]>='0') && (m_pPosition[1]<='9')) {
+					return false;
+				}
+				unsigned long long value = 0;
+				while ((m_pPosition<m_pEnd) && (*m_pPosition>='0') && (*m_pPosition<='9')) {
+					value = value*10 + static_cast < unsigned int > (*m_pPosition-'0');
+					if (value>UINT_MAX) {
+						return false;
+					}
+					++m_pPosition;
+				}
+				if ((m_pPosition<m_pEnd) && ((*m_pPosition=='.') || (*m_pPosition=='e') || (*m_pPosition=='E'))) {
+					return false;
+				}
+				m_expiration = static_cast < unsigned int > (value);
+				return true;
+			}
+
+			if (*m_pPosition!='"') {
+				return false;
+			}
+			field_t string;
+			bool hasEscapes;
+			if (parseString(string, hasEscapes)==false) {
+				return false;
+			}
+			if (hasEscapes) {
+				return false;
+			}
+
+			switch (target) {
+			case TARGET_METHOD:
+				m_method = string;
+				break;
+			case TARGET_SENDINGINTERFACENAME:
+				m_sendingInterfaceName = string;
+				break;
+			case TARGET_UUID:
+				m_uuid = string;
+				break;
+			case TARGET_ROUTER:
+				m_router = string;
+				break;
+			default:
+				break;
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,185 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "announcementtable.h"
+
+
+namespace hbm {
+	namespace devscan {
+		/// number of slots of an empty table
+		static const size_t MIN_SLOT_COUNT = 16;
+
+		const AnnouncementTable::entry_t AnnouncementTable::NO_ENTRY;
+
+		communicationPath::communicationPath()
+			: receivingInterface(string::Interner::NO_ID)
+			, sendingInterface(string::Interner::NO_ID)
+			, uuid(string::Interner::NO_ID)
+			, router(string::Interner::NO_ID)
+			, hash(0)
+		{
+		}
+
+		communicationPath::communicationPath(string::Interner::id_t receivingInterface, string::Interner::id_t sendingInterface, string::Interner::id_t uuid, string::Interner::id_t router)
+			: receivingInterface(receivingInterface)
+			, sendingInterface(sendingInterface)
+			, uuid(uuid)
+			, router(router)
+			, hash(0)
+		{
+			uint64_t value = fnv1a(reinterpret_cast < const char* > (&receivingInterface), sizeof(receivingInterface));
+			value = fnv1a(reinterpret_cast < const char* > (&sendingInterface), sizeof(sendingInterface), value);
+			value = fnv1a(reinterpret_cast < const char* > (&uuid), sizeof(uuid), value);
+			value = fnv1a(reinterpret_cast < const char* > (&router), sizeof(router), value);
+			hash = value;
+		}
+
+		bool communicationPath::operator==(const communicationPath& op) const
+		{
+			return (hash==op.hash)
+				&& (receivingInterface==op.receivingInterface)
+				&& (sendingInterface==op.sendingInterface)
+				&& (uuid==op.uuid)
+				&& (router==op.router);
+		}
+
+		AnnouncementTable::AnnouncementTable()
+			: m_size(0)
+			, m_slotHashes()
+			, m_slotEntries()
+			, m_slotMask(0)
+			, m_shift(0)
+			, m_paths()
+			, m_timesOfExpiry()
+			, m_expirations()
+			, m_payloads()
+			, m_fingerprints()
+			, m_heapPositions()
+			, m_freeEntries()
+		{
+			rehash(MIN_SLOT_COUNT);
+		}
+
+		AnnouncementTable::entry_t AnnouncementTable::find(const communicationPath& path) const
+		{
+			size_t slot = getHomeSlot(path.hash);
+			while (m_slotEntries[slot]!=NO_ENTRY) {
+				if ((m_slotHashes[slot]==path.hash) && (m_paths[m_slotEntries[slot]]==path)) {
+					return m_slotEntries[slot];
+				}
+				slot = (slot+1) & m_slotMask;
+			}
+			return NO_ENTRY;
+		}
+
+		AnnouncementTable::entry_t AnnouncementTable::insert(const communicationPath& path)
+		{
+			// at most 3/4 of the slots are used. Longer probe sequences get expensive with linear probing.
+			if ((m_size+1)*4>m_slotEntries.size()*3) {
+				rehash(m_slotEntries.size()*2);
+			}
+
+			entry_t entry;
+			if (m_freeEntries.empty()) {
+				entry = static_cast < entry_t > (m_paths.size());
+				m_paths.push_back(path);
+				m_timesOfExpiry.push_back(std::chrono::steady_clock::time_point());
+				m_expirations.push_back(std::chrono::seconds(0));
+				m_payloads.push_back(PayloadArena::NO_HANDLE);
+				m_fingerprints.push_back(0);
+				m_heapPositions.push_back(0);
+			} else {
+				entry = m_freeEntries.back();
+				m_freeEntries.pop_back();
+				m_paths[entry] = path;
+			}
+
+			insertSlot(path.hash, entry);
+			++m_size;
+			return entry;
+		}
+
+		void AnnouncementTable::insertSlot(uint64_t hash, entry_t entry)
+		{
+			size_t slot = getHomeSlot(hash);
+			while (m_slotEntries[slot]!=NO_ENTRY) {
+				slot = (slot+1) & m_slotMask;
+			}
+			m_slotHashes[slot] = hash;
+			m_slotEntries[slot] = entry;
+		}
+
+		void AnnouncementTable::erase(entry_t entry)
+		{
+			size_t slot = getHomeSlot(m_paths[entry].hash);
+			while (m_slotEntries[slot]!=entry) {
+				slot = (slot+1) & m_slotMask;
+			}
+
+			// backward shift: move following slots of the same probe sequence into the gap
+			size_t next = slot;
+			while (true) {
+				next = (next+1) & m_slotMask;
+				if (m_slotEntries[next]==NO_ENTRY) {
+					break;
+				}
+				size_t home = getHomeSlot(m_slotHashes[next]);
+				// the slot may move if its home slot is not within (slot, next] cyclically
+				bool movable;
+				if (slot<=next) {
+					movable = (home<=slot) || (home>next);
+				} else {
+					movable = (home<=slot) && (home>next);
+				}
+				if (movable) {
+					m_slotHashes[slot] = m_slotHashes[next];
+					m_slotEntries[slot] = m_slotEntries[next];
+					slot = next;
+				}
+			}
+			m_slotEntries[slot] = NO_ENTRY;
+
+			// marks the entry as unused. Releasing the strings of the path is up to the caller.
+			m_paths[entry] = communicationPath();
+			m_payloads[entry] = PayloadArena::NO_HANDLE;
+			m_freeEntries.push_back(entry);
+			--m_size;
+		}
+
+		void AnnouncementTable::rehash(size_t slotCount)
+		{
+			m_slotHashes.assign(slotCount, 0);
+			m_slotEntries.assign(slotCount, NO_ENTRY);
+			m_slotMask = slotCount-1;
+			m_shift = 64;
+			while (slotCount>1) {
+				slotCount >>= 1;
+				--m_shift;
+			}
+
+			for (entry_t entry = 0; entry < getEntryLimit(); ++entry) {
+				if (isUsed(entry)) {
+					insertSlot(m_paths[entry].hash, entry);
+				}
+			}
+		}
+
+		size_t AnnouncementTable::getResidentBytes() const
+		{
+			return m_slotHashes.capacity()*sizeof(uint64_t)
+				+ m_slotEntries.capacity()*sizeof(entry_t)
+				+ m_paths.capacity()*sizeof(communicationPath)
+				+ m_timesOfExpiry.capacity()*sizeof(std::chrono::steady_clock::time_point)
+				+ m_expirations.capacity()*sizeof(std::chrono::seconds)
+				+ m_payloads.capacity()*sizeof(PayloadArena::handle_t)
+				+ m_fingerprints.capacity()*sizeof(uint64_t)
+				+ m_heapPositions.capacity()*sizeof(uint32_t)
+				+ m_freeEntries.capacity()*sizeof(entry_t);
+		}
+	}
+}
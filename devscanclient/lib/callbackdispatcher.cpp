@@ -0,0 +1,297 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "callbackdispatcher.h"
+
+
+namespace hbm {
+	namespace devscan {
+		CallbackDispatcher::CallbackDispatcher(size_t capacity, overflowPolicy_t overflowPolicy)
+			: m_cells()
+			, m_mask(0)
+			, m_overflowPolicy(overflowPolicy)
+			, m_enqueuePosition(0)
+			, m_dequeuePosition(0)
+			, m_droppedCount(0)
+			, m_reportedDroppedCount(0)
+			, m_workerWaiting(false)
+			, m_wakeUpMtx()
+			, m_wakeUpCondition()
+			, m_stopRequested(false)
+			, m_callbackMtx()
+			, m_announceCb()
+			, m_expireCb()
+			, m_errorCb()
+			, m_pMetrics(NULL)
+			, m_worker()
+		{
+			size_t cellCount = 2;
+			while (cellCount<capacity) {
+				cellCount <<= 1;
+			}
+			m_mask = cellCount-1;
+
+			m_cells.reset(new cell_t[cellCount]);
+			for (size_t i = 0; i < cellCount; ++i) {
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+			m_worker = std::thread(&CallbackDispatcher::run, this);
+		}
+
+		CallbackDispatcher::~CallbackDispatcher()
+		{
+			{
+				std::lock_guard < std::mutex > lock(m_wakeUpMtx);
+				m_stopRequested = true;
+				m_wakeUpCondition.notify_one();
+			}
+			m_worker.join();
+		}
+
+		void CallbackDispatcher::setAnnounceCb(announceCb_t cb)
+		{
+			std::lock_guard < std::mutex > lock(m_callbackMtx);
+			m_announceCb = cb;
+		}
+
+		void CallbackDispatcher::setExpireCb(expireCb_t cb)
+		{
+			std::lock_guard < std::mutex > lock(m_callbackMtx);
+			m_expireCb = cb;
+		}
+
+		void CallbackDispatcher::setErrorCb(errorCb_t cb)
+		{
+			std::lock_guard < std::mutex > lock(m_callbackMtx);
+			m_errorCb = cb;
+		}
+
+		void CallbackDispatcher::setMetrics(ReceiverMetrics* pMetrics)
+		{
+			std::lock_guard < std::mutex > lock(m_callbackMtx);
+			m_pMetrics = pMetrics;
+		}
+
+		bool CallbackDispatcher::tryPush(event_t& event)
+		{
+			cell_t* pCell;
+			size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+			while (true) {
+				pCell = &m_cells[position & m_mask];
+				size_t sequence = pCell->sequence.load(std::memory_order_acquire);
+				ptrdiff_t difference = static_cast < ptrdiff_t > (sequence) - static_cast < ptrdiff_t > (position);
+				if (difference==0) {
+					// the cell is free. Claim it.
+					if (m_enqueuePosition.compare_exchange_weak(position, position+1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (difference<0) {
+					// the cell still holds an event that was not delivered yet
+					return false;
+				} else {
+					// another producer was faster
+					position = m_enqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+
+			pCell->event = std::move(event);
+			pCell->sequence.store(position+1, std::memory_order_release);
+			return true;
+		}
+
+		bool CallbackDispatcher::tryPop(event_t& event)
+		{
+			cell_t& cell = m_cells[m_dequeuePosition & m_mask];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			if (sequence!=m_dequeuePosition+1) {
+				return false;
+			}
+
+			event = std::move(cell.event);
+			// the cell is free for the producers of the next round
+			cell.sequence.store(m_dequeuePosition+m_mask+1, std::memory_order_release);
+			++m_dequeuePosition;
+			return true;
+		}
+
+		bool CallbackDispatcher::isEmpty() const
+		{
+			const cell_t& cell = m_cells[m_dequeuePosition & m_mask];
+			return cell.sequence.load(std::memory_order_acquire)!=m_dequeuePosition+1;
+		}
+
+		void CallbackDispatcher::wakeUp()
+		{
+			// pairs with the fence of the worker thread before it checks for events
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (m_workerWaiting.load(std::memory_order_relaxed)) {
+				std::lock_guard < std::mutex > lock(m_wakeUpMtx);
+				m_wakeUpCondition.notify_one();
+			}
+		}
+
+		void CallbackDispatcher::push(event_t& event)
+		{
+			while (tryPush(event)==false) {
+				if (m_overflowPolicy==OVERFLOW_DROP) {
+					m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+					break;
+				}
+				wakeUp();
+				std::this_thread::yield();
+			}
+			wakeUp();
+		}
+
+		void CallbackDispatcher::pushAnnouncement(const std::string& uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router, const std::string& announcement)
+		{
+			event_t event;
+			event.type = EVENT_ANNOUNCE;
+			event.uuid = uuid;
+			event.receivingInterfaceName = receivingInterfaceName;
+			event.sendingInterfaceName = sendingInterfaceName;
+			event.router = router;
+			event.data = announcement;
+			event.errorCode = 0;
+			push(event);
+		}
+
+		void CallbackDispatcher::pushExpiry(const std::string& uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router)
+		{
+			event_t event;
+			event.type = EVENT_EXPIRE;
+			event.uuid = uuid;
+			event.receivingInterfaceName = receivingInterfaceName;
+			event.sendingInterfaceName = sendingInterfaceName;
+			event.router = router;
+			event.errorCode = 0;
+			push(event);
+		}
+
+		void CallbackDispatcher::pushError(uint32_t errorCode, const std::string& userMessage, const std::string& receivedData)
+		{
+			event_t event;
+			event.type = EVENT_ERROR;
+			event.data = receivedData;
+			event.userMessage = userMessage;
+			event.errorCode = errorCode;
+			push(event);
+		}
+
+		void CallbackDispatcher::execute(const event_t& event, const announceCb_t& announceCb, const expireCb_t& expireCb, const errorCb_t& errorCb, ReceiverMetrics* pMetrics)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			bool timed = false;
+			try {
+				switch (event.type) {
+				case EVENT_ANNOUNCE:
+					if (announceCb) {
+						timed = true;
+						announceCb(event.uuid, event.receivingInterfaceName, event.sendingInterfaceName, event.router, event.data);
+					}
+					break;
+				case EVENT_EXPIRE:
+					if (expireCb) {
+						timed = true;
+						expireCb(event.uuid, event.receivingInterfaceName, event.sendingInterfaceName, event.router);
+					}
+					break;
+				case EVENT_ERROR:
+					if (errorCb) {
+						errorCb(event.errorCode, event.userMessage, event.data);
+					}
+					break;
+				}
+			} catch(...) {
+				// there is nothing left we can do here!
+			}
+
+			if ((pMetrics) && (timed)) {
+				std::chrono::steady_clock::time_point returned = std::chrono::steady_clock::now();
+				pMetrics->addCallback(returned-start);
+				if (event.updated!=std::chrono::steady_clock::time_point()) {
+					pMetrics->addLatency(ReceiverMetrics::UPDATE_TO_CALLBACK_RETURN, std::chrono::duration_cast < std::chrono::nanoseconds > (returned-event.updated));
+				}
+			}
+		}
+
+		void CallbackDispatcher::deliver(const event_t& event)
+		{
+			// the callback is executed without holding the lock. Hence it might set callbacks.
+			announceCb_t announceCb;
+			expireCb_t expireCb;
+			errorCb_t errorCb;
+			ReceiverMetrics* pMetrics;
+			{
+				std::lock_guard < std::mutex > lock(m_callbackMtx);
+				pMetrics = m_pMetrics;
+				switch (event.type) {
+				case EVENT_ANNOUNCE:
+					announceCb = m_announceCb;
+					break;
+				case EVENT_EXPIRE:
+					expireCb = m_expireCb;
+					break;
+				case EVENT_ERROR:
+					errorCb = m_errorCb;
+					break;
+				}
+			}
+			execute(event, announceCb, expireCb, errorCb, pMetrics);
+		}
+
+		void CallbackDispatcher::reportDroppedEvents()
+		{
+			uint64_t droppedCount = m_droppedCount.load(std::memory_order_relaxed);
+			if (droppedCount==m_reportedDroppedCount) {
+				return;
+			}
+
+			std::ostringstream userMessage;
+			userMessage << droppedCount-m_reportedDroppedCount << " callback events dropped because the dispatch queue was full";
+			m_reportedDroppedCount = droppedCount;
+
+			event_t event;
+			event.type = EVENT_ERROR;
+			event.userMessage = userMessage.str();
+			event.errorCode = cb_t::DATA_DROPPED | cb_t::ERROR_OVERFLOW;
+			deliver(event);
+		}
+
+		void CallbackDispatcher::run()
+		{
+			event_t event;
+			while (true) {
+				if (tryPop(event)) {
+					deliver(event);
+					continue;
+				}
+
+				reportDroppedEvents();
+
+				std::unique_lock < std::mutex > lock(m_wakeUpMtx);
+				m_workerWaiting.store(true, std::memory_order_relaxed);
+				// pairs with the fence of the producers after pushing
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				while (isEmpty() && (m_droppedCount.load(std::memory_order_relaxed)==m_reportedDroppedCount)) {
+					if (m_stopRequested) {
+						// everything got delivered
+						m_workerWaiting.store(false, std::memory_order_relaxed);
+						return;
+					}
+					m_wakeUpCondition.wait(lock);
+				}
+				m_workerWaiting.store(false, std::memory_order_relaxed);
+			}
+		}
+	}
+}
@@ -6,6 +6,13 @@
 #include <sstream>
 #include <cstdlib>
 #include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <json/value.h>
 #include <json/reader.h>
@@ -13,8 +20,11 @@
 
 #include "hbm/communication/multicastserver.h"
 #include "hbm/communication/netadapter.h"
+#include "hbm/exception/exception.hpp"
 #include "hbm/jsonrpc/jsonrpc_defines.h"
 #include "hbm/sys/eventloop.h"
+#include "hbm/sys/notifier.h"
+#include "hbm/sys/timer.h"
 
 #include "configureclient.h"
 #include "defines.h"
@@ -24,32 +34,96 @@ namespace hbm {
 		const std::chrono::milliseconds ConfigureClient::TIMETOWAITFORANSWERS(3000);
 
 		ConfigureClient::ConfigureClient()
-			: m_MulticastServer(m_netadapterList, m_eventloop)
+			: m_eventloop()
+			, m_netadapterList()
+			, m_MulticastServer(m_netadapterList, m_eventloop)
+			, m_sendMtx()
+			, m_outstandingRequests()
+			, m_deadlines()
+			, m_outstandingRequestsMtx()
+			, m_requestAddedNotifier(m_eventloop)
+			, m_expirationTimer(m_eventloop)
+			, m_expirationTimerDeadline()
+			, m_expirationTimerArmed(false)
+			, m_receiver()
+			, m_requestCount(0)
 		{
 			m_MulticastServer.start(CONFIG_IPV4_ADDRESS, CONFIG_UDP_PORT, std::bind(&ConfigureClient::recvCb, this, std::placeholders::_1));
 			m_MulticastServer.addAllInterfaces();
 
 			srand (static_cast < unsigned int > (time(NULL)));
+
+			m_requestAddedNotifier.set(std::bind(&ConfigureClient::requestAddedCb, this));
+			m_receiver = std::thread(&sys::EventLoop::execute, &m_eventloop);
 		}
 
 		ConfigureClient::~ConfigureClient()
 		{
+			m_eventloop.stop();
+			m_receiver.join();
 			m_MulticastServer.stop();
+
+			// there is nobody left to receive the answers
+			outstandingRequests_t requests;
+			{
+				std::lock_guard < std::mutex > lock(m_outstandingRequestsMtx);
+				requests.swap(m_outstandingRequests);
+				m_deadlines.clear();
+			}
+			for (outstandingRequests_t::const_iterator iter = requests.begin(); iter != requests.end(); ++iter) {
+				completeRequest(iter->second, "");
+			}
 		}
 
-		std::string ConfigureClient::executeRequest(const std::string& interfaceIp, unsigned char ttl, const std::string& Message)
+		std::string ConfigureClient::executeRequest(const std::string& interfaceIp, unsigned char ttl, const std::string& id, const std::string& Message)
 		{
-			m_netadapterList.update();
+			return executeRequestAsync(interfaceIp, ttl, id, Message, TIMETOWAITFORANSWERS).get();
+		}
 
+		std::future < std::string > ConfigureClient::executeRequestAsync(const std::string& interfaceIp, unsigned char ttl, const std::string& id, const std::string& message, std::chrono::milliseconds timeToWait, responseCb_t responseCb)
+		{
+			promisePtr_t pPromise(new std::promise < std::string >());
+			std::future < std::string > response = pPromise->get_future();
+
+			{
+				// the request is known before the answer might arrive
+				std::lock_guard < std::mutex > lock(m_outstandingRequestsMtx);
+				if (m_outstandingRequests.find(id)!=m_outstandingRequests.end()) {
+					throw hbm::exception::exception("a request with id " + id + " is outstanding already");
+				}
+				outstandingRequest_t& request = m_outstandingRequests[id];
+				request.pPromise = pPromise;
+				request.responseCb = responseCb;
+				request.deadline = m_deadlines.insert(deadlines_t::value_type(std::chrono::steady_clock::now()+timeToWait, id));
+			}
+			m_requestAddedNotifier.notify();
 
-			if (interfaceIp.empty()) {
-				m_MulticastServer.send(Message, ttl);
-			} else {
-				m_MulticastServer.sendOverInterfaceByAddress(interfaceIp, Message, ttl);
+			// interfaces might have appeared since the last request
+			m_netadapterList.update();
+			{
+				std::lock_guard < std::mutex > lock(m_sendMtx);
+				if (interfaceIp.empty()) {
+					m_MulticastServer.send(message, ttl);
+				} else {
+					m_MulticastServer.sendOverInterfaceByAddress(interfaceIp, message, ttl);
+				}
 			}
+			return response;
+		}
+
+		size_t ConfigureClient::getOutstandingRequestCount() const
+		{
+			std::lock_guard < std::mutex > lock(m_outstandingRequestsMtx);
+			return m_outstandingRequests.size();
+		}
 
-			m_eventloop.execute_for(TIMETOWAITFORANSWERS);
-			return m_response;
+		void ConfigureClient::completeRequest(const outstandingRequest_t& request, const std::string& response)
+		{
+			// the callback is done when the future gets ready
+			if (request.responseCb) {
+				request.responseCb(response);
+			}
+			request.pPromise->set_value(response);
 		}
 
 		int ConfigureClient::recvCb(communication::MulticastServer* mcs)
@@ -67,18 +141,88 @@ namespace hbm {
 					if(telegramNode.isMember(hbm::jsonrpc::RESULT) || telegramNode.isMember(hbm::jsonrpc::ERR)) {
 						// this is a result or an error!
 
-						// is this a response to our question ( id does match)?
-						if (m_id == telegramNode[hbm::jsonrpc::ID].asString()) {
-							m_response = std::string(buf, result);
-							m_eventloop.stop();
+						// is this a response to one of our questions ( id does match)?
+						outstandingRequest_t request;
+						{
+							std::lock_guard < std::mutex > lock(m_outstandingRequestsMtx);
+							outstandingRequests_t::iterator iter = m_outstandingRequests.find(telegramNode[hbm::jsonrpc::ID].asString());
+							if (iter==m_outstandingRequests.end()) {
+								return result;
+							}
+							request = iter->second;
+							m_deadlines.erase(iter->second.deadline);
+							m_outstandingRequests.erase(iter);
 						}
+						completeRequest(request, std::string(buf, result));
 					}
 				}
 			}
 			return result;
 		}
 
-		std::string ConfigureClient::setInterfaceConfigurationMethod(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& Uuid, const std::string& InterfaceName, const std::string& method)
+		void ConfigureClient::requestAddedCb()
+		{
+			armExpirationTimer();
+		}
+
+		void ConfigureClient::expirationTimerCb(bool fired)
+		{
+			if (fired==false) {
+				return;
+			}
+			m_expirationTimerArmed = false;
+
+			std::vector < outstandingRequest_t > expiredRequests;
+			{
+				std::lock_guard < std::mutex > lock(m_outstandingRequestsMtx);
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				while ((m_deadlines.empty()==false) && (m_deadlines.begin()->first<=now)) {
+					outstandingRequests_t::iterator iter = m_outstandingRequests.find(m_deadlines.begin()->second);
+					expiredRequests.push_back(iter->second);
+					m_outstandingRequests.erase(iter);
+					m_deadlines.erase(m_deadlines.begin());
+				}
+			}
+
+			for (std::vector < outstandingRequest_t >::const_iterator iter = expiredRequests.begin(); iter != expiredRequests.end(); ++iter) {
+				completeRequest(*iter, "");
+			}
+			armExpirationTimer();
+		}
+
+		void ConfigureClient::armExpirationTimer()
+		{
+			std::chrono::steady_clock::time_point deadline;
+			{
+				std::lock_guard < std::mutex > lock(m_outstandingRequestsMtx);
+				if (m_deadlines.empty()) {
+					return;
+				}
+				deadline = m_deadlines.begin()->first;
+			}
+
+			if ((m_expirationTimerArmed) && (m_expirationTimerDeadline<=deadline)) {
+				// fires early enough. Requests answered in the meantime are not waited for.
+				return;
+			}
+			m_expirationTimerDeadline = deadline;
+			m_expirationTimerArmed = true;
+			m_expirationTimer.set(deadline, std::bind(&ConfigureClient::expirationTimerCb, this, std::placeholders::_1));
+		}
+
+		std::string ConfigureClient::setInterfaceConfigurationMethod(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& method)
+		{
+			std::string id = createId();
+			return executeRequest(outgoingInterfaceIp, ttl, id, createInterfaceConfigurationMethodRequest(ttl, uuid, interfaceName, method, id));
+		}
+
+		std::future < std::string > ConfigureClient::setInterfaceConfigurationMethodAsync(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& method, responseCb_t responseCb)
+		{
+			std::string id = createId();
+			return executeRequestAsync(outgoingInterfaceIp, ttl, id, createInterfaceConfigurationMethodRequest(ttl, uuid, interfaceName, method, id), TIMETOWAITFORANSWERS, responseCb);
+		}
+
+		std::string ConfigureClient::createInterfaceConfigurationMethodRequest(unsigned char ttl, const std::string& Uuid, const std::string& InterfaceName, const std::string& method, const std::string& id)
 		{
 		//  {
 		//    "jsonrpc": "2.0",
@@ -100,7 +244,6 @@ namespace hbm {
 			Json::Value tree;
 			Json::FastWriter writer;
 			writer.omitEndingLineFeed();
-			m_id = createId();
 
 			/// \throw std::runtime_error if tree.type != NULL
 			tree[hbm::jsonrpc::JSONRPC] = "2.0";
@@ -109,18 +252,29 @@ namespace hbm {
 			tree[hbm::jsonrpc::PARAMS][TAG_NetSettings][TAG_Interface][CONFIGURATION_METHOD] = method;
 			tree[hbm::jsonrpc::PARAMS][TAG_Device][TAG_Uuid] = Uuid;
 			tree[hbm::jsonrpc::PARAMS][TAG_Ttl] = static_cast < int >(ttl);
-			tree[hbm::jsonrpc::ID] = m_id;
+			tree[hbm::jsonrpc::ID] = id;
 
-			return executeRequest(outgoingInterfaceIp, ttl, writer.write(tree));
+			return writer.write(tree);
 		}
 
 
 		std::string ConfigureClient::setInterfaceConfiguration(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& method, const std::string& manualAddress, const std::string& manualNetmask)
+		{
+			std::string id = createId();
+			return executeRequest(outgoingInterfaceIp, ttl, id, createInterfaceConfigurationRequest(ttl, uuid, interfaceName, method, manualAddress, manualNetmask, id));
+		}
+
+		std::future < std::string > ConfigureClient::setInterfaceConfigurationAsync(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& method, const std::string& manualAddress, const std::string& manualNetmask, responseCb_t responseCb)
+		{
+			std::string id = createId();
+			return executeRequestAsync(outgoingInterfaceIp, ttl, id, createInterfaceConfigurationRequest(ttl, uuid, interfaceName, method, manualAddress, manualNetmask, id), TIMETOWAITFORANSWERS, responseCb);
+		}
+
+		std::string ConfigureClient::createInterfaceConfigurationRequest(unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& method, const std::string& manualAddress, const std::string& manualNetmask, const std::string& id)
 		{
 			Json::Value tree;
 			Json::FastWriter writer;
 			writer.omitEndingLineFeed();
-			m_id = createId();
 
 			/// \throw std::runtime_error if tree.type != NULL
 			tree[hbm::jsonrpc::JSONRPC] = "2.0";
@@ -131,12 +285,24 @@ namespace hbm {
 			tree[hbm::jsonrpc::PARAMS][TAG_NetSettings][TAG_Interface][TAG_ipV4][TAG_manualNetmask] = manualNetmask;
 			tree[hbm::jsonrpc::PARAMS][TAG_Device][TAG_Uuid] = uuid;
 			tree[hbm::jsonrpc::PARAMS][TAG_Ttl] = static_cast < int >(ttl);
-			tree[hbm::jsonrpc::ID] = m_id;
+			tree[hbm::jsonrpc::ID] = id;
 
-			return executeRequest(outgoingInterfaceIp, ttl, writer.write(tree));
+			return writer.write(tree);
 		}
 
 		std::string ConfigureClient::setDefaultGateway(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& ipv4DefaultGateWay)
+		{
+			std::string id = createId();
+			return executeRequest(outgoingInterfaceIp, ttl, id, createDefaultGatewayRequest(ttl, uuid, ipv4DefaultGateWay, id));
+		}
+
+		std::future < std::string > ConfigureClient::setDefaultGatewayAsync(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& ipv4DefaultGateWay, responseCb_t responseCb)
+		{
+			std::string id = createId();
+			return executeRequestAsync(outgoingInterfaceIp, ttl, id, createDefaultGatewayRequest(ttl, uuid, ipv4DefaultGateWay, id), TIMETOWAITFORANSWERS, responseCb);
+		}
+
+		std::string ConfigureClient::createDefaultGatewayRequest(unsigned char ttl, const std::string& uuid, const std::string& ipv4DefaultGateWay, const std::string& id)
 		{
 		//  {
 		//    "jsonrpc": "2.0",
@@ -159,7 +325,6 @@ namespace hbm {
 			Json::Value tree;
 			Json::FastWriter writer;
 			writer.omitEndingLineFeed();
-			m_id = createId();
 
 			/// \throw std::runtime_error if tree.type != NULL
 			tree[hbm::jsonrpc::JSONRPC] = "2.0";
@@ -167,12 +332,24 @@ namespace hbm {
 			tree[hbm::jsonrpc::PARAMS][TAG_NetSettings][TAG_DefaultGateway][TAG_ipV4Address] = ipv4DefaultGateWay;
 			tree[hbm::jsonrpc::PARAMS][TAG_Device][TAG_Uuid] = uuid;
 			tree[hbm::jsonrpc::PARAMS][TAG_Ttl] = static_cast < int >(ttl);
-			tree[hbm::jsonrpc::ID] = m_id;
+			tree[hbm::jsonrpc::ID] = id;
 
-			return executeRequest(outgoingInterfaceIp, ttl, writer.write(tree));
+			return writer.write(tree);
 		}
 
-		std::string ConfigureClient::setInterfaceManualConfiguration(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& Uuid, const std::string& InterfaceName, const std::string& address, const std::string& netmask)
+		std::string ConfigureClient::setInterfaceManualConfiguration(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& address, const std::string& netmask)
+		{
+			std::string id = createId();
+			return executeRequest(outgoingInterfaceIp, ttl, id, createInterfaceManualConfigurationRequest(ttl, uuid, interfaceName, address, netmask, id));
+		}
+
+		std::future < std::string > ConfigureClient::setInterfaceManualConfigurationAsync(const std::string& outgoingInterfaceIp, unsigned char ttl, const std::string& uuid, const std::string& interfaceName, const std::string& address, const std::string& netmask, responseCb_t responseCb)
+		{
+			std::string id = createId();
+			return executeRequestAsync(outgoingInterfaceIp, ttl, id, createInterfaceManualConfigurationRequest(ttl, uuid, interfaceName, address, netmask, id), TIMETOWAITFORANSWERS, responseCb);
+		}
+
+		std::string ConfigureClient::createInterfaceManualConfigurationRequest(unsigned char ttl, const std::string& Uuid, const std::string& InterfaceName, const std::string& address, const std::string& netmask, const std::string& id)
 		{
 
 		//  {
@@ -200,7 +377,6 @@ namespace hbm {
 			Json::Value tree;
 			Json::FastWriter writer;
 			writer.omitEndingLineFeed();
-			m_id = createId();
 
 			/// \throw std::runtime_error if tree.type != NULL
 			tree[hbm::jsonrpc::JSONRPC] = "2.0";
@@ -210,9 +386,9 @@ namespace hbm {
 			tree[hbm::jsonrpc::PARAMS][TAG_NetSettings][TAG_Interface][TAG_ipV4][TAG_manualNetmask] = netmask;
 			tree[hbm::jsonrpc::PARAMS][TAG_Device][TAG_Uuid] = Uuid;
 			tree[hbm::jsonrpc::PARAMS][TAG_Ttl] = static_cast < int >(ttl);
-			tree[hbm::jsonrpc::ID] = m_id;
+			tree[hbm::jsonrpc::ID] = id;
 
-			return executeRequest(outgoingInterfaceIp, ttl, writer.write(tree));
+			return writer.write(tree);
 		}
 
 		std::string ConfigureClient::createId() const
@@ -221,6 +397,8 @@ namespace hbm {
 			idStream << time(NULL);
 			idStream << ":";
 			idStream << rand() % 1000;
+			idStream << ":";
+			idStream << m_requestCount++;
 
 			return idStream.str();
 		}
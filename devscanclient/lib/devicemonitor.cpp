@@ -3,45 +3,60 @@
 // See file LICENSE provided
 
 #include <cstddef>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <exception>
 #include <vector>
 #include <chrono>
+#include <algorithm>
 
 #include <json/value.h>
 #include <json/reader.h>
 
-#include "hbm/string/split.h"
-
 #include "hbm/exception/exception.hpp"
 #include "hbm/jsonrpc/jsonrpc_defines.h"
 
+#include "announcementdecoder.h"
 #include "devicemonitor.h"
 #include "defines.h"
 
 
 namespace hbm {
 	namespace devscan {
-		DeviceMonitor::communicationPath::communicationPath(const std::string &communicationPath)
+		DeviceMonitor::memoryUsage_t::memoryUsage_t()
+			: deviceCount(0)
+			, payloadBytes(0)
+			, nodeBytes(0)
+			, indexBytes(0)
 		{
-			std::vector < std::string > tokens = hbm::string::split(communicationPath, ":");
+		}
 
-			if (tokens.size() != 4) {
-				throw std::runtime_error("invalid communication path");
-			}
+		size_t DeviceMonitor::memoryUsage_t::getResidentBytes() const
+		{
+			return payloadBytes + nodeBytes + indexBytes;
+		}
 
-			receivingInterface = tokens[0];
-			sendingInterface = tokens[1];
-			uuid = tokens[2];
-			router = tokens[3];
+		size_t DeviceMonitor::memoryUsage_t::getBytesPerDevice() const
+		{
+			if (deviceCount==0) {
+				return 0;
+			}
+			return getResidentBytes() / deviceCount;
 		}
 
 		DeviceMonitor::DeviceMonitor()
-			: m_announcements()
+			: m_nodePool()
+			, m_payloads()
+			, m_announcements()
+			, m_strings()
+			, m_fingerprints(0, std::hash < uint64_t > (), std::equal_to < uint64_t > (), fingerprintsAllocator_t(m_nodePool))
+			, m_expiryHeap()
 			, m_announceCb(announceCb_t())
 			, m_expireCb(expireCb_t())
 			, m_errorCb(errorCb_t())
+			, m_pMetrics(NULL)
+			, m_timeCallbacks(true)
 		{
 		}
 
@@ -49,10 +64,12 @@ namespace hbm {
 		{
 			m_announceCb = cb;
 			if (m_announceCb) {
-				for (announcements_t::iterator iter=m_announcements.begin(); iter!=m_announcements.end(); ++iter) {
+				for (AnnouncementTable::entry_t entry = 0; entry < m_announcements.getEntryLimit(); ++entry) {
+					if (m_announcements.isUsed(entry)==false) {
+						continue;
+					}
 					try {
-						communicationPath path(iter->first);
-						m_announceCb(path.uuid, path.receivingInterface, path.sendingInterface, path.router, iter->second.announcement);
+						notifyAnnouncement(m_announcements.getPath(entry), getAnnouncement(entry));
 					} catch(...)
 					{
 					}
@@ -84,17 +101,172 @@ namespace hbm {
 			}
 		}
 
-		void DeviceMonitor::processReceivedAnnouncement(std::string receivingInterfaceName, const std::string &message)
+		void DeviceMonitor::callErrorCb(uint32_t errorCode, const std::string& userMessage, const char* pAnnouncement, size_t announcementLength)
 		{
-			Json::Value announcement;
+			// errors concerning received data mean, that the telegram was dropped
+			if (m_pMetrics) {
+				m_pMetrics->increment(ReceiverMetrics::PARSE_FAILURES);
+			}
+			if(m_errorCb) {
+				callErrorCb(errorCode, userMessage, std::string(pAnnouncement, announcementLength));
+			}
+		}
+
+		void DeviceMonitor::notifyAnnouncement(const communicationPath& path, const std::string& announcement)
+		{
+			if (!m_announceCb) {
+				return;
+			}
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			m_announceCb(m_strings.getString(path.uuid), m_strings.getString(path.receivingInterface), m_strings.getString(path.sendingInterface), m_strings.getString(path.router), announcement);
+			if ((m_pMetrics) && (m_timeCallbacks)) {
+				m_pMetrics->addCallback(std::chrono::steady_clock::now()-start);
+			}
+		}
 
+		void DeviceMonitor::notifyExpiry(const communicationPath& path)
+		{
+			if (!m_expireCb) {
+				return;
+			}
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			m_expireCb(m_strings.getString(path.uuid), m_strings.getString(path.receivingInterface), m_strings.getString(path.sendingInterface), m_strings.getString(path.router));
+			if ((m_pMetrics) && (m_timeCallbacks)) {
+				m_pMetrics->addCallback(std::chrono::steady_clock::now()-start);
+			}
+		}
+
+		void DeviceMonitor::setMetrics(ReceiverMetrics* pMetrics, bool timeCallbacks)
+		{
+			m_pMetrics = pMetrics;
+			m_timeCallbacks = timeCallbacks;
+		}
+
+		string::Interner::id_t DeviceMonitor::acquireInterfaceId(const std::string& interfaceName)
+		{
+			return m_strings.acquire(interfaceName);
+		}
+
+		void DeviceMonitor::releaseInterfaceId(string::Interner::id_t interfaceId)
+		{
+			m_strings.release(interfaceId);
+		}
+
+		void DeviceMonitor::releasePath(const communicationPath& path)
+		{
+			m_strings.release(path.receivingInterface);
+			m_strings.release(path.sendingInterface);
+			m_strings.release(path.uuid);
+			m_strings.release(path.router);
+		}
+
+		std::string DeviceMonitor::getAnnouncement(AnnouncementTable::entry_t entry) const
+		{
+			PayloadArena::handle_t payload = m_announcements.getPayload(entry);
+			return std::string(m_payloads.getData(payload), m_payloads.getLength(payload));
+		}
+
+		void DeviceMonitor::processReceivedAnnouncement(const std::string& receivingInterfaceName, const std::string &message)
+		{
+			processReceivedAnnouncement(receivingInterfaceName, message.c_str(), message.length());
+		}
+
+		bool DeviceMonitor::refreshRepeatedAnnouncement(uint64_t fingerprint, string::Interner::id_t receivingInterface, const char* pMessage, size_t messageLength, std::chrono::steady_clock::time_point now)
+		{
+			fingerprints_t::const_iterator iter = m_fingerprints.find(fingerprint);
+			if (iter==m_fingerprints.end()) {
+				return false;
+			}
+
+			// the fingerprint might collide. Make sure, this is really the same announcement received on the same interface.
+			AnnouncementTable::entry_t entry = iter->second;
+			if (m_payloads.equals(m_announcements.getPayload(entry), pMessage, messageLength)==false) {
+				return false;
+			}
+			if (m_announcements.getPath(entry).receivingInterface!=receivingInterface) {
+				return false;
+			}
+
+			m_announcements.setTimeOfExpiry(entry, now + m_announcements.getExpiration(entry));
+			expiryHeapUpdate(m_announcements.getHeapPosition(entry));
+			return true;
+		}
+
+		void DeviceMonitor::eraseFingerprint(AnnouncementTable::entry_t entry)
+		{
+			fingerprints_t::iterator iter = m_fingerprints.find(m_announcements.getFingerprint(entry));
+			// on collision, the fingerprint might belong to another entry
+			if ((iter!=m_fingerprints.end()) && (iter->second==entry)) {
+				m_fingerprints.erase(iter);
+			}
+		}
+
+		void DeviceMonitor::processReceivedAnnouncement(const std::string& receivingInterfaceName, const char* pMessage, size_t messageLength, std::chrono::system_clock::time_point timeOfArrival)
+		{
+			// a new communication path takes a reference of its own
+			string::Interner::id_t receivingInterface = m_strings.acquire(receivingInterfaceName);
+			processReceivedAnnouncement(receivingInterface, pMessage, messageLength, timeOfArrival);
+			m_strings.release(receivingInterface);
+		}
+
+		void DeviceMonitor::processReceivedAnnouncement(string::Interner::id_t receivingInterface, const char* pMessage, size_t messageLength, std::chrono::system_clock::time_point timeOfArrival)
+		{
 			try {
-				if ( ! Json::Reader().parse(message, announcement)) {
-					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_PARSE, "JSON parser failed", message);
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				if ((m_pMetrics) && (timeOfArrival!=std::chrono::system_clock::time_point())) {
+					m_pMetrics->addLatency(ReceiverMetrics::RECEIVE_TO_PARSE, std::chrono::duration_cast < std::chrono::nanoseconds > (std::chrono::system_clock::now()-timeOfArrival));
+				}
+
+				// fast path: nothing to parse for repeated announcements
+				uint64_t fingerprint = fnv1a(reinterpret_cast < const char* > (&receivingInterface), sizeof(receivingInterface));
+				fingerprint = fnv1a(pMessage, messageLength, fingerprint);
+				if (refreshRepeatedAnnouncement(fingerprint, receivingInterface, pMessage, messageLength, now)) {
+					if (m_pMetrics) {
+						m_pMetrics->increment(ReceiverMetrics::REPEATED);
+						m_pMetrics->addLatency(ReceiverMetrics::PARSE_TO_UPDATE, std::chrono::duration_cast < std::chrono::nanoseconds > (std::chrono::steady_clock::now()-now));
+					}
+					return;
+				}
+
+				AnnouncementDecoder decoder;
+				if (decoder.decode(pMessage, messageLength)) {
+					if ( ! decoder.getMethod().equals(TAG_Announce) ) {
+						callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_METHOD, "Missing \"announcement\" in JSON-document", pMessage, messageLength);
+						return;
+					}
+
+					// this is an announcement!
+					if (decoder.getSendingInterfaceName().empty()) {
+						callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_IPADDR, "Missing interface name in JSON-document", pMessage, messageLength);
+						return;
+					}
+
+					if (decoder.getUuid().empty()) {
+						callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_UUID, "Missing uuid in JSON-document", pMessage, messageLength);
+						return;
+					}
+
+					std::chrono::seconds expire(decoder.getExpiration());
+					if (expire.count() == 0 ) {
+						callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_EXPIRE, "Missing expiration in JSON-document", pMessage, messageLength);
+						return;
+					}
+
+					updateAnnouncement(receivingInterface, decoder.getSendingInterfaceName(), decoder.getUuid(), decoder.getRouter(), expire, pMessage, messageLength, fingerprint, now);
+					return;
+				}
+
+				// anything unusual is left to the complete JSON parser
+				if (m_pMetrics) {
+					m_pMetrics->increment(ReceiverMetrics::PARSED_BY_FALLBACK);
+				}
+				Json::Value announcement;
+				if ( ! Json::Reader().parse(pMessage, pMessage+messageLength, announcement)) {
+					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_PARSE, "JSON parser failed", pMessage, messageLength);
 					return;
 				}
 				if ( ! (announcement[hbm::jsonrpc::METHOD].asString()==TAG_Announce) ) {
-					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_METHOD, "Missing \"announcement\" in JSON-document", message);
+					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_METHOD, "Missing \"announcement\" in JSON-document", pMessage, messageLength);
 					return;
 				}
 
@@ -103,56 +275,100 @@ namespace hbm {
 				// this is an announcement!
 				std::string sendingInterfaceName = params[TAG_NetSettings][TAG_Interface][TAG_Name].asString();
 				if (sendingInterfaceName.empty()) {
-					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_IPADDR, "Missing interface name in JSON-document", message);
+					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_IPADDR, "Missing interface name in JSON-document", pMessage, messageLength);
 					return;
 				}
 
 				std::string sendingUuid(params[TAG_Device][TAG_Uuid].asString());
 				if (sendingUuid.empty()) {
-					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_UUID, "Missing uuid in JSON-document", message);
+					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_UUID, "Missing uuid in JSON-document", pMessage, messageLength);
 					return;
 				}
 
 				std::string router(params[TAG_Router][TAG_Uuid].asString());
-				std::string key(receivingInterfaceName+":"+sendingInterfaceName+":"+sendingUuid+":"+router);
 
-				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 				std::chrono::seconds expire(params[TAG_Expiration].asUInt());
 				if (expire.count() == 0 ) {
-					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_EXPIRE, "Missing expiration in JSON-document", message);
+					callErrorCb(cb_t::DATA_DROPPED | cb_t::ERROR_EXPIRE, "Missing expiration in JSON-document", pMessage, messageLength);
 					return;
 				}
 
-//				callErrorCb(0, "received", message);
+				AnnouncementDecoder::field_t sendingInterfaceField = { sendingInterfaceName.c_str(), sendingInterfaceName.length() };
+				AnnouncementDecoder::field_t sendingUuidField = { sendingUuid.c_str(), sendingUuid.length() };
+				AnnouncementDecoder::field_t routerField = { router.c_str(), router.length() };
+				updateAnnouncement(receivingInterface, sendingInterfaceField, sendingUuidField, routerField, expire, pMessage, messageLength, fingerprint, now);
+			}
+			catch(std::exception &) {
+				callErrorCb(cb_t::DATA_DROPPED | cb_t::E_EXCEPTION1, "Receiving error 1", pMessage, messageLength);
+			}
+			catch(...) {
+				callErrorCb(cb_t::DATA_DROPPED | cb_t::E_EXCEPTION2, "Receiving error 2", pMessage, messageLength);
+			}
+		}
+
+		void DeviceMonitor::updateAnnouncement(string::Interner::id_t receivingInterface, const AnnouncementDecoder::field_t& sendingInterfaceName, const AnnouncementDecoder::field_t& sendingUuid, const AnnouncementDecoder::field_t& router, std::chrono::seconds expire, const char* pMessage, size_t messageLength, uint64_t fingerprint, std::chrono::steady_clock::time_point now)
+		{
+			// the strings are looked up within the received message. There is no communication path with a string not known.
+			AnnouncementTable::entry_t entry = AnnouncementTable::NO_ENTRY;
+			string::Interner::id_t sendingInterface = m_strings.find(sendingInterfaceName.pData, sendingInterfaceName.length);
+			string::Interner::id_t uuid = m_strings.find(sendingUuid.pData, sendingUuid.length);
+			string::Interner::id_t routerId = m_strings.find(router.pData, router.length);
+			if ((sendingInterface!=string::Interner::NO_ID) && (uuid!=string::Interner::NO_ID) && (routerId!=string::Interner::NO_ID)) {
+				entry = m_announcements.find(communicationPath(receivingInterface, sendingInterface, uuid, routerId));
+			}
 
-				announcements_t::iterator iter = m_announcements.find(key);
-				if (iter!=m_announcements.end()) {
-					// update existing entry
-					expiringEntry& currentEntry = iter->second;
-					currentEntry.timeOfExpiry = now + expire;
-					if (message!=currentEntry.announcement) {
-						// something has changed
-						currentEntry.announcement = message;
-						if (m_announceCb) {
-							m_announceCb(sendingUuid, receivingInterfaceName, sendingInterfaceName, router, message);
-						}
-					}
-				} else {
-					// new entry
-					expiringEntry entry;
-					entry.announcement = message;
-					entry.timeOfExpiry = now + expire;
-					m_announcements[key] = entry;
-					if (m_announceCb) {
-						m_announceCb(sendingUuid, receivingInterfaceName, sendingInterfaceName, router, message);
+			// new or changed announcement to be notified
+			AnnouncementTable::entry_t notify = AnnouncementTable::NO_ENTRY;
+			if (entry!=AnnouncementTable::NO_ENTRY) {
+				// update existing entry
+				m_announcements.setTimeOfExpiry(entry, now + expire);
+				m_announcements.setExpiration(entry, expire);
+				expiryHeapUpdate(m_announcements.getHeapPosition(entry));
+				if (m_payloads.equals(m_announcements.getPayload(entry), pMessage, messageLength)==false) {
+					// something has changed
+					if (m_pMetrics) {
+						m_pMetrics->increment(ReceiverMetrics::CHANGED);
 					}
+					eraseFingerprint(entry);
+					m_payloads.release(m_announcements.getPayload(entry));
+					m_announcements.setPayload(entry, m_payloads.store(pMessage, messageLength));
+					m_announcements.setFingerprint(entry, fingerprint);
+					m_fingerprints[fingerprint] = entry;
+					notify = entry;
 				}
+			} else {
+				// new entry
+				if (m_pMetrics) {
+					m_pMetrics->increment(ReceiverMetrics::NEW);
+				}
+				m_strings.addReference(receivingInterface);
+				sendingInterface = m_strings.acquire(sendingInterfaceName.pData, sendingInterfaceName.length);
+				uuid = m_strings.acquire(sendingUuid.pData, sendingUuid.length);
+				routerId = m_strings.acquire(router.pData, router.length);
+				entry = m_announcements.insert(communicationPath(receivingInterface, sendingInterface, uuid, routerId));
+				m_announcements.setPayload(entry, m_payloads.store(pMessage, messageLength));
+				m_announcements.setTimeOfExpiry(entry, now + expire);
+				m_announcements.setExpiration(entry, expire);
+				m_announcements.setFingerprint(entry, fingerprint);
+				m_fingerprints[fingerprint] = entry;
+				expiryHeapPush(entry);
+				notify = entry;
 			}
-			catch(std::exception &) {
-				callErrorCb(cb_t::DATA_DROPPED | cb_t::E_EXCEPTION1, "Receiving error 1", message);
+
+			std::chrono::steady_clock::time_point updated;
+			if (m_pMetrics) {
+				updated = std::chrono::steady_clock::now();
+				m_pMetrics->addLatency(ReceiverMetrics::PARSE_TO_UPDATE, std::chrono::duration_cast < std::chrono::nanoseconds > (updated-now));
 			}
-			catch(...) {
-				callErrorCb(cb_t::DATA_DROPPED | cb_t::E_EXCEPTION2, "Receiving error 2", message);
+
+			if (notify!=AnnouncementTable::NO_ENTRY) {
+				// the announcement is copied out of the arena only if there is someone to tell
+				if (m_announceCb) {
+					notifyAnnouncement(m_announcements.getPath(notify), getAnnouncement(notify));
+				}
+				if ((m_pMetrics) && (m_timeCallbacks)) {
+					m_pMetrics->addLatency(ReceiverMetrics::UPDATE_TO_CALLBACK_RETURN, std::chrono::duration_cast < std::chrono::nanoseconds > (std::chrono::steady_clock::now()-updated));
+				}
 			}
 		}
 
@@ -169,21 +385,103 @@ namespace hbm {
 		{
 			std::chrono::steady_clock::time_point timeNow = std::chrono::steady_clock::now();
 
-			announcements_t::iterator iter=m_announcements.begin();
-			while (iter!=m_announcements.end()) {
-				if (iter->second.timeOfExpiry< timeNow) {
-					if (m_expireCb) {
-						try {
-							communicationPath path(iter->first);
-							m_expireCb(path.uuid, path.receivingInterface, path.sendingInterface, path.router);
-						} catch(...)
-						{
-						}
-					}
-					iter = m_announcements.erase(iter);
-				} else {
-					++iter;
+			// the heap is ordered by time of expiry. We are done with the first one that is not due.
+			while ((m_expiryHeap.empty()==false) && (m_announcements.getTimeOfExpiry(m_expiryHeap.front()) < timeNow)) {
+				AnnouncementTable::entry_t entry = m_expiryHeap.front();
+				expiryHeapPop();
+				if (m_pMetrics) {
+					m_pMetrics->increment(ReceiverMetrics::EXPIRED);
+				}
+				try {
+					notifyExpiry(m_announcements.getPath(entry));
+				} catch(...)
+				{
+				}
+				eraseFingerprint(entry);
+				m_payloads.release(m_announcements.getPayload(entry));
+				releasePath(m_announcements.getPath(entry));
+				m_announcements.erase(entry);
+			}
+		}
+
+		std::chrono::steady_clock::time_point DeviceMonitor::getNextExpiry() const
+		{
+			if (m_expiryHeap.empty()) {
+				return std::chrono::steady_clock::time_point::max();
+			}
+			return m_announcements.getTimeOfExpiry(m_expiryHeap.front());
+		}
+
+		DeviceMonitor::memoryUsage_t DeviceMonitor::getMemoryUsage() const
+		{
+			memoryUsage_t usage;
+			usage.deviceCount = m_announcements.size();
+			usage.payloadBytes = m_payloads.getResidentBytes();
+			usage.nodeBytes = m_nodePool.getResidentBytes();
+			usage.indexBytes = m_announcements.getResidentBytes() + m_fingerprints.bucket_count() * sizeof(void*) + m_expiryHeap.capacity() * sizeof(AnnouncementTable::entry_t);
+			return usage;
+		}
+
+		void DeviceMonitor::expiryHeapPush(AnnouncementTable::entry_t entry)
+		{
+			m_announcements.setHeapPosition(entry, m_expiryHeap.size());
+			m_expiryHeap.push_back(entry);
+			expiryHeapSiftUp(m_expiryHeap.size()-1);
+		}
+
+		void DeviceMonitor::expiryHeapUpdate(size_t position)
+		{
+			// refreshing an entry usually moves it towards the end
+			expiryHeapSiftDown(expiryHeapSiftUp(position));
+		}
+
+		void DeviceMonitor::expiryHeapPop()
+		{
+			expiryHeapSwap(0, m_expiryHeap.size()-1);
+			m_expiryHeap.pop_back();
+			if (m_expiryHeap.empty()==false) {
+				expiryHeapSiftDown(0);
+			}
+		}
+
+		void DeviceMonitor::expiryHeapSwap(size_t position1, size_t position2)
+		{
+			std::swap(m_expiryHeap[position1], m_expiryHeap[position2]);
+			m_announcements.setHeapPosition(m_expiryHeap[position1], position1);
+			m_announcements.setHeapPosition(m_expiryHeap[position2], position2);
+		}
+
+		size_t DeviceMonitor::expiryHeapSiftUp(size_t position)
+		{
+			while (position>0) {
+				size_t parent = (position-1) / 2;
+				if (m_announcements.getTimeOfExpiry(m_expiryHeap[parent]) <= m_announcements.getTimeOfExpiry(m_expiryHeap[position])) {
+					break;
+				}
+				expiryHeapSwap(parent, position);
+				position = parent;
+			}
+			return position;
+		}
+
+		void DeviceMonitor::expiryHeapSiftDown(size_t position)
+		{
+			size_t count = m_expiryHeap.size();
+			while (true) {
+				size_t smallest = position;
+				size_t left = 2*position + 1;
+				size_t right = left + 1;
+				if ((left<count) && (m_announcements.getTimeOfExpiry(m_expiryHeap[left]) < m_announcements.getTimeOfExpiry(m_expiryHeap[smallest]))) {
+					smallest = left;
+				}
+				if ((right<count) && (m_announcements.getTimeOfExpiry(m_expiryHeap[right]) < m_announcements.getTimeOfExpiry(m_expiryHeap[smallest]))) {
+					smallest = right;
+				}
+				if (smallest==position) {
+					return;
 				}
+				expiryHeapSwap(position, smallest);
+				position = smallest;
 			}
 		}
 	}
@@ -0,0 +1,80 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <memory>
+#include <vector>
+
+#include "nodepool.h"
+
+
+namespace hbm {
+	namespace devscan {
+		NodePool::NodePool()
+			: m_sizeClasses()
+			, m_chunks()
+			, m_residentBytes(0)
+			, m_usedBytes(0)
+		{
+		}
+
+		NodePool::sizeClass_t& NodePool::getSizeClass(size_t blockSize)
+		{
+			for (sizeClasses_t::iterator iter = m_sizeClasses.begin(); iter != m_sizeClasses.end(); ++iter) {
+				if (iter->blockSize==blockSize) {
+					return *iter;
+				}
+			}
+
+			sizeClass_t sizeClass;
+			sizeClass.blockSize = blockSize;
+			sizeClass.pFree = NULL;
+			sizeClass.pUnused = NULL;
+			sizeClass.pEnd = NULL;
+			m_sizeClasses.push_back(sizeClass);
+			return m_sizeClasses.back();
+		}
+
+		void* NodePool::allocate(size_t size)
+		{
+			size_t blockSize = (size+ALIGNMENT-1) & ~(ALIGNMENT-1);
+			if (blockSize>CHUNK_SIZE) {
+				return ::operator new(size);
+			}
+
+			sizeClass_t& sizeClass = getSizeClass(blockSize);
+			m_usedBytes += blockSize;
+			if (sizeClass.pFree) {
+				freeBlock_t* pBlock = sizeClass.pFree;
+				sizeClass.pFree = pBlock->pNext;
+				return pBlock;
+			}
+
+			if (static_cast < size_t > (sizeClass.pEnd-sizeClass.pUnused)<blockSize) {
+				m_chunks.push_back(std::unique_ptr < char[] > (new char[CHUNK_SIZE]));
+				m_residentBytes += CHUNK_SIZE;
+				sizeClass.pUnused = m_chunks.back().get();
+				sizeClass.pEnd = sizeClass.pUnused + CHUNK_SIZE;
+			}
+
+			void* pBlock = sizeClass.pUnused;
+			sizeClass.pUnused += blockSize;
+			return pBlock;
+		}
+
+		void NodePool::deallocate(void* pBlock, size_t size)
+		{
+			size_t blockSize = (size+ALIGNMENT-1) & ~(ALIGNMENT-1);
+			if (blockSize>CHUNK_SIZE) {
+				::operator delete(pBlock);
+				return;
+			}
+
+			sizeClass_t& sizeClass = getSizeClass(blockSize);
+			m_usedBytes -= blockSize;
+			freeBlock_t* pFreeBlock = static_cast < freeBlock_t* > (pBlock);
+			pFreeBlock->pNext = sizeClass.pFree;
+			sizeClass.pFree = pFreeBlock;
+		}
+	}
+}
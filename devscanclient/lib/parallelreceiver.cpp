@@ -0,0 +1,260 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <string>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+#include "hbm/sys/eventloop.h"
+
+#include "parallelreceiver.h"
+#include "announcementcollector.h"
+
+#include "defines.h"
+
+namespace hbm {
+	namespace devscan {
+
+		ParallelReceiver::worker_t::worker_t(communication::NetadapterList& netadapterList)
+			: eventloop()
+			, collector(netadapterList, eventloop)
+			, thread()
+		{
+		}
+
+		ParallelReceiver::ParallelReceiver(unsigned int workerCount)
+			: m_eventloop()
+			, m_netadapterList()
+			, m_netlink(m_netadapterList, m_eventloop)
+			, m_metrics()
+			, m_workers()
+			, m_metricsTimer(m_eventloop)
+			, m_metricsCb()
+			, m_previousMetrics()
+			, m_callbackMtx()
+			, m_announceCb()
+			, m_expireCb()
+			, m_errorCb()
+		{
+			if (workerCount==0) {
+				workerCount = std::thread::hardware_concurrency();
+				if (workerCount==0) {
+					// unknown
+					workerCount = 1;
+				}
+			}
+
+			for (unsigned int i = 0; i < workerCount; ++i) {
+				std::unique_ptr < worker_t > pWorker(new worker_t(m_netadapterList));
+				pWorker->collector.setAnnounceCb(std::bind(&ParallelReceiver::announceCb, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+				pWorker->collector.setExpireCb(std::bind(&ParallelReceiver::expireCb, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+				pWorker->collector.setErrorCb(std::bind(&ParallelReceiver::errorCb, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+				pWorker->collector.setMetrics(&m_metrics);
+				m_workers.push_back(std::move(pWorker));
+			}
+		}
+
+		size_t ParallelReceiver::getWorkerIndex(unsigned int adapterIndex) const
+		{
+			return adapterIndex % m_workers.size();
+		}
+
+		void ParallelReceiver::netLinkEventHandler(Netlink::event_t event)
+		{
+			switch (event) {
+			case hbm::Netlink::COMPLETE:
+				updateAllInterfaces();
+				break;
+			}
+		}
+
+		void ParallelReceiver::updateAllInterfaces()
+		{
+			std::vector < communication::MulticastServer::interfaceAddresses_t > interfaceAddresses(m_workers.size());
+			communication::NetadapterList::tAdaptersPtr pAdapters = m_netadapterList.getAdapters();
+			for (communication::NetadapterList::tAdapters::const_iterator iter = pAdapters->begin(); iter != pAdapters->end(); ++iter) {
+				const communication::addressesWithNetmask_t& addresses = iter->second.getIpv4Addresses();
+				if(addresses.empty()==false) {
+					interfaceAddresses[getWorkerIndex(iter->first)].insert(addresses.front().address);
+				}
+			}
+
+			for (size_t worker = 0; worker < m_workers.size(); ++worker) {
+				m_workers[worker]->collector.updateInterfaces(interfaceAddresses[worker]);
+			}
+		}
+
+		void ParallelReceiver::announceCb(const std::string uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router, const std::string& announcement)
+		{
+			std::lock_guard < std::mutex > lock(m_callbackMtx);
+			if (m_announceCb) {
+				m_announceCb(uuid, receivingInterfaceName, sendingInterfaceName, router, announcement);
+			}
+		}
+
+		void ParallelReceiver::expireCb(const std::string uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router)
+		{
+			std::lock_guard < std::mutex > lock(m_callbackMtx);
+			if (m_expireCb) {
+				m_expireCb(uuid, receivingInterfaceName, sendingInterfaceName, router);
+			}
+		}
+
+		void ParallelReceiver::errorCb(uint32_t errorCode, const std::string& userMessage, const std::string& receivedData)
+		{
+			std::lock_guard < std::mutex > lock(m_callbackMtx);
+			if (m_errorCb) {
+				m_errorCb(errorCode, userMessage, receivedData);
+			}
+		}
+
+		void ParallelReceiver::setAnnounceCb(announceCb_t cb)
+		{
+			{
+				std::lock_guard < std::mutex > lock(m_callbackMtx);
+				m_announceCb = cb;
+			}
+
+			// setting the callback again makes the workers report all current announcements
+			for (workers_t::iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				(*iter)->collector.setAnnounceCb(std::bind(&ParallelReceiver::announceCb, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+			}
+		}
+
+
+		void ParallelReceiver::setExpireCb(expireCb_t cb)
+		{
+			std::lock_guard < std::mutex > lock(m_callbackMtx);
+			m_expireCb = cb;
+		}
+
+
+		void ParallelReceiver::setErrorCb(errorCb_t cb)
+		{
+			std::lock_guard < std::mutex > lock(m_callbackMtx);
+			m_errorCb = cb;
+		}
+
+		void ParallelReceiver::startDispatching(size_t capacity, CallbackDispatcher::overflowPolicy_t overflowPolicy)
+		{
+			for (workers_t::iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				(*iter)->collector.startDispatching(capacity, overflowPolicy);
+			}
+		}
+
+
+		void ParallelReceiver::stopDispatching()
+		{
+			for (workers_t::iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				(*iter)->collector.stopDispatching();
+			}
+		}
+
+		void ParallelReceiver::setReceiveBufferSize(int size, int maxSize)
+		{
+			for (workers_t::iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				(*iter)->collector.setReceiveBufferSize(size, maxSize);
+			}
+		}
+
+		uint64_t ParallelReceiver::getKernelDropCount() const
+		{
+			uint64_t dropCount = 0;
+			for (workers_t::const_iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				dropCount += (*iter)->collector.getKernelDropCount();
+			}
+			return dropCount;
+		}
+
+		ReceiverMetrics::snapshot_t ParallelReceiver::getMetrics() const
+		{
+			ReceiverMetrics::snapshot_t snapshot = m_metrics.getSnapshot();
+			snapshot.kernelDrops = getKernelDropCount();
+			for (workers_t::const_iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				DeviceMonitor::memoryUsage_t memoryUsage = (*iter)->collector.getMemoryUsage();
+				snapshot.deviceCount += memoryUsage.deviceCount;
+				snapshot.residentBytes += memoryUsage.getResidentBytes();
+			}
+			return snapshot;
+		}
+
+		void ParallelReceiver::setMetricsCb(metricsCb_t cb, std::chrono::milliseconds interval)
+		{
+			m_metricsCb = cb;
+			if (m_metricsCb) {
+				m_previousMetrics = getMetrics();
+				m_metricsTimer.set(interval, true, std::bind(&ParallelReceiver::metricsTimerCb, this, std::placeholders::_1));
+			} else {
+				m_metricsTimer.cancel();
+			}
+		}
+
+		void ParallelReceiver::metricsTimerCb(bool fired)
+		{
+			if ((fired==false) || (!m_metricsCb)) {
+				return;
+			}
+
+			ReceiverMetrics::snapshot_t snapshot = getMetrics();
+			try {
+				m_metricsCb(snapshot, m_previousMetrics);
+			} catch(...) {
+			}
+			m_previousMetrics = snapshot;
+		}
+
+		void ParallelReceiver::execute(std::chrono::milliseconds timeOfExecution)
+		{
+			for (workers_t::iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				(*iter)->collector.start(false);
+			}
+			m_netlink.start(std::bind(&ParallelReceiver::netLinkEventHandler, this, std::placeholders::_1));
+
+			for (workers_t::iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				worker_t& worker = **iter;
+				worker.thread = std::thread(&sys::EventLoop::execute, &worker.eventloop);
+			}
+
+			if (timeOfExecution==std::chrono::milliseconds(0)) {
+				m_eventloop.execute();
+			} else {
+				m_eventloop.execute_for(timeOfExecution);
+			}
+
+			for (workers_t::iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				worker_t& worker = **iter;
+				worker.eventloop.stop();
+				worker.thread.join();
+			}
+
+			m_netlink.stop();
+			for (workers_t::iterator iter = m_workers.begin(); iter != m_workers.end(); ++iter) {
+				(*iter)->collector.stop();
+			}
+		}
+
+		void ParallelReceiver::start()
+		{
+			execute(std::chrono::milliseconds(0));
+		}
+
+
+		void ParallelReceiver::start_for(std::chrono::milliseconds timeOfExecution)
+		{
+			if (timeOfExecution==std::chrono::milliseconds(0)) {
+				// nothing to do. Do not confuse with execution until stop() is called.
+				return;
+			}
+			execute(timeOfExecution);
+		}
+
+		void ParallelReceiver::stop()
+		{
+			// the workers are stopped by the thread executing start()
+			m_eventloop.stop();
+		}
+	}
+}
@@ -0,0 +1,114 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "payloadarena.h"
+
+
+namespace hbm {
+	namespace devscan {
+		const PayloadArena::handle_t PayloadArena::NO_HANDLE;
+
+		PayloadArena::PayloadArena()
+			: m_payloads()
+			, m_freeHandles()
+			, m_slabs()
+			, m_slabUsed(0)
+			, m_usedBytes(0)
+			, m_payloadBytes(0)
+		{
+		}
+
+		char* PayloadArena::allocate(slabs_t& slabs, size_t& slabUsed, size_t length, payload_t& payload)
+		{
+			if ((slabs.empty()) || (slabUsed+length>slabs.back().size)) {
+				slab_t slab;
+				slab.size = SLAB_SIZE;
+				if (length>slab.size) {
+					slab.size = length;
+				}
+				slab.pData.reset(new char[slab.size]);
+				slabs.push_back(std::move(slab));
+				slabUsed = 0;
+			}
+
+			payload.slab = static_cast < uint32_t > (slabs.size()-1);
+			payload.offset = static_cast < uint32_t > (slabUsed);
+			payload.length = static_cast < uint32_t > (length);
+			slabUsed += length;
+			return slabs.back().pData.get() + payload.offset;
+		}
+
+		PayloadArena::handle_t PayloadArena::store(const char* pData, size_t length)
+		{
+			handle_t handle;
+			if (m_freeHandles.empty()) {
+				handle = static_cast < handle_t > (m_payloads.size());
+				m_payloads.push_back(payload_t());
+			} else {
+				handle = m_freeHandles.back();
+				m_freeHandles.pop_back();
+			}
+
+			char* pDestination = allocate(m_slabs, m_slabUsed, length, m_payloads[handle]);
+			memcpy(pDestination, pData, length);
+			m_usedBytes += length;
+			m_payloadBytes += length;
+			return handle;
+		}
+
+		void PayloadArena::release(handle_t handle)
+		{
+			payload_t& payload = m_payloads[handle];
+			m_payloadBytes -= payload.length;
+			payload.slab = NO_SLAB;
+			payload.length = 0;
+			m_freeHandles.push_back(handle);
+
+			size_t garbage = m_usedBytes - m_payloadBytes;
+			if ((garbage>m_payloadBytes) && (garbage>=SLAB_SIZE)) {
+				compact();
+			}
+		}
+
+		bool PayloadArena::equals(handle_t handle, const char* pData, size_t length) const
+		{
+			if (getLength(handle)!=length) {
+				return false;
+			}
+			return memcmp(getData(handle), pData, length)==0;
+		}
+
+		void PayloadArena::compact()
+		{
+			slabs_t slabs;
+			size_t slabUsed = 0;
+			for (payloads_t::iterator iter = m_payloads.begin(); iter != m_payloads.end(); ++iter) {
+				payload_t& payload = *iter;
+				if (payload.slab==NO_SLAB) {
+					continue;
+				}
+				const char* pSource = m_slabs[payload.slab].pData.get() + payload.offset;
+				char* pDestination = allocate(slabs, slabUsed, payload.length, payload);
+				memcpy(pDestination, pSource, payload.length);
+			}
+
+			m_slabs.swap(slabs);
+			m_slabUsed = slabUsed;
+			m_usedBytes = m_payloadBytes;
+		}
+
+		size_t PayloadArena::getResidentBytes() const
+		{
+			size_t bytes = m_payloads.capacity()*sizeof(payload_t) + m_freeHandles.capacity()*sizeof(handle_t) + m_slabs.capacity()*sizeof(slab_t);
+			for (slabs_t::const_iterator iter = m_slabs.begin(); iter != m_slabs.end(); ++iter) {
+				bytes += iter->size;
+			}
+			return bytes;
+		}
+	}
+}
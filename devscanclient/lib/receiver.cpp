@@ -12,7 +12,7 @@
 #include "hbm/sys/eventloop.h"
 
 #include "receiver.h"
-#include "devicemonitor.h"
+#include "announcementcollector.h"
 
 #include "defines.h"
 
@@ -21,76 +21,118 @@ namespace hbm {
 
 		Receiver::Receiver()
 			: m_netadapterList()
-			, m_scanner(m_netadapterList, m_eventloop)
-			, m_timer(m_eventloop)
+			, m_metrics()
+			, m_collector(m_netadapterList, m_eventloop)
 			, m_netlink(m_netadapterList, m_eventloop)
+			, m_metricsTimer(m_eventloop)
+			, m_metricsCb()
+			, m_previousMetrics()
 		{
+			m_collector.setMetrics(&m_metrics);
 		}
 
-		ssize_t Receiver::receiveEventHandler(communication::MulticastServer* pMcs)
-		{
-			// receive announcement
-			char readBuffer[communication::MAX_DATAGRAM_SIZE];
-			int ttl;
-			std::string adapterName;
-			ssize_t nBytes = pMcs->receiveTelegram(readBuffer, sizeof(readBuffer), adapterName, ttl);
-			if(nBytes > 0) {
-				m_deviceMonitor.processReceivedAnnouncement(adapterName, std::string(readBuffer, nBytes));
-			}
-			return nBytes;
-		}
-
-		void Receiver::netLinkEventHandler(Netlink::event_t event, unsigned int adapterIndex, const std::string& ipv4Address)
+		void Receiver::netLinkEventHandler(Netlink::event_t event)
 		{
 			switch (event) {
-			case hbm::Netlink::NEW:
-				try {
-					communication::Netadapter adapter = m_netadapterList.getAdapterByInterfaceIndex(adapterIndex);
-					m_scanner.addInterface(ipv4Address);
-				}
-				catch (...) {
-				}
-				break;
-			case hbm::Netlink::DEL:
-				m_scanner.dropInterface(ipv4Address);
 			case hbm::Netlink::COMPLETE:
-				m_scanner.dropAllInterfaces();
-				m_scanner.addAllInterfaces();
+				// only the memberships of interfaces that did change are touched
+				m_collector.updateAllInterfaces();
+				break;
 			}
 		}
 
 		void Receiver::setAnnounceCb(announceCb_t cb)
 		{
-			m_deviceMonitor.setAnnounceCb(cb);
+			m_collector.setAnnounceCb(cb);
 		}
 
 
 		void Receiver::setExpireCb(expireCb_t cb)
 		{
-			m_deviceMonitor.setExpireCb(cb);
+			m_collector.setExpireCb(cb);
 		}
 
 
 		void Receiver::setErrorCb(errorCb_t cb)
 		{
-			m_deviceMonitor.setErrorCb(cb);
+			m_collector.setErrorCb(cb);
+		}
+
+
+		void Receiver::startDispatching(size_t capacity, CallbackDispatcher::overflowPolicy_t overflowPolicy)
+		{
+			m_collector.startDispatching(capacity, overflowPolicy);
+		}
+
+
+		void Receiver::stopDispatching()
+		{
+			m_collector.stopDispatching();
+		}
+
+
+		void Receiver::setReceiveBufferSize(int size, int maxSize)
+		{
+			m_collector.setReceiveBufferSize(size, maxSize);
+		}
+
+
+		uint64_t Receiver::getKernelDropCount() const
+		{
+			return m_collector.getKernelDropCount();
+		}
+
+
+		ReceiverMetrics::snapshot_t Receiver::getMetrics() const
+		{
+			ReceiverMetrics::snapshot_t snapshot = m_metrics.getSnapshot();
+			snapshot.kernelDrops = m_collector.getKernelDropCount();
+			DeviceMonitor::memoryUsage_t memoryUsage = m_collector.getMemoryUsage();
+			snapshot.deviceCount = memoryUsage.deviceCount;
+			snapshot.residentBytes = memoryUsage.getResidentBytes();
+			return snapshot;
+		}
+
+
+		void Receiver::setMetricsCb(metricsCb_t cb, std::chrono::milliseconds interval)
+		{
+			m_metricsCb = cb;
+			if (m_metricsCb) {
+				m_previousMetrics = getMetrics();
+				m_metricsTimer.set(interval, true, std::bind(&Receiver::metricsTimerCb, this, std::placeholders::_1));
+			} else {
+				m_metricsTimer.cancel();
+			}
+		}
+
+
+		void Receiver::metricsTimerCb(bool fired)
+		{
+			if ((fired==false) || (!m_metricsCb)) {
+				return;
+			}
+
+			ReceiverMetrics::snapshot_t snapshot = getMetrics();
+			try {
+				m_metricsCb(snapshot, m_previousMetrics);
+			} catch(...) {
+			}
+			m_previousMetrics = snapshot;
 		}
 
 
 		void Receiver::start()
 		{
-			m_scanner.start(ANNOUNCE_IPV4_ADDRESS, ANNOUNCE_UDP_PORT, std::bind(&Receiver::receiveEventHandler, this, std::placeholders::_1));
-			m_timer.set(1000, true, std::bind(&DeviceMonitor::checkForExpiredTimerCb, std::ref(m_deviceMonitor), std::placeholders::_1));
-			m_netlink.start(std::bind(&Receiver::netLinkEventHandler, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+			m_collector.start();
+			m_netlink.start(std::bind(&Receiver::netLinkEventHandler, this, std::placeholders::_1));
 			m_eventloop.execute();
 		}
 
 
 		void Receiver::start_for(std::chrono::milliseconds timeOfExecution)
 		{
-			m_scanner.start(ANNOUNCE_IPV4_ADDRESS, ANNOUNCE_UDP_PORT, std::bind(&Receiver::receiveEventHandler, this, std::placeholders::_1));
-			m_timer.set(1000, true, std::bind(&DeviceMonitor::checkForExpiredTimerCb, std::ref(m_deviceMonitor), std::placeholders::_1));
-			m_netlink.start(std::bind(&Receiver::netLinkEventHandler, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+			m_collector.start();
+			m_netlink.start(std::bind(&Receiver::netLinkEventHandler, this, std::placeholders::_1));
 			m_eventloop.execute_for(timeOfExecution);
 		}
 
@@ -98,8 +140,7 @@ namespace hbm {
 		{
 			m_eventloop.stop();
 			m_netlink.stop();
-			m_scanner.stop();
-			m_timer.cancel();
+			m_collector.stop();
 
 		}
 	}
@@ -0,0 +1,226 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "receivermetrics.h"
+
+
+namespace hbm {
+	namespace devscan {
+		ReceiverMetrics::histogram_t::histogram_t()
+		{
+			for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+				buckets[i] = 0;
+			}
+		}
+
+		uint64_t ReceiverMetrics::histogram_t::getCount() const
+		{
+			uint64_t count = 0;
+			for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+				count += buckets[i];
+			}
+			return count;
+		}
+
+		uint64_t ReceiverMetrics::histogram_t::getPercentile(double fraction) const
+		{
+			uint64_t count = getCount();
+			if (count==0) {
+				return 0;
+			}
+
+			uint64_t limit = static_cast < uint64_t > (fraction * static_cast < double > (count));
+			if (limit==0) {
+				limit = 1;
+			}
+			uint64_t sum = 0;
+			for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+				sum += buckets[i];
+				if (sum>=limit) {
+					return getBucketUpperBound(i);
+				}
+			}
+			return getBucketUpperBound(LATENCY_BUCKET_COUNT-1);
+		}
+
+		ReceiverMetrics::snapshot_t::snapshot_t()
+			: time()
+			, latencies()
+			, kernelDrops(0)
+			, deviceCount(0)
+			, residentBytes(0)
+		{
+			for (unsigned int i = 0; i < COUNTER_COUNT; ++i) {
+				counters[i] = 0;
+			}
+		}
+
+		double ReceiverMetrics::snapshot_t::getDuplicateRatio() const
+		{
+			uint64_t processed = counters[REPEATED] + counters[NEW] + counters[CHANGED];
+			if (processed==0) {
+				return 0.0;
+			}
+			return static_cast < double > (counters[REPEATED]) / static_cast < double > (processed);
+		}
+
+		ReceiverMetrics::ReceiverMetrics()
+			: m_shards(new shard_t[SHARD_COUNT])
+		{
+			for (unsigned int shard = 0; shard < SHARD_COUNT; ++shard) {
+				for (unsigned int i = 0; i < COUNTER_COUNT; ++i) {
+					m_shards[shard].counters[i].store(0, std::memory_order_relaxed);
+				}
+				for (unsigned int latency = 0; latency < LATENCY_COUNT; ++latency) {
+					for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+						m_shards[shard].latencies[latency][i].store(0, std::memory_order_relaxed);
+					}
+				}
+			}
+		}
+
+		ReceiverMetrics::shard_t& ReceiverMetrics::getShard()
+		{
+			// thread ids tend to be aligned addresses. Multiplicative hashing moves the differing bits to the top.
+			uint64_t hash = static_cast < uint64_t > (std::hash < std::thread::id > ()(std::this_thread::get_id()));
+			hash *= 0x9e3779b97f4a7c15ULL;
+			return m_shards[hash >> 60];
+		}
+
+		unsigned int ReceiverMetrics::getBucketIndex(uint64_t nanoseconds)
+		{
+			if (nanoseconds<SUB_BUCKET_COUNT) {
+				// small values are counted exactly
+				return static_cast < unsigned int > (nanoseconds);
+			}
+
+			// position of the highest bit set
+			unsigned int exponent = SUB_BUCKET_BITS;
+			while ((nanoseconds>>(exponent+1)) && (exponent<MAX_LATENCY_BITS)) {
+				++exponent;
+			}
+			if (exponent==MAX_LATENCY_BITS) {
+				return LATENCY_BUCKET_COUNT-1;
+			}
+
+			// the bits following the highest bit select the sub bucket
+			unsigned int subBucket = static_cast < unsigned int > (nanoseconds>>(exponent-SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT-1);
+			return SUB_BUCKET_COUNT + (exponent-SUB_BUCKET_BITS)*SUB_BUCKET_COUNT + subBucket;
+		}
+
+		uint64_t ReceiverMetrics::getBucketUpperBound(unsigned int index)
+		{
+			if (index<SUB_BUCKET_COUNT) {
+				return index;
+			}
+
+			unsigned int exponent = (index-SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT + SUB_BUCKET_BITS;
+			uint64_t subBucket = (index-SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+			return ((SUB_BUCKET_COUNT+subBucket+1) << (exponent-SUB_BUCKET_BITS)) - 1;
+		}
+
+		void ReceiverMetrics::addLatency(latency_t latency, std::chrono::nanoseconds duration)
+		{
+			int64_t nanoseconds = duration.count();
+			if (nanoseconds<0) {
+				// clocks of different sources might not agree
+				nanoseconds = 0;
+			}
+			getShard().latencies[latency][getBucketIndex(static_cast < uint64_t > (nanoseconds))].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void ReceiverMetrics::addCallback(std::chrono::steady_clock::duration duration)
+		{
+			std::chrono::nanoseconds nanoseconds = std::chrono::duration_cast < std::chrono::nanoseconds > (duration);
+			shard_t& shard = getShard();
+			shard.counters[CALLBACKS].fetch_add(1, std::memory_order_relaxed);
+			shard.counters[CALLBACK_TIME].fetch_add(static_cast < uint64_t > (nanoseconds.count()), std::memory_order_relaxed);
+			addLatency(CALLBACK_LATENCY, nanoseconds);
+		}
+
+		ReceiverMetrics::snapshot_t ReceiverMetrics::getSnapshot() const
+		{
+			snapshot_t snapshot;
+			snapshot.time = std::chrono::steady_clock::now();
+			for (unsigned int shard = 0; shard < SHARD_COUNT; ++shard) {
+				for (unsigned int i = 0; i < COUNTER_COUNT; ++i) {
+					snapshot.counters[i] += m_shards[shard].counters[i].load(std::memory_order_relaxed);
+				}
+				for (unsigned int latency = 0; latency < LATENCY_COUNT; ++latency) {
+					for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+						snapshot.latencies[latency].buckets[i] += m_shards[shard].latencies[latency][i].load(std::memory_order_relaxed);
+					}
+				}
+			}
+			return snapshot;
+		}
+
+		std::string ReceiverMetrics::format(const snapshot_t& current, const snapshot_t& previous)
+		{
+			double seconds = std::chrono::duration_cast < std::chrono::duration < double > > (current.time-previous.time).count();
+			if (seconds<=0.0) {
+				seconds = 1.0;
+			}
+
+			uint64_t callbacks = current.counters[CALLBACKS];
+			uint64_t averageCallbackTime = 0;
+			if (callbacks>0) {
+				averageCallbackTime = current.counters[CALLBACK_TIME] / callbacks;
+			}
+
+			std::ostringstream stream;
+			stream.precision(1);
+			stream << std::fixed;
+			stream << "telegrams/s " << (current.counters[TELEGRAMS]-previous.counters[TELEGRAMS]) / seconds
+				<< " bytes/s " << (current.counters[BYTES]-previous.counters[BYTES]) / seconds
+				<< " telegrams " << current.counters[TELEGRAMS]
+				<< " new " << current.counters[NEW]
+				<< " changed " << current.counters[CHANGED]
+				<< " expired " << current.counters[EXPIRED]
+				<< " duplicates " << current.getDuplicateRatio()*100.0 << "%"
+				<< " parse failures " << current.counters[PARSE_FAILURES]
+				<< " unknown interface " << current.counters[UNKNOWN_INTERFACE]
+				<< " callbacks " << callbacks
+				<< " callback avg " << averageCallbackTime << "ns"
+				<< " p99 " << current.latencies[CALLBACK_LATENCY].getPercentile(0.99) << "ns"
+				<< " kernel drops " << current.kernelDrops
+				<< " devices " << current.deviceCount
+				<< " resident bytes " << current.residentBytes;
+			if (current.deviceCount>0) {
+				stream << " bytes/device " << current.residentBytes / current.deviceCount;
+			}
+			return stream.str();
+		}
+
+		std::string ReceiverMetrics::formatLatencies(const snapshot_t& snapshot)
+		{
+			static const char* const names[LATENCY_COUNT] = {
+				"callback",
+				"socket to parse",
+				"parse to update",
+				"update to callback return"
+			};
+
+			std::ostringstream stream;
+			for (unsigned int latency = 0; latency < LATENCY_COUNT; ++latency) {
+				const histogram_t& histogram = snapshot.latencies[latency];
+				stream << names[latency] << ": count " << histogram.getCount()
+					<< " p50 " << histogram.getPercentile(0.5) << "ns"
+					<< " p90 " << histogram.getPercentile(0.9) << "ns"
+					<< " p99 " << histogram.getPercentile(0.99) << "ns"
+					<< " p99.9 " << histogram.getPercentile(0.999) << "ns"
+					<< " max " << histogram.getPercentile(1.0) << "ns"
+					<< std::endl;
+			}
+			return stream.str();
+		}
+	}
+}
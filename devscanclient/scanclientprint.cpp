@@ -2,6 +2,7 @@
 // Distributed under MIT license
 // See file LICENSE provided
 
+#include <chrono>
 #include <iostream>
 #include <string>
 
@@ -11,8 +12,11 @@
 
 
 #include "devscan/receiver.h"
+#include "devscan/receivermetrics.h"
 
 
+static const std::chrono::milliseconds STATS_INTERVAL(10000);
+
 void announceCb(const std::string uuid, const std::string& receivingInterfaceName, const std::string& sendingInterfaceName, const std::string& router, const std::string& announcement)
 {
 
@@ -38,17 +42,32 @@ void expireCb(const std::string uuid, const std::string& receivingInterfaceName,
 	std::cout << std::endl;
 }
 
+void metricsCb(const hbm::devscan::ReceiverMetrics::snapshot_t& current, const hbm::devscan::ReceiverMetrics::snapshot_t& previous)
+{
+	std::cout << "stats: " << hbm::devscan::ReceiverMetrics::format(current, previous) << std::endl;
+	std::cout << hbm::devscan::ReceiverMetrics::formatLatencies(current) << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
-	if(argc>1) {
-		if(std::string(argv[1])=="-h") {
+	bool printStats = false;
+	for (int i=1; i<argc; ++i) {
+		std::string arg(argv[i]);
+		if(arg=="-h") {
 			std::cout << "Listens for announcements and prints new/changed announcements as received" << std::endl;
+			std::cout << "--stats: print receive statistics and latencies every " << STATS_INTERVAL.count() << "ms" << std::endl;
 			return 0;
+		} else if(arg=="--stats") {
+			printStats = true;
 		}
 	}
 
 	hbm::devscan::Receiver receiver;
 
+	if(printStats) {
+		receiver.setMetricsCb(&metricsCb, STATS_INTERVAL);
+	}
+
 	// we want to be notified about new or changed announcements
 	receiver.setAnnounceCb(&announceCb);
 
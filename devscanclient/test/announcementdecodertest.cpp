@@ -0,0 +1,162 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <string>
+
+#ifndef _WIN32
+#define BOOST_TEST_DYN_LINK
+#endif
+#define BOOST_TEST_MODULE announcementDecoderTest
+#include <boost/test/unit_test.hpp>
+
+#include <json/value.h>
+#include <json/reader.h>
+
+#include "hbm/jsonrpc/jsonrpc_defines.h"
+
+#include "devscan/announcementdecoder.h"
+#include "devscan/defines.h"
+
+
+namespace hbm {
+	namespace devscan {
+		namespace test {
+
+			static const std::string validMessage =
+				"{"
+					"\"jsonrpc\":\"2.0\","
+					"\"method\":\"announce\","
+					"\"params\":"
+					"{"
+						"\"apiVersion\":\"1.0\","
+						"\"device\":"
+						"{"
+							"\"familyType\":\"QuantumX\","
+							"\"firmwareVersion\":\"4.1.3.21715\","
+							"\"name\":\"TA02_MX440A\","
+							"\"type\":\"MX440A\","
+							"\"uuid\":\"0009E5001C49\""
+						"},"
+						"\"expiration\":15,"
+						"\"netSettings\":"
+						"{"
+							"\"defaultGateway\":{\"ipv4Address\":\"172.19.169.254\"},"
+							"\"interface\":"
+							"{"
+								"\"configurationMethod\":\"dhcp\",\"description\":\"ethernet front side\","
+								"\"ipv4\":[{\"address\":\"172.19.191.121\",\"netmask\":\"255.255.0.0\"}],"
+								"\"ipv6\":[{\"address\":\"fe80::209:e5ff:fe00:13c4\",\"prefix\":64}],"
+								"\"name\":\"eth1\","
+								"\"type\":\"ethernet\""
+							"}"
+						"},"
+						"\"router\":{\"uuid\":\"0009E50013C3\"},"
+						"\"services\":[{\"port\":50320,\"type\":\"daqStream\"},{\"port\":-1.5e3,\"type\":\"x\\u00e4\\n\"},true,false,null]"
+					"}"
+				"}"
+				"\n";
+
+			/// the decoder has to deliver the same as the complete JSON parser
+			static void checkLikeJsonReader(const std::string& message)
+			{
+				Json::Value announcement;
+				BOOST_REQUIRE(Json::Reader().parse(message, announcement));
+				const Json::Value& params = announcement[hbm::jsonrpc::PARAMS];
+
+				AnnouncementDecoder decoder;
+				BOOST_REQUIRE(decoder.decode(message.c_str(), message.length()));
+				BOOST_CHECK_EQUAL(decoder.getMethod().str(), announcement[hbm::jsonrpc::METHOD].asString());
+				BOOST_CHECK_EQUAL(decoder.getSendingInterfaceName().str(), params[TAG_NetSettings][TAG_Interface][TAG_Name].asString());
+				BOOST_CHECK_EQUAL(decoder.getUuid().str(), params[TAG_Device][TAG_Uuid].asString());
+				BOOST_CHECK_EQUAL(decoder.getRouter().str(), params[TAG_Router][TAG_Uuid].asString());
+				BOOST_CHECK_EQUAL(decoder.getExpiration(), params[TAG_Expiration].asUInt());
+			}
+
+			static bool decode(const std::string& message)
+			{
+				AnnouncementDecoder decoder;
+				return decoder.decode(message.c_str(), message.length());
+			}
+
+			BOOST_AUTO_TEST_CASE( test_case_valid )
+			{
+				checkLikeJsonReader(validMessage);
+
+				AnnouncementDecoder decoder;
+				BOOST_REQUIRE(decoder.decode(validMessage.c_str(), validMessage.length()));
+				BOOST_CHECK(decoder.getMethod().equals(TAG_Announce));
+				BOOST_CHECK_EQUAL(decoder.getSendingInterfaceName().str(), "eth1");
+				BOOST_CHECK_EQUAL(decoder.getUuid().str(), "0009E5001C49");
+				BOOST_CHECK_EQUAL(decoder.getRouter().str(), "0009E50013C3");
+				BOOST_CHECK_EQUAL(decoder.getExpiration(), 15);
+			}
+
+			BOOST_AUTO_TEST_CASE( test_case_missing_fields )
+			{
+				checkLikeJsonReader("{}");
+				checkLikeJsonReader("{\"method\":\"announce\"}");
+				checkLikeJsonReader("{\"method\":\"announce\",\"params\":null}");
+				checkLikeJsonReader("{\"method\":\"announce\",\"params\":{\"device\":{},\"router\":null,\"expiration\":null}}");
+				checkLikeJsonReader("{\"method\":\"announce\",\"params\":{\"netSettings\":{\"interface\":{\"name\":null}}}}");
+			}
+
+			/// relevant keys deeper within irrelevant objects are to be ignored
+			BOOST_AUTO_TEST_CASE( test_case_nested )
+			{
+				checkLikeJsonReader(
+					" { \"params\" : { \"other\" : { \"device\" : { \"uuid\" : \"wrong\" } } , \"device\" : { \"uuid\" : \"right\" } } ,"
+					" \"result\" : { \"method\" : \"wrong\" } , \"method\" : \"announce\" } ");
+			}
+
+			/// the complete JSON parser has to be used for anything unusual
+			BOOST_AUTO_TEST_CASE( test_case_fallback )
+			{
+				// no JSON
+				BOOST_CHECK(decode("")==false);
+				BOOST_CHECK(decode(" ")==false);
+				BOOST_CHECK(decode("This is not valid JSON")==false);
+				BOOST_CHECK(decode("[]")==false);
+				BOOST_CHECK(decode("{\"method\":\"announce\"")==false);
+				BOOST_CHECK(decode("{\"method\":\"announce\"} x")==false);
+				BOOST_CHECK(decode("{\"method\":\"announce\",}")==false);
+				BOOST_CHECK(decode("{\"a\":[1,]}")==false);
+				BOOST_CHECK(decode("{\"a\":01}")==false);
+				BOOST_CHECK(decode("{\"a\":\"\\x\"}")==false);
+				BOOST_CHECK(decode("{\"a\":1}//")==false);
+
+				// unexpected types of relevant fields
+				BOOST_CHECK(decode("{\"method\":1}")==false);
+				BOOST_CHECK(decode("{\"params\":[]}")==false);
+				BOOST_CHECK(decode("{\"params\":{\"device\":{\"uuid\":15}}}")==false);
+				BOOST_CHECK(decode("{\"params\":{\"expiration\":\"15\"}}")==false);
+				BOOST_CHECK(decode("{\"params\":{\"expiration\":15.0}}")==false);
+				BOOST_CHECK(decode("{\"params\":{\"expiration\":-15}}")==false);
+				BOOST_CHECK(decode("{\"params\":{\"expiration\":4294967296}}")==false);
+
+				// relevant fields that are to be unescaped
+				BOOST_CHECK(decode("{\"method\":\"announc\\u0065\"}")==false);
+				BOOST_CHECK(decode("{\"m\\u0065thod\":\"announce\"}")==false);
+
+				// duplicate relevant keys
+				BOOST_CHECK(decode("{\"method\":\"announce\",\"method\":\"x\"}")==false);
+
+				// escape sequences in irrelevant fields are fine
+				BOOST_CHECK(decode("{\"a\":{\"b\\\"c\":\"\\\\\\/\\b\\f\\n\\r\\t\\uABcd\"}}"));
+			}
+
+			BOOST_AUTO_TEST_CASE( test_case_depth )
+			{
+				std::string message;
+				for (unsigned int i = 0; i<1000; ++i) {
+					message += "[";
+				}
+				for (unsigned int i = 0; i<1000; ++i) {
+					message += "]";
+				}
+				BOOST_CHECK(decode("{\"a\":" + message + "}")==false);
+				BOOST_CHECK(decode("{\"a\":[[[{\"b\":[]}]]]}"));
+			}
+		}
+	}
+}
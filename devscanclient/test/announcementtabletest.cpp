@@ -0,0 +1,65 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#define BOOST_TEST_DYN_LINK
+#endif
+#define BOOST_TEST_MODULE announcementTableTest
+#include <boost/test/unit_test.hpp>
+
+#include "hbm/string/interner.h"
+
+#include "devscan/announcementtable.h"
+
+
+namespace hbm {
+	namespace devscan {
+		namespace test {
+
+			/// Test: entries stay reachable while others get erased
+			BOOST_AUTO_TEST_CASE( test_case_announcement_table )
+			{
+				static const unsigned int count = 10000;
+				hbm::string::Interner strings;
+				hbm::string::Interner::id_t receivingInterface = strings.acquire("eth_test");
+				hbm::string::Interner::id_t sendingInterface = strings.acquire("eth0");
+				hbm::string::Interner::id_t noRouter = strings.acquire("");
+				AnnouncementTable table;
+				std::vector < AnnouncementTable::entry_t > entries;
+				for (unsigned int i=0; i<count; ++i) {
+					communicationPath path(receivingInterface, sendingInterface, strings.acquire(std::to_string(i)), noRouter);
+					BOOST_CHECK_EQUAL(table.find(path), AnnouncementTable::NO_ENTRY);
+					entries.push_back(table.insert(path));
+					table.setExpiration(entries.back(), std::chrono::seconds(i));
+				}
+				BOOST_CHECK_EQUAL(table.size(), count);
+
+				for (unsigned int i=0; i<count; i+=3) {
+					table.erase(entries[i]);
+				}
+
+				for (unsigned int i=0; i<count; ++i) {
+					communicationPath path(receivingInterface, sendingInterface, strings.find(std::to_string(i)), noRouter);
+					if (i%3==0) {
+						BOOST_CHECK_EQUAL(table.find(path), AnnouncementTable::NO_ENTRY);
+					} else {
+						BOOST_CHECK_EQUAL(table.find(path), entries[i]);
+						BOOST_CHECK_EQUAL(table.getExpiration(entries[i]).count(), i);
+					}
+				}
+
+				// the same path via a router is another one
+				communicationPath routed(receivingInterface, sendingInterface, strings.find("1"), strings.acquire("router"));
+				BOOST_CHECK_EQUAL(table.find(routed), AnnouncementTable::NO_ENTRY);
+				AnnouncementTable::entry_t entry = table.insert(routed);
+				BOOST_CHECK(table.isUsed(entry));
+				BOOST_CHECK_EQUAL(table.size(), count-(count+2)/3+1);
+			}
+		}
+	}
+}
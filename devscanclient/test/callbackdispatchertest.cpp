@@ -0,0 +1,132 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#define BOOST_TEST_DYN_LINK
+#endif
+#define BOOST_TEST_MODULE callbackDispatcherTest
+#include <boost/test/unit_test.hpp>
+
+#include "devscan/callbackdispatcher.h"
+
+
+namespace hbm {
+	namespace devscan {
+		namespace test {
+
+			/// Callbacks are executed by the dispatcher thread one after the other. No need for locking.
+			struct FixtureCallbackDispatcher
+			{
+				FixtureCallbackDispatcher()
+				{
+					countAnnouncement = 0;
+					lastAnnouncedUuid = "";
+					outOfOrder = false;
+					foreignThread = false;
+					countErrors = 0;
+					lastErrorCode = 0;
+				}
+
+				static unsigned int countAnnouncement;
+				static std::string lastAnnouncedUuid;
+				/// an announcement arrived before one pushed earlier
+				static bool outOfOrder;
+				/// a callback was executed by the thread pushing the events
+				static bool foreignThread;
+				static std::thread::id pushingThread;
+
+				static void announceCbTest(const std::string& uuid, const std::string&, const std::string&, const std::string&, const std::string&)
+				{
+					if (uuid!=std::to_string(countAnnouncement)) {
+						outOfOrder = true;
+					}
+					if (std::this_thread::get_id()==pushingThread) {
+						foreignThread = true;
+					}
+					++countAnnouncement;
+					lastAnnouncedUuid = uuid;
+				}
+
+				/// takes its time
+				static void announceCbSlow(const std::string&, const std::string&, const std::string&, const std::string&, const std::string&)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+					++countAnnouncement;
+				}
+
+				static unsigned int countErrors;
+				static uint32_t lastErrorCode;
+
+				static void errorCbTest(uint32_t errorCode, const std::string&, const std::string&)
+				{
+					++countErrors;
+					lastErrorCode = errorCode;
+				}
+			};
+
+			unsigned int FixtureCallbackDispatcher::countAnnouncement;
+			std::string FixtureCallbackDispatcher::lastAnnouncedUuid;
+			bool FixtureCallbackDispatcher::outOfOrder;
+			bool FixtureCallbackDispatcher::foreignThread;
+			std::thread::id FixtureCallbackDispatcher::pushingThread;
+			unsigned int FixtureCallbackDispatcher::countErrors;
+			uint32_t FixtureCallbackDispatcher::lastErrorCode;
+
+			BOOST_FIXTURE_TEST_SUITE( CallbackDispatcher_1, FixtureCallbackDispatcher )
+
+			/// Test: callbacks executed by the dispatcher thread in the order they were pushed
+			BOOST_AUTO_TEST_CASE( test_case_dispatching )
+			{
+				static const unsigned int count = 1000;
+				pushingThread = std::this_thread::get_id();
+				{
+					CallbackDispatcher dispatcher(16, CallbackDispatcher::OVERFLOW_WAIT);
+					dispatcher.setAnnounceCb(announceCbTest);
+					dispatcher.setErrorCb(errorCbTest);
+
+					for (unsigned int dev=0; dev<count; ++dev) {
+						dispatcher.pushAnnouncement(std::to_string(dev), "eth_test", "eth0", "", "announcement");
+					}
+					dispatcher.pushError(cb_t::DATA_DROPPED | cb_t::ERROR_PARSE, "JSON parser failed", "This is not valid JSON");
+					BOOST_CHECK_EQUAL(dispatcher.getDroppedCount(), 0);
+					// waits for all callbacks to be executed
+				}
+				BOOST_CHECK_EQUAL(countAnnouncement, count);
+				BOOST_CHECK_EQUAL(lastAnnouncedUuid, std::to_string(count-1));
+				BOOST_CHECK(outOfOrder==false);
+				BOOST_CHECK(foreignThread==false);
+				BOOST_CHECK_EQUAL(countErrors, 1);
+				BOOST_CHECK_EQUAL(lastErrorCode, cb_t::DATA_DROPPED | cb_t::ERROR_PARSE);
+			}
+
+			/// Test: a slow callback makes the dispatcher drop events
+			BOOST_AUTO_TEST_CASE( test_case_dispatching_overflow )
+			{
+				static const unsigned int count = 100;
+				uint64_t droppedCount;
+				{
+					CallbackDispatcher dispatcher(2, CallbackDispatcher::OVERFLOW_DROP);
+					dispatcher.setAnnounceCb(announceCbSlow);
+					dispatcher.setErrorCb(errorCbTest);
+
+					for (unsigned int dev=0; dev<count; ++dev) {
+						dispatcher.pushAnnouncement(std::to_string(dev), "eth_test", "eth0", "", "announcement");
+					}
+					droppedCount = dispatcher.getDroppedCount();
+				}
+				BOOST_CHECK(droppedCount>0);
+				BOOST_CHECK(countAnnouncement<count);
+				BOOST_CHECK(countErrors>=1);
+				BOOST_CHECK_EQUAL(lastErrorCode, cb_t::DATA_DROPPED | cb_t::ERROR_OVERFLOW);
+			}
+
+			BOOST_AUTO_TEST_SUITE_END()
+		}
+	}
+}
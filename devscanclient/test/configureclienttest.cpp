@@ -0,0 +1,121 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#define BOOST_TEST_DYN_LINK
+#endif
+#define BOOST_TEST_MODULE configureClientTest
+#include <boost/test/unit_test.hpp>
+
+#include "hbm/communication/multicastserver.h"
+#include "hbm/communication/netadapterlist.h"
+#include "hbm/exception/exception.hpp"
+#include "hbm/sys/eventloop.h"
+
+#include "devscan/configureclient.h"
+#include "devscan/defines.h"
+
+
+namespace hbm {
+	namespace devscan {
+		namespace test {
+			/// devices do not know this method. They won't answer.
+			static const char REQUEST[] = "{\"jsonrpc\":\"2.0\",\"method\":\"configureClientTest\"}";
+
+			static unsigned int callbackCount;
+
+			static void countResponse(const std::string&)
+			{
+				++callbackCount;
+			}
+
+			/// plays the device answering a request
+			static void answer(const std::string& id)
+			{
+				sys::EventLoop eventloop;
+				communication::NetadapterList adapters;
+				communication::MulticastServer responder(adapters, eventloop);
+				// the configure client is on this host
+				responder.setMulticastLoop(true);
+				responder.start(CONFIG_IPV4_ADDRESS, CONFIG_UDP_PORT, communication::MulticastServer::DataHandler_t());
+				responder.send("{\"jsonrpc\":\"2.0\",\"id\":\"" + id + "\",\"result\":0}", 1);
+				responder.stop();
+			}
+
+			BOOST_AUTO_TEST_CASE(answer_and_timeout_test)
+			{
+				static const std::chrono::milliseconds TIMETOWAIT(500);
+
+				callbackCount = 0;
+				ConfigureClient configureClient;
+				std::future < std::string > answered = configureClient.executeRequestAsync("", 1, "configureClientTest:answered", REQUEST, TIMETOWAIT, std::bind(&countResponse, std::placeholders::_1));
+				std::future < std::string > unanswered = configureClient.executeRequestAsync("", 1, "configureClientTest:unanswered", REQUEST, TIMETOWAIT, std::bind(&countResponse, std::placeholders::_1));
+				BOOST_CHECK_EQUAL(configureClient.getOutstandingRequestCount(), 2);
+
+				// responses to requests of other clients are ignored
+				answer("configureClientTest:other");
+				answer("configureClientTest:answered");
+
+				BOOST_REQUIRE(answered.wait_for(TIMETOWAIT)==std::future_status::ready);
+				BOOST_CHECK(answered.get().find("configureClientTest:answered")!=std::string::npos);
+
+				BOOST_CHECK_EQUAL(unanswered.get(), "");
+				BOOST_CHECK_EQUAL(callbackCount, 2);
+				BOOST_CHECK_EQUAL(configureClient.getOutstandingRequestCount(), 0);
+			}
+
+			BOOST_AUTO_TEST_CASE(individual_timeout_test)
+			{
+				ConfigureClient configureClient;
+				std::future < std::string > late = configureClient.executeRequestAsync("", 1, "configureClientTest:late", REQUEST, std::chrono::milliseconds(2000));
+				std::future < std::string > early = configureClient.executeRequestAsync("", 1, "configureClientTest:early", REQUEST, std::chrono::milliseconds(100));
+
+				// the request sent later is not delayed by the one sent before
+				BOOST_REQUIRE(early.wait_for(std::chrono::milliseconds(1000))==std::future_status::ready);
+				BOOST_CHECK_EQUAL(early.get(), "");
+				BOOST_CHECK(late.wait_for(std::chrono::milliseconds(0))==std::future_status::timeout);
+				BOOST_CHECK_EQUAL(configureClient.getOutstandingRequestCount(), 1);
+			}
+
+			BOOST_AUTO_TEST_CASE(outstanding_on_destruction_test)
+			{
+				std::future < std::string > response;
+				{
+					ConfigureClient configureClient;
+					response = configureClient.executeRequestAsync("", 1, "configureClientTest:destroyed", REQUEST, std::chrono::milliseconds(10000));
+					BOOST_CHECK_THROW(configureClient.executeRequestAsync("", 1, "configureClientTest:destroyed", REQUEST, std::chrono::milliseconds(10000)), hbm::exception::exception);
+				}
+				BOOST_REQUIRE(response.wait_for(std::chrono::milliseconds(0))==std::future_status::ready);
+				BOOST_CHECK_EQUAL(response.get(), "");
+			}
+
+			BOOST_AUTO_TEST_CASE(many_requests_test)
+			{
+				static const unsigned int REQUEST_COUNT = 500;
+
+				callbackCount = 0;
+				ConfigureClient configureClient;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				std::vector < std::future < std::string > > responses;
+				for (unsigned int i = 0; i < REQUEST_COUNT; ++i) {
+					responses.push_back(configureClient.setDefaultGatewayAsync("", 1, "configureClientTest", "0.0.0.0", std::bind(&countResponse, std::placeholders::_1)));
+				}
+				for (unsigned int i = 0; i < REQUEST_COUNT; ++i) {
+					BOOST_CHECK_EQUAL(responses[i].get(), "");
+				}
+
+				// all requests were waiting at the same time
+				BOOST_CHECK_LT(std::chrono::duration_cast < std::chrono::milliseconds > (std::chrono::steady_clock::now()-start).count(), 10000);
+				BOOST_CHECK_EQUAL(callbackCount, REQUEST_COUNT);
+			}
+		}
+	}
+}
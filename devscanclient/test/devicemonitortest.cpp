@@ -314,6 +314,30 @@ namespace hbm {
 				}
 			}
 
+			/// Test: process announcements directly from a receive buffer.
+			/// Only messageLength bytes are to be evaluated, anything behind belongs to somebody else.
+			BOOST_AUTO_TEST_CASE( test_case_receive_buffer )
+			{
+				m_deviceMonitor.setAnnounceCb(announceCbTest);
+
+				std::string receiveBuffer = validMessage + "garbage behind the message";
+				m_deviceMonitor.processReceivedAnnouncement("eth9", receiveBuffer.c_str(), validMessage.length());
+				BOOST_CHECK_EQUAL(countAnnouncement, 1);
+				BOOST_CHECK_EQUAL(lastAnnouncement, validMessage);
+
+				// same content in a different buffer is no change
+				receiveBuffer = validMessage + "other garbage";
+				m_deviceMonitor.processReceivedAnnouncement("eth9", receiveBuffer.c_str(), validMessage.length());
+				BOOST_CHECK_EQUAL(countAnnouncement, 1);
+
+				// a changed announcement of the same length is recognized
+				std::string changedMessage = validMessage;
+				changedMessage.replace(changedMessage.find("TA02_MX440A"), 11, "TA03_MX440A");
+				m_deviceMonitor.processReceivedAnnouncement("eth9", changedMessage.c_str(), changedMessage.length());
+				BOOST_CHECK_EQUAL(countAnnouncement, 2);
+				BOOST_CHECK_EQUAL(lastAnnouncement, changedMessage);
+			}
+
 			/// Test: some uncommon or broken interface names
 			BOOST_AUTO_TEST_CASE( test_case_invalid_interface )
 			{
@@ -357,6 +381,26 @@ namespace hbm {
 				BOOST_CHECK_EQUAL(countErrors, 0);
 			}
 
+			/// Test: interface names containing ':' do not lead to ambiguous communication paths
+			BOOST_AUTO_TEST_CASE( test_case_colon_in_interface_name )
+			{
+				m_deviceMonitor.setAnnounceCb(announceCbTest);
+				m_deviceMonitor.setExpireCb(expireCbTest);
+
+				// receiving "a", sending "b:c"
+				m_deviceMonitor.processReceivedAnnouncement("a", getJsonAnnouncementString(1, "0009E5111111", "b:c"));
+				BOOST_CHECK_EQUAL(countAnnouncement, 1);
+				// receiving "a:b", sending "c"
+				m_deviceMonitor.processReceivedAnnouncement("a:b", getJsonAnnouncementString(1, "0009E5111111", "c"));
+				BOOST_CHECK_EQUAL(countAnnouncement, 2);
+				BOOST_CHECK_EQUAL(lastReceivingInterfaceName, "a:b");
+
+				sleep(2);
+				m_deviceMonitor.checkForExpiredAnnouncements();
+				BOOST_CHECK_EQUAL(countExpiration, 2);
+				BOOST_CHECK_EQUAL(lastExpiredUuid, "0009E5111111");
+			}
+
 			/// Test: some broken JSON messages: No JSON at all
 			BOOST_AUTO_TEST_CASE( test_case_no_json )
 			{
@@ -549,6 +593,155 @@ namespace hbm {
 			}
 
 
+			/// Test: expiration of many announcements with different expiration times
+			BOOST_AUTO_TEST_CASE( test_case_expire_many )
+			{
+				m_deviceMonitor.setExpireCb(expireCbTest);
+
+				static const unsigned int count = 1000;
+				for (unsigned int dev=0; dev<count; ++dev) {
+					// alternating expiration times of 1 and 3 seconds
+					unsigned int expiration = 1 + (dev%2)*2;
+					m_deviceMonitor.processReceivedAnnouncement("eth_test", getJsonAnnouncementString(expiration, std::to_string(dev).c_str(), "eth0"));
+				}
+
+				m_deviceMonitor.checkForExpiredAnnouncements();
+				BOOST_CHECK_EQUAL(countExpiration, 0);
+
+				sleep(2);
+				m_deviceMonitor.checkForExpiredAnnouncements();
+				BOOST_CHECK_EQUAL(countExpiration, count/2);
+
+				sleep(2);
+				m_deviceMonitor.checkForExpiredAnnouncements();
+				BOOST_CHECK_EQUAL(countExpiration, count);
+			}
+
+			/// Test: repeated announcements refresh the time of expiry
+			BOOST_AUTO_TEST_CASE( test_case_refresh )
+			{
+				m_deviceMonitor.setAnnounceCb(announceCbTest);
+				m_deviceMonitor.setExpireCb(expireCbTest);
+
+				std::string message = getJsonAnnouncementString(2, "to_be_refreshed", "eth0");
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", message);
+				BOOST_CHECK_EQUAL(countAnnouncement, 1);
+
+				// the same announcement received on another interface is another one
+				m_deviceMonitor.processReceivedAnnouncement("eth_other", message);
+				BOOST_CHECK_EQUAL(countAnnouncement, 2);
+
+				for (unsigned int i=0; i<3; ++i) {
+					usleep(1000*1000);
+					m_deviceMonitor.processReceivedAnnouncement("eth_test", message);
+					m_deviceMonitor.checkForExpiredAnnouncements();
+				}
+				BOOST_CHECK_EQUAL(countAnnouncement, 2);
+				// only the one received on the other interface did expire
+				BOOST_CHECK_EQUAL(countExpiration, 1);
+
+				sleep(3);
+				m_deviceMonitor.checkForExpiredAnnouncements();
+				BOOST_CHECK_EQUAL(countExpiration, 2);
+
+				// after expiry, it is a new announcement again
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", message);
+				BOOST_CHECK_EQUAL(countAnnouncement, 3);
+			}
+
+			/// Test: receiving interfaces identified by id are the same as those identified by name
+			BOOST_AUTO_TEST_CASE( test_case_interface_id )
+			{
+				m_deviceMonitor.setAnnounceCb(announceCbTest);
+				m_deviceMonitor.setExpireCb(expireCbTest);
+
+				hbm::string::Interner::id_t interfaceId = m_deviceMonitor.acquireInterfaceId("eth_test");
+				std::string message = getJsonAnnouncementString(1, "by_id", "eth0");
+				m_deviceMonitor.processReceivedAnnouncement(interfaceId, message.c_str(), message.length());
+				BOOST_CHECK_EQUAL(countAnnouncement, 1);
+				BOOST_CHECK_EQUAL(lastAnnouncedUuid, "by_id");
+				BOOST_CHECK_EQUAL(lastReceivingInterfaceName, "eth_test");
+
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", message);
+				BOOST_CHECK_EQUAL(countAnnouncement, 1);
+
+				// the id stays valid after the announcement expired
+				sleep(2);
+				m_deviceMonitor.checkForExpiredAnnouncements();
+				BOOST_CHECK_EQUAL(countExpiration, 1);
+				m_deviceMonitor.processReceivedAnnouncement(interfaceId, message.c_str(), message.length());
+				BOOST_CHECK_EQUAL(countAnnouncement, 2);
+				BOOST_CHECK_EQUAL(lastReceivingInterfaceName, "eth_test");
+				m_deviceMonitor.releaseInterfaceId(interfaceId);
+
+				// the path keeps its own reference
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", message);
+				BOOST_CHECK_EQUAL(countAnnouncement, 2);
+			}
+
+			/// Test: processing of announcements is counted
+			BOOST_AUTO_TEST_CASE( test_case_metrics )
+			{
+				ReceiverMetrics metrics;
+				m_deviceMonitor.setMetrics(&metrics);
+				m_deviceMonitor.setAnnounceCb(announceCbTest);
+				m_deviceMonitor.setExpireCb(expireCbTest);
+
+				std::string message = getJsonAnnouncementString(1, "to_be_counted", "eth0");
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", message);
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", message);
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", message);
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", getJsonAnnouncementString(1, "to_be_counted", "eth1"));
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", "This is not valid JSON");
+
+				sleep(2);
+				m_deviceMonitor.checkForExpiredAnnouncements();
+
+				ReceiverMetrics::snapshot_t snapshot = metrics.getSnapshot();
+				BOOST_CHECK_EQUAL(snapshot.counters[ReceiverMetrics::NEW], 2);
+				BOOST_CHECK_EQUAL(snapshot.counters[ReceiverMetrics::CHANGED], 0);
+				BOOST_CHECK_EQUAL(snapshot.counters[ReceiverMetrics::REPEATED], 2);
+				BOOST_CHECK_EQUAL(snapshot.counters[ReceiverMetrics::PARSE_FAILURES], 1);
+				BOOST_CHECK_EQUAL(snapshot.counters[ReceiverMetrics::EXPIRED], 2);
+				BOOST_CHECK_EQUAL(snapshot.counters[ReceiverMetrics::CALLBACKS], 4);
+				BOOST_CHECK_EQUAL(snapshot.getDuplicateRatio(), 0.5);
+				BOOST_CHECK(snapshot.latencies[ReceiverMetrics::CALLBACK_LATENCY].getPercentile(1.0)>0);
+				BOOST_CHECK_EQUAL(snapshot.latencies[ReceiverMetrics::CALLBACK_LATENCY].getCount(), 4);
+				// repeated, new and changed ones
+				BOOST_CHECK_EQUAL(snapshot.latencies[ReceiverMetrics::PARSE_TO_UPDATE].getCount(), 4);
+				// callbacks for new and changed ones only
+				BOOST_CHECK_EQUAL(snapshot.latencies[ReceiverMetrics::UPDATE_TO_CALLBACK_RETURN].getCount(), 2);
+				// time of arrival is unknown
+				BOOST_CHECK_EQUAL(snapshot.latencies[ReceiverMetrics::RECEIVE_TO_PARSE].getCount(), 0);
+
+				m_deviceMonitor.setMetrics(NULL);
+				m_deviceMonitor.processReceivedAnnouncement("eth_test", message);
+				BOOST_CHECK_EQUAL(metrics.getSnapshot().counters[ReceiverMetrics::NEW], 2);
+			}
+
+			/// Test: memory used stays bounded while announcements keep changing
+			BOOST_AUTO_TEST_CASE( test_case_memory_usage )
+			{
+				static const unsigned int count = 1000;
+				DeviceMonitor::memoryUsage_t firstUsage;
+				for (unsigned int round=0; round<20; ++round) {
+					// another expiration time changes each announcement
+					for (unsigned int dev=0; dev<count; ++dev) {
+						m_deviceMonitor.processReceivedAnnouncement("eth_test", getJsonAnnouncementString(15+round, std::to_string(dev).c_str(), "eth0"));
+					}
+					if (round==0) {
+						firstUsage = m_deviceMonitor.getMemoryUsage();
+					}
+				}
+
+				DeviceMonitor::memoryUsage_t usage = m_deviceMonitor.getMemoryUsage();
+				BOOST_CHECK_EQUAL(usage.deviceCount, count);
+				BOOST_CHECK(usage.getBytesPerDevice()>0);
+				// no new nodes for changed announcements. Garbage in the arena is limited by compaction.
+				BOOST_CHECK_EQUAL(usage.nodeBytes, firstUsage.nodeBytes);
+				BOOST_CHECK(usage.payloadBytes<=2*firstUsage.payloadBytes);
+			}
+
 			/// Test: exceptions in user-provided callback-functions
 			BOOST_AUTO_TEST_CASE( test_callback_throws )
 			{
@@ -0,0 +1,57 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+
+#ifndef LOOPBACKANNOUNCER_H
+#define LOOPBACKANNOUNCER_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "hbm/communication/multicastserver.h"
+#include "hbm/communication/netadapterlist.h"
+#include "hbm/sys/eventloop.h"
+
+#include "devscan/defines.h"
+
+namespace hbm {
+	namespace devscan {
+		namespace test {
+			/// Devices announcing on the network do not use uuids starting with uuidPrefix.
+			/// Each test uses its own prefix.
+			inline bool isTestUuid(const std::string& uuid, const std::string& uuidPrefix)
+			{
+				return uuid.compare(0, uuidPrefix.size(), uuidPrefix)==0;
+			}
+
+			/// receivers join the multicast group on start. Call this before announcing.
+			inline void waitForJoin()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			}
+
+			/// sends deviceCount announcements via each interface. Those are looped back to this host.
+			/// \param uuidPrefix the uuids are made of this and the device number
+			inline void announceLoopback(const std::string& uuidPrefix, unsigned int deviceCount)
+			{
+				communication::NetadapterList adapters;
+				sys::EventLoop eventloop;
+				communication::MulticastServer announcer(adapters, eventloop);
+				announcer.setMulticastLoop(true);
+				announcer.start(ANNOUNCE_IPV4_ADDRESS, ANNOUNCE_UDP_PORT, communication::MulticastServer::DataHandler_t());
+				for (unsigned int device = 0; device < deviceCount; ++device) {
+					char announcement[256];
+					snprintf(announcement, sizeof(announcement),
+						"{\"jsonrpc\":\"2.0\",\"method\":\"announce\",\"params\":{\"device\":{\"uuid\":\"%s%04X\"},\"expiration\":15,\"netSettings\":{\"interface\":{\"name\":\"eth0\"}}}}",
+						uuidPrefix.c_str(), device);
+					announcer.send(std::string(announcement), 1);
+				}
+				announcer.stop();
+			}
+		}
+	}
+}
+#endif // LOOPBACKANNOUNCER_H
@@ -0,0 +1,124 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#define BOOST_TEST_DYN_LINK
+#endif
+#define BOOST_TEST_MODULE parallelReceiverTest
+#include <boost/test/unit_test.hpp>
+
+#include "hbm/communication/netadapterlist.h"
+
+#include "devscan/parallelreceiver.h"
+
+#include "loopbackannouncer.h"
+
+
+namespace hbm {
+	namespace devscan {
+		namespace test {
+			static const unsigned int WORKER_COUNT = 2;
+			static const unsigned int DEVICE_COUNT = 100;
+
+			/// see isTestUuid()
+			static const char UUID_PREFIX[] = "0009E5FE";
+
+			/// number of reports by communication path (uuid and receiving interface)
+			typedef std::map < std::string, unsigned int > reports_t;
+			/// the threads reporting by receiving interface
+			typedef std::map < std::string, std::set < std::thread::id > > reportingThreads_t;
+
+			static std::mutex reportsMtx;
+			static reports_t reports;
+			static reportingThreads_t reportingThreads;
+
+			static std::atomic < unsigned int > callbacksInProgress(0);
+			static std::atomic < unsigned int > overlappingCallbacks(0);
+
+			static void announceCb(const std::string& uuid, const std::string& receivingInterfaceName, const std::string&, const std::string&, const std::string&)
+			{
+				if (++callbacksInProgress>1) {
+					++overlappingCallbacks;
+				}
+
+				if (isTestUuid(uuid, UUID_PREFIX)) {
+					std::lock_guard < std::mutex > lock(reportsMtx);
+					++reports[uuid + "@" + receivingInterfaceName];
+					reportingThreads[receivingInterfaceName].insert(std::this_thread::get_id());
+				}
+
+				// gives other workers the chance to call at the same time
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+				--callbacksInProgress;
+			}
+
+			static void receive(ParallelReceiver* pReceiver)
+			{
+				pReceiver->start();
+			}
+
+			static size_t getReportCount()
+			{
+				std::lock_guard < std::mutex > lock(reportsMtx);
+				return reports.size();
+			}
+
+			BOOST_AUTO_TEST_CASE(each_announcement_once_test)
+			{
+				// the datagrams sent via each interface are looped back to this host
+				size_t interfaceCount = 0;
+				communication::NetadapterList adapters;
+				communication::NetadapterList::tAdaptersPtr pAdapters = adapters.getAdapters();
+				for (communication::NetadapterList::tAdapters::const_iterator iter = pAdapters->begin(); iter != pAdapters->end(); ++iter) {
+					if (iter->second.getIpv4Addresses().empty()==false) {
+						++interfaceCount;
+					}
+				}
+				BOOST_REQUIRE_MESSAGE(interfaceCount>0, "no interface with IPv4 address to send announcements over");
+
+				ParallelReceiver receiver(WORKER_COUNT);
+				BOOST_CHECK_EQUAL(receiver.getWorkerCount(), WORKER_COUNT);
+				receiver.setAnnounceCb(std::bind(&announceCb, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+				std::thread receiverThread(&receive, &receiver);
+				waitForJoin();
+
+				announceLoopback(UUID_PREFIX, DEVICE_COUNT);
+
+				std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+				while ((getReportCount()<DEVICE_COUNT*interfaceCount) && (std::chrono::steady_clock::now()<deadline)) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				}
+				// late duplicates would arrive meanwhile
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+				receiver.stop();
+				receiverThread.join();
+
+				BOOST_CHECK_EQUAL(reports.size(), DEVICE_COUNT*interfaceCount);
+				for (reports_t::const_iterator iter = reports.begin(); iter != reports.end(); ++iter) {
+					BOOST_CHECK_MESSAGE(iter->second==1, iter->first << " reported " << iter->second << " times");
+				}
+
+				// each interface is served by exactly one worker
+				BOOST_CHECK_EQUAL(reportingThreads.size(), interfaceCount);
+				std::set < std::thread::id > workerThreads;
+				for (reportingThreads_t::const_iterator iter = reportingThreads.begin(); iter != reportingThreads.end(); ++iter) {
+					BOOST_CHECK_MESSAGE(iter->second.size()==1, iter->first << " reported by " << iter->second.size() << " workers");
+					workerThreads.insert(iter->second.begin(), iter->second.end());
+				}
+				BOOST_CHECK_LE(workerThreads.size(), WORKER_COUNT);
+
+				BOOST_CHECK_EQUAL(overlappingCallbacks, 0);
+			}
+		}
+	}
+}
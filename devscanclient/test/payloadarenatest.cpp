@@ -0,0 +1,53 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#define BOOST_TEST_DYN_LINK
+#endif
+#define BOOST_TEST_MODULE payloadArenaTest
+#include <boost/test/unit_test.hpp>
+
+#include "devscan/payloadarena.h"
+
+
+namespace hbm {
+	namespace devscan {
+		namespace test {
+
+			/// Test: payloads stay intact while the arena gets compacted
+			BOOST_AUTO_TEST_CASE( test_case_payload_arena )
+			{
+				PayloadArena arena;
+				std::vector < PayloadArena::handle_t > handles;
+				static const unsigned int count = 10000;
+				for (unsigned int i=0; i<count; ++i) {
+					std::string payload = "payload number " + std::to_string(i);
+					handles.push_back(arena.store(payload.c_str(), payload.length()));
+				}
+				size_t residentBytes = arena.getResidentBytes();
+
+				// release all but each 10th. Compaction is triggered on the way.
+				for (unsigned int i=0; i<count; ++i) {
+					if (i%10) {
+						arena.release(handles[i]);
+					}
+				}
+				BOOST_CHECK(arena.getResidentBytes()<residentBytes);
+
+				for (unsigned int i=0; i<count; i+=10) {
+					std::string payload = "payload number " + std::to_string(i);
+					BOOST_CHECK(arena.equals(handles[i], payload.c_str(), payload.length()));
+				}
+
+				// handles get reused
+				PayloadArena::handle_t handle = arena.store("x", 1);
+				BOOST_CHECK(handle<count);
+				BOOST_CHECK_EQUAL(std::string(arena.getData(handle), arena.getLength(handle)), "x");
+			}
+		}
+	}
+}
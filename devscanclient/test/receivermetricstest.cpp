@@ -0,0 +1,39 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <stdint.h>
+
+#ifndef _WIN32
+#define BOOST_TEST_DYN_LINK
+#endif
+#define BOOST_TEST_MODULE receiverMetricsTest
+#include <boost/test/unit_test.hpp>
+
+#include "devscan/receivermetrics.h"
+
+
+namespace hbm {
+	namespace devscan {
+		namespace test {
+
+			/// Test: latency histogram buckets
+			BOOST_AUTO_TEST_CASE( test_case_latency_buckets )
+			{
+				uint64_t values[] = { 0, 1, 15, 16, 17, 31, 32, 33, 1000, 999999, 1000000, 123456789 };
+				for (unsigned int i=0; i<sizeof(values)/sizeof(values[0]); ++i) {
+					uint64_t value = values[i];
+					unsigned int index = ReceiverMetrics::getBucketIndex(value);
+					BOOST_CHECK(ReceiverMetrics::getBucketUpperBound(index)>=value);
+					// relative error is limited by the number of sub buckets
+					BOOST_CHECK(ReceiverMetrics::getBucketUpperBound(index)-value <= value/ReceiverMetrics::SUB_BUCKET_COUNT);
+					if (index>0) {
+						BOOST_CHECK(ReceiverMetrics::getBucketUpperBound(index-1)<value);
+					}
+				}
+				// anything too large ends up in the last bucket
+				BOOST_CHECK_EQUAL(ReceiverMetrics::getBucketIndex(1ULL<<62), ReceiverMetrics::LATENCY_BUCKET_COUNT-1);
+			}
+		}
+	}
+}
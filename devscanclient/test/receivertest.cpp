@@ -0,0 +1,154 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#define BOOST_TEST_DYN_LINK
+#endif
+#define BOOST_TEST_MODULE receiverTest
+#include <boost/test/unit_test.hpp>
+
+#include "devscan/receiver.h"
+
+#include "loopbackannouncer.h"
+
+
+namespace hbm {
+	namespace devscan {
+		namespace test {
+			static const unsigned int DEVICE_COUNT = 20;
+
+			/// see isTestUuid()
+			static const char UUID_PREFIX[] = "0009E5FD";
+
+			static std::atomic < unsigned int > announcementCount(0);
+
+			static void receive(Receiver* pReceiver)
+			{
+				pReceiver->start();
+			}
+
+			/// \return false if less than DEVICE_COUNT announcements were reported in time
+			static bool waitForAnnouncements()
+			{
+				std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+				while (announcementCount<DEVICE_COUNT) {
+					if (std::chrono::steady_clock::now()>=deadline) {
+						return false;
+					}
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				}
+				return true;
+			}
+
+			static void reentrantAnnounceCb(Receiver* pReceiver, const std::string& uuid)
+			{
+				if (isTestUuid(uuid, UUID_PREFIX)==false) {
+					return;
+				}
+				// none of these may block while the callback is being executed
+				pReceiver->getMetrics();
+				pReceiver->setExpireCb(expireCb_t());
+				pReceiver->setErrorCb(errorCb_t());
+				++announcementCount;
+			}
+
+			BOOST_AUTO_TEST_CASE(callback_calls_receiver_test)
+			{
+				announcementCount = 0;
+				Receiver receiver;
+				receiver.setAnnounceCb(std::bind(&reentrantAnnounceCb, &receiver, std::placeholders::_1));
+				std::thread receiverThread(&receive, &receiver);
+				waitForJoin();
+
+				announceLoopback(UUID_PREFIX, DEVICE_COUNT);
+				BOOST_CHECK(waitForAnnouncements());
+
+				// the known announcements are reported again to the new callback by this thread
+				announcementCount = 0;
+				receiver.setAnnounceCb(std::bind(&reentrantAnnounceCb, &receiver, std::placeholders::_1));
+				BOOST_CHECK_EQUAL(announcementCount, DEVICE_COUNT);
+
+				receiver.stop();
+				receiverThread.join();
+			}
+
+			static void slowAnnounceCb(Receiver* pReceiver, const std::string& uuid)
+			{
+				if (isTestUuid(uuid, UUID_PREFIX)==false) {
+					return;
+				}
+				// keeps the queue full while the receiving thread waits for room
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				pReceiver->getMetrics();
+				++announcementCount;
+			}
+
+			BOOST_AUTO_TEST_CASE(dispatched_callback_calls_receiver_test)
+			{
+				announcementCount = 0;
+				Receiver receiver;
+				receiver.startDispatching(2, CallbackDispatcher::OVERFLOW_WAIT);
+				receiver.setAnnounceCb(std::bind(&slowAnnounceCb, &receiver, std::placeholders::_1));
+				std::thread receiverThread(&receive, &receiver);
+				waitForJoin();
+
+				announceLoopback(UUID_PREFIX, DEVICE_COUNT);
+				// the dispatcher stops while callbacks are still pending. Those call getMetrics().
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				receiver.stopDispatching();
+				BOOST_CHECK(waitForAnnouncements());
+
+				receiver.stop();
+				receiverThread.join();
+			}
+
+			static const std::chrono::milliseconds SLOW_CALLBACK(20);
+
+			static void sleepingAnnounceCb(const std::string& uuid)
+			{
+				if (isTestUuid(uuid, UUID_PREFIX)==false) {
+					return;
+				}
+				std::this_thread::sleep_for(SLOW_CALLBACK);
+				++announcementCount;
+			}
+
+			BOOST_AUTO_TEST_CASE(callback_latency_test)
+			{
+				uint64_t slow = static_cast < uint64_t > (std::chrono::duration_cast < std::chrono::nanoseconds > (SLOW_CALLBACK).count());
+
+				// callbacks executed directly and by the dispatcher
+				for (unsigned int dispatching = 0; dispatching < 2; ++dispatching) {
+					announcementCount = 0;
+					Receiver receiver;
+					if (dispatching) {
+						receiver.startDispatching(16, CallbackDispatcher::OVERFLOW_WAIT);
+					}
+					receiver.setAnnounceCb(std::bind(&sleepingAnnounceCb, std::placeholders::_1));
+					std::thread receiverThread(&receive, &receiver);
+					waitForJoin();
+
+					announceLoopback(UUID_PREFIX, DEVICE_COUNT);
+					BOOST_CHECK(waitForAnnouncements());
+
+					// all callbacks returned
+					receiver.stopDispatching();
+					receiver.stop();
+					receiverThread.join();
+
+					ReceiverMetrics::snapshot_t snapshot = receiver.getMetrics();
+					BOOST_CHECK(snapshot.counters[ReceiverMetrics::CALLBACKS]>=DEVICE_COUNT);
+					BOOST_CHECK(snapshot.counters[ReceiverMetrics::CALLBACK_TIME]>=DEVICE_COUNT*slow);
+					BOOST_CHECK(snapshot.latencies[ReceiverMetrics::CALLBACK_LATENCY].getPercentile(0.5)>=slow);
+					BOOST_CHECK(snapshot.latencies[ReceiverMetrics::UPDATE_TO_CALLBACK_RETURN].getPercentile(0.5)>=slow);
+				}
+			}
+		}
+	}
+}
@@ -14,12 +14,17 @@
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 
+#include <net/if.h>
 #include <syslog.h>
 #include <stdint.h>
+#include <errno.h>
 
 #include <unistd.h>
 
+#include <chrono>
 #include <cstring>
+#include <functional>
+#include <string>
 
 #include "hbm/communication/netlink.h"
 #include "hbm/exception/exception.hpp"
@@ -32,6 +37,11 @@ namespace hbm {
 		: m_fd(socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK, NETLINK_ROUTE))
 		, m_netadapterlist(netadapterlist)
 		, m_eventloop(eventLoop)
+		, m_eventHandler()
+		, m_debounceTimer(eventLoop)
+		, m_debounceTime(DEFAULT_DEBOUNCE_TIME)
+		, m_changePending(false)
+		, m_resyncPending(false)
 	{
 		if (m_fd<0) {
 			throw hbm::exception::exception("could not open netlink socket");
@@ -70,7 +80,90 @@ namespace hbm {
 		return ::recvmsg(m_fd, &msg, 0);
 	}
 
-	void Netlink::processNetlinkTelegram(void *pReadBuffer, size_t bufferSize) const
+	/// \return netmask in dotted decimal notation
+	static std::string prefixToNetmask(unsigned int prefix)
+	{
+		struct in_addr netmask;
+		netmask.s_addr = 0;
+		if (prefix>0) {
+			netmask.s_addr = htonl(0xffffffff << (32-prefix));
+		}
+		char buffer[INET_ADDRSTRLEN];
+		return inet_ntop(AF_INET, &netmask, buffer, sizeof(buffer));
+	}
+
+	void Netlink::processLinkMessage(const struct nlmsghdr* pHeader)
+	{
+		const struct ifinfomsg* pIfinfomsg = reinterpret_cast < const struct ifinfomsg* > (NLMSG_DATA(pHeader));
+		if (pHeader->nlmsg_type==RTM_DELLINK) {
+			m_netadapterlist.removeAdapter(pIfinfomsg->ifi_index);
+			return;
+		}
+
+		std::string name;
+		const struct rtattr *rth = IFLA_RTA(pIfinfomsg);
+		int rtl = IFLA_PAYLOAD(pHeader);
+		while (rtl && RTA_OK(rth, rtl)) {
+			if (rth->rta_type == IFLA_IFNAME) {
+				name = reinterpret_cast < const char* > (RTA_DATA(rth));
+			}
+			rth = RTA_NEXT(rth, rtl);
+		}
+
+		// the same interfaces as enumerated by NetadapterList
+		bool usable = (pIfinfomsg->ifi_flags & IFF_UP) && (pIfinfomsg->ifi_flags & IFF_BROADCAST) && !(pIfinfomsg->ifi_flags & IFF_LOOPBACK);
+		if (m_netadapterlist.updateAdapter(pIfinfomsg->ifi_index, name, usable)==false) {
+			// the interface came up. Its addresses and its hardware address are not part of the message.
+			// The complete enumeration is done once when the burst of events is over.
+			scheduleChange(true);
+		}
+	}
+
+	void Netlink::processAddressMessage(const struct nlmsghdr* pHeader) const
+	{
+		const struct ifaddrmsg* pIfaddrmsg = reinterpret_cast < const struct ifaddrmsg* > (NLMSG_DATA(pHeader));
+		const struct rtattr *rth = IFA_RTA(pIfaddrmsg);
+		int rtl = IFA_PAYLOAD(pHeader);
+		char buffer[INET6_ADDRSTRLEN];
+
+		if (pIfaddrmsg->ifa_family==AF_INET6) {
+			while (rtl && RTA_OK(rth, rtl)) {
+				if (rth->rta_type == IFA_ADDRESS) {
+					communication::ipv6Address_t address;
+					address.address = inet_ntop(AF_INET6, RTA_DATA(rth), buffer, sizeof(buffer));
+					address.prefix = pIfaddrmsg->ifa_prefixlen;
+					if (pHeader->nlmsg_type==RTM_NEWADDR) {
+						m_netadapterlist.addIpv6Address(pIfaddrmsg->ifa_index, address);
+					} else {
+						m_netadapterlist.removeIpv6Address(pIfaddrmsg->ifa_index, address.address);
+					}
+				}
+				rth = RTA_NEXT(rth, rtl);
+			}
+			return;
+		}
+
+		if (pIfaddrmsg->ifa_family!=AF_INET) {
+			return;
+		}
+
+		while (rtl && RTA_OK(rth, rtl)) {
+			if (rth->rta_type == IFA_LOCAL) {
+				communication::ipv4Address_t address;
+				address.address = inet_ntop(AF_INET, RTA_DATA(rth), buffer, sizeof(buffer));
+				address.netmask = prefixToNetmask(pIfaddrmsg->ifa_prefixlen);
+
+				if (pHeader->nlmsg_type==RTM_NEWADDR) {
+					m_netadapterlist.addIpv4Address(pIfaddrmsg->ifa_index, address);
+				} else {
+					m_netadapterlist.removeIpv4Address(pIfaddrmsg->ifa_index, address.address);
+				}
+			}
+			rth = RTA_NEXT(rth, rtl);
+		}
+	}
+
+	void Netlink::processNetlinkTelegram(void *pReadBuffer, size_t bufferSize)
 	{
 		for (struct nlmsghdr *nh = reinterpret_cast <struct nlmsghdr *> (pReadBuffer); NLMSG_OK (nh, bufferSize); nh = NLMSG_NEXT (nh, bufferSize)) {
 			if (nh->nlmsg_type == NLMSG_DONE) {
@@ -80,58 +173,15 @@ namespace hbm {
 				::syslog(LOG_ERR, "error processing netlink events");
 				break;
 			} else {
-				m_netadapterlist.update();
+				// changes are applied to the netadapter list directly. There is no complete enumeration per message.
 				switch(nh->nlmsg_type) {
-				case RTM_NEWADDR:
-					{
-						struct ifaddrmsg* pIfaddrmsg = reinterpret_cast <struct ifaddrmsg*> (NLMSG_DATA(nh));
-						if(pIfaddrmsg->ifa_family==AF_INET) {
-							struct rtattr *rth = IFA_RTA(pIfaddrmsg);
-							int rtl = IFA_PAYLOAD(nh);
-							while (rtl && RTA_OK(rth, rtl)) {
-								if (rth->rta_type == IFA_LOCAL) {
-									// this is to be ignored if there are more than one ipv4 addresses assigned to the interface!
-									try {
-										communication::Netadapter adapter = m_netadapterlist.getAdapterByInterfaceIndex(pIfaddrmsg->ifa_index);
-										if(adapter.getIpv4Addresses().size()==1) {
-											if (m_eventHandler) {
-												struct in_addr* pIn = reinterpret_cast < struct in_addr* > (RTA_DATA(rth));
-												m_eventHandler(NEW, pIfaddrmsg->ifa_index, inet_ntoa(*pIn));
-											}
-										}
-									} catch(const hbm::exception::exception&) {
-									}
-								}
-								rth = RTA_NEXT(rth, rtl);
-							}
-						}
-					}
+				case RTM_NEWLINK:
+				case RTM_DELLINK:
+					processLinkMessage(nh);
 					break;
+				case RTM_NEWADDR:
 				case RTM_DELADDR:
-					{
-						struct ifaddrmsg* pIfaddrmsg = reinterpret_cast <struct ifaddrmsg*> (NLMSG_DATA(nh));
-						if(pIfaddrmsg->ifa_family==AF_INET) {
-							struct rtattr *rth = IFA_RTA(pIfaddrmsg);
-							int rtl = IFA_PAYLOAD(nh);
-							while (rtl && RTA_OK(rth, rtl)) {
-								if (rth->rta_type == IFA_LOCAL) {
-
-									// this is to be ignored if there is another ipv4 address left for the interface!
-									try {
-										communication::Netadapter adapter = m_netadapterlist.getAdapterByInterfaceIndex(pIfaddrmsg->ifa_index);
-										if(adapter.getIpv4Addresses().empty()==true) {
-											if (m_eventHandler) {
-												struct in_addr* pIn = reinterpret_cast < struct in_addr* > (RTA_DATA(rth));
-												m_eventHandler(NEW, pIfaddrmsg->ifa_index, inet_ntoa(*pIn));
-											}
-										}
-									} catch(const hbm::exception::exception&) {
-									}
-								}
-								rth = RTA_NEXT(rth, rtl);
-							}
-						}
-					}
+					processAddressMessage(nh);
 					break;
 				default:
 					break;
@@ -145,17 +195,26 @@ namespace hbm {
 		uint8_t readBuffer[MAX_DATAGRAM_SIZE];
 		ssize_t nBytes = receive(readBuffer, sizeof(readBuffer));
 		if (nBytes>0) {
+			uint64_t generation = m_netadapterlist.getGeneration();
 			processNetlinkTelegram(readBuffer, nBytes);
+			if (m_netadapterlist.getGeneration()!=generation) {
+				scheduleChange(false);
+			}
+		} else if ((nBytes<0) && (errno==ENOBUFS)) {
+			// the socket buffer did overflow. Events got lost, hence we do not know what changed.
+			::syslog(LOG_ERR, "netlink events lost, enumerating all interfaces");
+			scheduleChange(true);
+			// there might be more events waiting
+			return 1;
 		}
 		return nBytes;
 	}
 
-
 	int Netlink::start(cb_t eventHandler)
 	{
 		m_eventHandler = eventHandler;
 		if (m_eventHandler) {
-			m_eventHandler(COMPLETE, 0, "");
+			m_eventHandler(COMPLETE);
 		}
 
 		m_eventloop.addEvent(m_fd, std::bind(&Netlink::process, this));
@@ -164,6 +223,9 @@ namespace hbm {
 
 	int Netlink::stop()
 	{
+		m_debounceTimer.cancel();
+		m_changePending = false;
+		m_resyncPending = false;
 		m_eventloop.eraseEvent(m_fd);
 		return ::close(m_fd);
 	}
@@ -38,13 +38,132 @@
 
 namespace hbm {
 	namespace communication {
+#ifndef _WIN32
+		/// room for the control messages of a received datagram. There has to be room for each option enabled by setupReceiveSocket().
+		union receiveControl_t {
+			char buffer[CMSG_SPACE(sizeof(struct in_pktinfo)) // IP_PKTINFO
+				+ CMSG_SPACE(sizeof(uint32_t)) // SO_RXQ_OVFL
+				+ CMSG_SPACE(sizeof(struct timespec))]; // SO_TIMESTAMPNS
+			struct cmsghdr alignment;
+		};
+
+		/// evaluates the control messages of a received telegram.
+		/// \param[out] telegram adapterIndex, ttl and timeOfArrival are set if contained
+		/// \param[out] socketDropCount only set if the kernel dropped datagrams on this socket
+		static void evaluateControlMessages(struct msghdr& msg, receivedTelegram_t& telegram, uint32_t& socketDropCount)
+		{
+			for (struct cmsghdr* pcmsghdr = CMSG_FIRSTHDR(&msg); pcmsghdr != NULL; pcmsghdr = CMSG_NXTHDR(&msg, pcmsghdr)) {
+				if (pcmsghdr->cmsg_level == SOL_SOCKET) {
+					if (pcmsghdr->cmsg_type == SO_RXQ_OVFL) {
+						// number of datagrams dropped since the socket was created
+						uint32_t* pDropCount = reinterpret_cast <uint32_t*> (CMSG_DATA(pcmsghdr));
+						socketDropCount = *pDropCount;
+					} else if (pcmsghdr->cmsg_type == SCM_TIMESTAMPNS) {
+						struct timespec* pTimestamp = reinterpret_cast <struct timespec*> (CMSG_DATA(pcmsghdr));
+						std::chrono::nanoseconds sinceEpoch = std::chrono::seconds(pTimestamp->tv_sec) + std::chrono::nanoseconds(pTimestamp->tv_nsec);
+						telegram.timeOfArrival = std::chrono::system_clock::time_point(std::chrono::duration_cast < std::chrono::system_clock::duration > (sinceEpoch));
+					}
+				} else if (pcmsghdr->cmsg_type == IP_PKTINFO) {
+					struct in_pktinfo* ppktinfo = reinterpret_cast <struct in_pktinfo*> (CMSG_DATA(pcmsghdr));
+					telegram.adapterIndex = ppktinfo->ipi_ifindex;
+				} else if(pcmsghdr->cmsg_type == IP_TTL) {
+					// returns the ttl from the received ip header (the value set by the last sender(router))
+					int* pTtl = reinterpret_cast <int*> (CMSG_DATA(pcmsghdr));
+					telegram.ttl = *pTtl;
+				}
+			}
+		}
+#endif
+
+#ifndef _WIN32
+		/// room for the control messages selecting the outgoing interface and the ttl of a datagram
+		union sendControl_t {
+			char buffer[CMSG_SPACE(sizeof(struct in_pktinfo)) + CMSG_SPACE(sizeof(int))];
+			struct cmsghdr alignment;
+		};
+
+		/// selects the outgoing interface (IP_PKTINFO) and the ttl (IP_TTL) of a datagram.
+		/// Setting IP_MULTICAST_IF and IP_MULTICAST_TTL instead would cost extra system calls and would make the sending socket stateful.
+		/// \param interfaceIndex 0 if not known
+		/// \param ttl 0 to 255. IP_TTL does not allow 0. Without IP_TTL, the IP_MULTICAST_TTL of the socket (0) applies.
+		static void setSendControl(struct msghdr& msg, sendControl_t& control, const struct in_addr& interfaceAddress, unsigned int interfaceIndex, unsigned int ttl)
+		{
+			memset(&control, 0, sizeof(control));
+			msg.msg_control = control.buffer;
+			if (ttl==0) {
+				msg.msg_controllen = CMSG_SPACE(sizeof(struct in_pktinfo));
+			} else {
+				msg.msg_controllen = sizeof(control.buffer);
+			}
+
+			struct cmsghdr* pcmsghdr = CMSG_FIRSTHDR(&msg);
+			pcmsghdr->cmsg_level = IPPROTO_IP;
+			pcmsghdr->cmsg_type = IP_PKTINFO;
+			pcmsghdr->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+			// without interface index, the kernel sends multicast via the interface owning the source address
+			struct in_pktinfo* ppktinfo = reinterpret_cast < struct in_pktinfo* > (CMSG_DATA(pcmsghdr));
+			ppktinfo->ipi_ifindex = interfaceIndex;
+			ppktinfo->ipi_spec_dst = interfaceAddress;
+
+			if (ttl==0) {
+				return;
+			}
+			pcmsghdr = CMSG_NXTHDR(&msg, pcmsghdr);
+			pcmsghdr->cmsg_level = IPPROTO_IP;
+			pcmsghdr->cmsg_type = IP_TTL;
+			pcmsghdr->cmsg_len = CMSG_LEN(sizeof(int));
+			int value = static_cast < int > (ttl);
+			memcpy(CMSG_DATA(pcmsghdr), &value, sizeof(value));
+		}
+
+		/// sends the messages of a fan-out. A message that can not be sent does not keep the following ones from being sent.
+		/// \param resultPositions for each message, the element of results telling what happened
+		static void sendMessages(SOCKET sendSocket, struct mmsghdr* msgs, unsigned int count, size_t length, const size_t* resultPositions, interfaceSendResults_t& results)
+		{
+			unsigned int done = 0;
+			while (done < count) {
+				int sent = ::sendmmsg(sendSocket, msgs+done, count-done, 0);
+				if (sent <= 0) {
+					// sendmmsg stops at the first message that fails
+					interfaceSendResult_t& result = results[resultPositions[done]];
+					::syslog(LOG_ERR, "error sending message over interface %u!", result.adapterIndex);
+					result.result = ERR_NO_SUCCESS;
+					++done;
+					continue;
+				}
+
+				for (int i = 0; i < sent; ++i) {
+					if (msgs[done].msg_len != length) {
+						interfaceSendResult_t& result = results[resultPositions[done]];
+						::syslog(LOG_ERR, "error sending message over interface %u!", result.adapterIndex);
+						result.result = ERR_NO_SUCCESS;
+					}
+					++done;
+				}
+			}
+		}
+#endif
+
 		MulticastServer::MulticastServer(NetadapterList& netadapterList, sys::EventLoop &eventLoop)
 			: m_address()
+			, m_groupAddress()
 			, m_port()
 			, m_ReceiveSocket(NO_SOCKET)
 			, m_SendSocket(NO_SOCKET)
+			, m_sendAddr()
 			, m_receiveAddr()
+			, m_receiveAllMemberships(true)
+			, m_multicastLoop(false)
+			, m_receiveBufferSize(DEFAULT_RECEIVE_BUFFER_SIZE)
+			, m_receiveBufferMaxSize(DEFAULT_RECEIVE_BUFFER_SIZE)
+			, m_socketDropCount(0)
+			, m_kernelDropCount(0)
+			, m_controlTruncatedCount(0)
+			, m_memberships()
+			, m_membershipsMtx()
 			, m_netadapterList(netadapterList)
+			, m_interfaceIdentities(netadapterList.getInterfaceIdentities())
+			, m_interfaceIdentitiesGeneration(netadapterList.getGeneration())
 			, m_eventLoop(eventLoop)
 			, m_dataHandler()
 		{
@@ -92,6 +211,9 @@ namespace hbm {
 					m_ReceiveSocket = NO_SOCKET;
 				}
 
+				// used for each membership change
+				m_groupAddress = reinterpret_cast < struct sockaddr_in* > (pResult->ai_addr)->sin_addr;
+
 				memset(&m_receiveAddr, 0, sizeof(m_receiveAddr));
 				m_receiveAddr.sin_family = pResult->ai_family;
 				m_receiveAddr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -119,12 +241,8 @@ namespace hbm {
 
 
 			// sufficient buffer for several messages
-			int RcvBufSize = 128000;
-	#ifdef _WIN32
-			if (setsockopt(m_ReceiveSocket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast < char* >(&RcvBufSize), sizeof(RcvBufSize)) < 0) {
-	#else
-			if (setsockopt(m_ReceiveSocket, SOL_SOCKET, SO_RCVBUF, &RcvBufSize, sizeof(RcvBufSize)) < 0) {
-	#endif
+			if (applyReceiveBufferSize(m_receiveBufferSize) < 0) {
+				::syslog(LOG_ERR, "Could not set receive buffer size!");
 				return -1;
 			}
 
@@ -146,6 +264,30 @@ namespace hbm {
 				return -1;
 			}
 
+#ifndef _WIN32
+			// We do want to know whether the kernel dropped datagrams because the receive buffer was full
+			m_socketDropCount = 0;
+			if (setsockopt(m_ReceiveSocket, SOL_SOCKET, SO_RXQ_OVFL, &yes, sizeof(yes)) != 0) {
+				::syslog(LOG_ERR, "Could not set SO_RXQ_OVFL!");
+				return -1;
+			}
+
+			// We do want to know how long datagrams were waiting in the receive buffer
+			if (setsockopt(m_ReceiveSocket, SOL_SOCKET, SO_TIMESTAMPNS, &yes, sizeof(yes)) != 0) {
+				::syslog(LOG_ERR, "Could not set SO_TIMESTAMPNS!");
+				return -1;
+			}
+
+			if (m_receiveAllMemberships==false) {
+				int multicastAll = 0;
+				if (setsockopt(m_ReceiveSocket, IPPROTO_IP, IP_MULTICAST_ALL, &multicastAll, sizeof(multicastAll)) != 0) {
+					::syslog(LOG_ERR, "Could not reset IP_MULTICAST_ALL!");
+					return -1;
+				}
+			}
+#endif
+
+			// receiveControl_t needs room for CMSG_SPACE(sizeof(int)) more if enabled
 			//if (setsockopt(m_ReceiveSocket, IPPROTO_IP, IP_RECVTTL, reinterpret_cast < char* >(&yes), sizeof(yes)) != 0) {
 			//	::syslog(LOG_ERR, "Could not set IP_RECVTTL!");
 			//	return -1;
@@ -160,6 +302,79 @@ namespace hbm {
 		}
 
 
+		int MulticastServer::applyReceiveBufferSize(int size)
+		{
+	#ifdef _WIN32
+			return setsockopt(m_ReceiveSocket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast < char* >(&size), sizeof(size));
+	#else
+			// SO_RCVBUFFORCE ignores net.core.rmem_max but requires CAP_NET_ADMIN
+			if (setsockopt(m_ReceiveSocket, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == 0) {
+				return 0;
+			}
+			return setsockopt(m_ReceiveSocket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	#endif
+		}
+
+		void MulticastServer::setReceiveBufferSize(int size, int maxSize)
+		{
+			m_receiveBufferSize = size;
+			if (maxSize < size) {
+				maxSize = size;
+			}
+			m_receiveBufferMaxSize = maxSize;
+		}
+
+		int MulticastServer::getReceiveBufferSize() const
+		{
+			if (m_ReceiveSocket == NO_SOCKET) {
+				return -1;
+			}
+
+			int size = 0;
+			socklen_t optionLength = sizeof(size);
+	#ifdef _WIN32
+			if (getsockopt(m_ReceiveSocket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast < char* >(&size), &optionLength) < 0) {
+	#else
+			if (getsockopt(m_ReceiveSocket, SOL_SOCKET, SO_RCVBUF, &size, &optionLength) < 0) {
+	#endif
+				return -1;
+			}
+			return size;
+		}
+
+		void MulticastServer::countControlTruncation(unsigned int truncated)
+		{
+			if (truncated == 0) {
+				return;
+			}
+			if (m_controlTruncatedCount.fetch_add(truncated, std::memory_order_relaxed) == 0) {
+				// told once. Otherwise each datagram would be logged.
+				::syslog(LOG_ERR, "control messages of received datagrams truncated, control buffer too small!");
+			}
+		}
+
+		void MulticastServer::updateKernelDropCount(uint32_t socketDropCount)
+		{
+			// the counter of the socket wraps around
+			uint32_t dropped = socketDropCount - m_socketDropCount;
+			if (dropped == 0) {
+				return;
+			}
+			m_socketDropCount = socketDropCount;
+			m_kernelDropCount.fetch_add(dropped, std::memory_order_relaxed);
+
+			if (m_receiveBufferSize < m_receiveBufferMaxSize) {
+				int size = m_receiveBufferSize * 2;
+				if ((size < m_receiveBufferSize) || (size > m_receiveBufferMaxSize)) {
+					size = m_receiveBufferMaxSize;
+				}
+				if (applyReceiveBufferSize(size) == 0) {
+					::syslog(LOG_INFO, "%u datagrams dropped, receive buffer size increased to %d", dropped, size);
+					m_receiveBufferSize = size;
+				}
+			}
+		}
+
 		int MulticastServer::setupSendSocket()
 		{
 			m_SendSocket = socket(AF_INET, SOCK_DGRAM, 0);
@@ -169,11 +384,27 @@ namespace hbm {
 				::syslog(LOG_ERR, "Could not create socket!");
 				return -1;
 			}
+			memset(&m_sendAddr, 0, sizeof(m_sendAddr));
+			m_sendAddr.sin_family = AF_INET;
+			m_sendAddr.sin_port = htons(m_port);
+	#ifdef _WIN32
+			m_sendAddr.sin_addr.s_addr = inet_addr(m_address.c_str());
 
+			if (m_sendAddr.sin_addr.s_addr == INADDR_NONE) {
+	#else
+
+			if (inet_aton(m_address.c_str(), &m_sendAddr.sin_addr) == 0) {
+	#endif
+				::syslog(LOG_ERR, "Not a valid multicast IP address!");
+				return -1;
+			}
 
 			{
-				// we do not want to receive the stuff we where sending
+				// usually, we do not want to receive the stuff we where sending
 				unsigned char value = 0;
+				if (m_multicastLoop) {
+					value = 1;
+				}
 	#ifdef _WIN32
 				if (setsockopt(m_SendSocket, IPPROTO_IP, IP_MULTICAST_LOOP, reinterpret_cast <char* > (&value), sizeof(value))) {
 	#else
@@ -184,6 +415,17 @@ namespace hbm {
 				}
 			}
 
+	#ifndef _WIN32
+			{
+				// applies to datagrams sent with ttl 0 only. All others carry their ttl (IP_TTL).
+				int value = 0;
+				if (setsockopt(m_SendSocket, IPPROTO_IP, IP_MULTICAST_TTL, &value, sizeof(value))) {
+					::syslog(LOG_ERR, "Error setsockopt IP_MULTICAST_TTL!");
+					return -1;
+				}
+			}
+	#endif
+
 			return 0;
 		}
 
@@ -197,39 +439,73 @@ namespace hbm {
 			return dropOrAddInterface(interfaceAddress, true);
 		}
 
-		void MulticastServer::addAllInterfaces()
+		MulticastServer::interfaceAddresses_t MulticastServer::getAllInterfaceAddresses() const
 		{
-			NetadapterList::tAdapters adapters = m_netadapterList.get();
-			for (NetadapterList::tAdapters::const_iterator iter = adapters.begin(); iter != adapters.end(); ++iter) {
-				const communication::Netadapter& adapter = iter->second;
-
-				const communication::addressesWithNetmask_t& addresses = adapter.getIpv4Addresses();
+			interfaceAddresses_t interfaceAddresses;
+			NetadapterList::tAdaptersPtr pAdapters = m_netadapterList.getAdapters();
+			for (NetadapterList::tAdapters::const_iterator iter = pAdapters->begin(); iter != pAdapters->end(); ++iter) {
+				const communication::addressesWithNetmask_t& addresses = iter->second.getIpv4Addresses();
 				if(addresses.empty()==false) {
-					addInterface(addresses.front().address);
+					interfaceAddresses.insert(addresses.front().address);
+				}
+			}
+			return interfaceAddresses;
+		}
+
+		void MulticastServer::addAllInterfaces()
+		{
+			interfaceAddresses_t interfaceAddresses = getAllInterfaceAddresses();
+			interfaceAddresses_t memberships = getInterfaces();
+			for (interfaceAddresses_t::const_iterator iter = interfaceAddresses.begin(); iter != interfaceAddresses.end(); ++iter) {
+				// memberships held already are not touched
+				if (memberships.find(*iter)==memberships.end()) {
+					addInterface(*iter);
 				}
 			}
 		}
 
 		void MulticastServer::dropAllInterfaces()
 		{
-			NetadapterList::tAdapters adapters = m_netadapterList.get();
-			for (NetadapterList::tAdapters::const_iterator iter = adapters.begin(); iter != adapters.end(); ++iter) {
-				const communication::Netadapter& adapter = iter->second;
+			updateInterfaces(interfaceAddresses_t());
+		}
 
-				const communication::addressesWithNetmask_t& addresses = adapter.getIpv4Addresses();
-				if(addresses.empty()==false) {
-					dropInterface(addresses.front().address);
+
+		void MulticastServer::updateInterfaces(const interfaceAddresses_t& interfaceAddresses)
+		{
+			interfaceAddresses_t memberships = getInterfaces();
+
+			// both sets are ordered. Walk them side by side.
+			interfaceAddresses_t::const_iterator current = memberships.begin();
+			interfaceAddresses_t::const_iterator target = interfaceAddresses.begin();
+			while ((current!=memberships.end()) || (target!=interfaceAddresses.end())) {
+				if ((target==interfaceAddresses.end()) || ((current!=memberships.end()) && (*current<*target))) {
+					dropInterface(*current);
+					++current;
+				} else if ((current==memberships.end()) || (*target<*current)) {
+					addInterface(*target);
+					++target;
+				} else {
+					// unchanged
+					++current;
+					++target;
 				}
 			}
 		}
 
+		void MulticastServer::updateAllInterfaces()
+		{
+			updateInterfaces(getAllInterfaceAddresses());
+		}
+
+		MulticastServer::interfaceAddresses_t MulticastServer::getInterfaces() const
+		{
+			std::lock_guard < std::mutex > lock(m_membershipsMtx);
+			return m_memberships;
+		}
 
 		int MulticastServer::dropOrAddInterface(const std::string& interfaceAddress, bool add)
 		{
 			int retVal = 0;
-			struct addrinfo hints;
-			struct addrinfo* pResult = NULL;
-			char portString[8];
 
 	#ifdef _WIN32
 			struct ip_mreq im;
@@ -237,21 +513,13 @@ namespace hbm {
 			struct ip_mreqn im;
 	#endif
 
-			memset(&hints, 0, sizeof(hints));
-
-			sprintf(portString, "%u", m_port);
-			hints.ai_family   = PF_UNSPEC;
-			hints.ai_socktype = SOCK_DGRAM;
-
-			if ( getaddrinfo(m_address.c_str(), portString, &hints, &pResult) != 0 ) {
-				::syslog(LOG_ERR, "Not a valid multicast IP address (%s)!", m_address.c_str());
+			if (m_ReceiveSocket == NO_SOCKET) {
+				// not started, the multicast group is not known yet
 				return -1;
 			}
 
 			memset(&im, 0, sizeof(im));
-			memcpy(&im.imr_multiaddr, &(reinterpret_cast < struct sockaddr_in* > (pResult->ai_addr))->sin_addr, sizeof(im.imr_multiaddr.s_addr));
-
-			freeaddrinfo(pResult);
+			im.imr_multiaddr = m_groupAddress;
 
 	#ifdef _WIN32
 			im.imr_interface.s_addr = inet_addr(interfaceAddress.c_str());
@@ -285,12 +553,12 @@ namespace hbm {
 #ifdef _WIN32
 					if (errno == WSAEADDRINUSE) {
 						// ignore already added
-						return 0;
+						retVal = 0;
 					}
 #else
 					if(errno==EADDRINUSE) {
 						// ignore already added
-						return 0;
+						retVal = 0;
 					}
 #endif
 
@@ -300,17 +568,29 @@ namespace hbm {
 #ifdef _WIN32
 					if (errno == WSAEADDRNOTAVAIL) {
 						// ignore already dropped
-						return 0;
+						retVal = 0;
 					}
 #else
 					if (errno == EADDRNOTAVAIL) {
 						// ignore already dropped
-						return 0;
+						retVal = 0;
 					}
 #endif
 				}
 			}
 
+			{
+				std::lock_guard < std::mutex > lock(m_membershipsMtx);
+				if (add) {
+					if (retVal==0) {
+						m_memberships.insert(interfaceAddress);
+					}
+				} else {
+					// the interface might be gone. There is no membership left to drop then.
+					m_memberships.erase(interfaceAddress);
+				}
+			}
+
 			return retVal;
 		}
 
@@ -338,16 +618,33 @@ namespace hbm {
 			return nbytes;
 		}
 
+		const NetadapterList::interfaceIdentity_t* MulticastServer::findInterfaceIdentity(unsigned int interfaceIndex)
+		{
+			// the snapshot is published before the generation gets incremented. Hence the snapshot taken is at least as recent as the generation.
+			uint64_t generation = m_netadapterList.getGeneration();
+			if (generation!=m_interfaceIdentitiesGeneration) {
+				m_interfaceIdentities = m_netadapterList.getInterfaceIdentities();
+				m_interfaceIdentitiesGeneration = generation;
+			}
+
+			NetadapterList::tInterfaceIdentities::const_iterator iter = m_interfaceIdentities->find(interfaceIndex);
+			if (iter==m_interfaceIdentities->end()) {
+				return NULL;
+			}
+			return &iter->second;
+		}
+
 		ssize_t MulticastServer::receiveTelegram(void* msgbuf, size_t len, std::string& adapterName, int& ttl)
 		{
 			int interfaceIndex = 0;
 			ssize_t nbytes = receiveTelegram(msgbuf, len, interfaceIndex, ttl);
 			if(nbytes>0) {
-				try {
-					adapterName = m_netadapterList.getAdapterByInterfaceIndex(interfaceIndex).getName();
-				} catch( const hbm::exception::exception&) {
+				const NetadapterList::interfaceIdentity_t* pIdentity = findInterfaceIdentity(interfaceIndex);
+				if (pIdentity==NULL) {
 					::syslog(LOG_ERR, "%s no interface with index %d!", __FUNCTION__, interfaceIndex);
 					nbytes = -1;
+				} else {
+					adapterName = pIdentity->name;
 				}
 			}
 			return nbytes;
@@ -357,7 +654,11 @@ namespace hbm {
 		{
 			// we do use recvmsg here because we get some additional information: The interface we received from.
 			ttl = 1;
+	#ifdef _WIN32
 			char controlbuffer[100];
+	#else
+			receiveControl_t control;
+	#endif
 			ssize_t nbytes;
 
 	#ifdef _WIN32
@@ -405,58 +706,193 @@ namespace hbm {
 			msg.msg_iov->iov_base = msgbuf;
 			msg.msg_iov->iov_len = len;
 			msg.msg_iovlen = 1;
-			msg.msg_control = &controlbuffer;
-			msg.msg_controllen = sizeof(controlbuffer);
+			msg.msg_control = control.buffer;
+			msg.msg_controllen = sizeof(control.buffer);
 			msg.msg_flags = 0;
 			nbytes = ::recvmsg(m_ReceiveSocket, &msg, 0);
 	#endif
 
 			if (nbytes > 0) {
 	#ifdef _WIN32
-				for (WSACMSGHDR* pcmsghdr = WSA_CMSG_FIRSTHDR(&msg); pcmsghdr != NULL; pcmsghdr = WSA_CMSG_NXTHDR(&msg, pcmsghdr))
-	#else
-				for (struct cmsghdr* pcmsghdr = CMSG_FIRSTHDR(&msg); pcmsghdr != NULL; pcmsghdr = CMSG_NXTHDR(&msg, pcmsghdr))
-	#endif
-				{
+				for (WSACMSGHDR* pcmsghdr = WSA_CMSG_FIRSTHDR(&msg); pcmsghdr != NULL; pcmsghdr = WSA_CMSG_NXTHDR(&msg, pcmsghdr)) {
 					if (pcmsghdr->cmsg_type == IP_PKTINFO) {
-						struct in_pktinfo* ppktinfo;
-	#ifdef _WIN32
-						ppktinfo = reinterpret_cast <struct in_pktinfo*> (WSA_CMSG_DATA(pcmsghdr));
-	#else
-						ppktinfo = reinterpret_cast <struct in_pktinfo*> (CMSG_DATA(pcmsghdr));
-	#endif
+						struct in_pktinfo* ppktinfo = reinterpret_cast <struct in_pktinfo*> (WSA_CMSG_DATA(pcmsghdr));
 						adapterIndex = ppktinfo->ipi_ifindex;
 					} else if(pcmsghdr->cmsg_type == IP_TTL) {
-						int* pTtl;
 						// returns the ttl from the received ip header (the value set by the last sender(router))
-	#ifdef _WIN32
-						pTtl = reinterpret_cast <int*> (WSA_CMSG_DATA(pcmsghdr));
-	#else
-						pTtl = reinterpret_cast <int*> (CMSG_DATA(pcmsghdr));
-	#endif
+						int* pTtl = reinterpret_cast <int*> (WSA_CMSG_DATA(pcmsghdr));
 						ttl = *pTtl;
 					}
 				}
+	#else
+				receivedTelegram_t telegram;
+				telegram.adapterIndex = adapterIndex;
+				telegram.ttl = ttl;
+				uint32_t socketDropCount = m_socketDropCount;
+				evaluateControlMessages(msg, telegram, socketDropCount);
+				adapterIndex = telegram.adapterIndex;
+				ttl = telegram.ttl;
+				updateKernelDropCount(socketDropCount);
+				if (msg.msg_flags & MSG_CTRUNC) {
+					countControlTruncation(1);
+				}
+	#endif
 			}
 			return nbytes;
 		}
 
+		ssize_t MulticastServer::receiveTelegrams(receivedTelegram_t* telegrams, unsigned int count)
+		{
+			if (count > MAX_TELEGRAMS_PER_BATCH) {
+				count = MAX_TELEGRAMS_PER_BATCH;
+			}
+
+	#ifdef _WIN32
+			// there is no recvmmsg under windows. Receive one after the other.
+			unsigned int received = 0;
+			while (received < count) {
+				receivedTelegram_t& telegram = telegrams[received];
+				ssize_t nbytes = receiveTelegram(telegram.pBuffer, telegram.bufferSize, telegram.adapterIndex, telegram.ttl);
+				if (nbytes <= 0) {
+					break;
+				}
+				telegram.length = static_cast < size_t > (nbytes);
+				telegram.timeOfArrival = std::chrono::system_clock::now();
+				++received;
+			}
+
+			if (received == 0) {
+				return -1;
+			}
+			return received;
+	#else
+			// one control buffer per message. We want to know the interface, each message was received from.
+			struct mmsghdr msgs[MAX_TELEGRAMS_PER_BATCH];
+			struct iovec iovs[MAX_TELEGRAMS_PER_BATCH];
+			struct sockaddr_in addrs[MAX_TELEGRAMS_PER_BATCH];
+			receiveControl_t controls[MAX_TELEGRAMS_PER_BATCH];
+
+			memset(msgs, 0, sizeof(msgs[0])*count);
+			for (unsigned int i = 0; i < count; ++i) {
+				iovs[i].iov_base = telegrams[i].pBuffer;
+				iovs[i].iov_len = telegrams[i].bufferSize;
+
+				struct msghdr& msg = msgs[i].msg_hdr;
+				msg.msg_name = &addrs[i];
+				msg.msg_namelen = sizeof(addrs[i]);
+				msg.msg_iov = &iovs[i];
+				msg.msg_iovlen = 1;
+				msg.msg_control = controls[i].buffer;
+				msg.msg_controllen = sizeof(controls[i].buffer);
+			}
+
+			int received = ::recvmmsg(m_ReceiveSocket, msgs, count, 0, NULL);
+			std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+			uint32_t socketDropCount = m_socketDropCount;
+			unsigned int truncated = 0;
+			for (int i = 0; i < received; ++i) {
+				receivedTelegram_t& telegram = telegrams[i];
+				telegram.length = msgs[i].msg_len;
+				telegram.adapterIndex = 0;
+				telegram.ttl = 1;
+				telegram.timeOfArrival = now;
+				evaluateControlMessages(msgs[i].msg_hdr, telegram, socketDropCount);
+				if (msgs[i].msg_hdr.msg_flags & MSG_CTRUNC) {
+					++truncated;
+				}
+			}
+			updateKernelDropCount(socketDropCount);
+			countControlTruncation(truncated);
+			return received;
+	#endif
+		}
+
 		int MulticastServer::send(const void* pData, size_t length, unsigned int ttl) const
 		{
-			int retVal = 0;
-			int retValIntern;
+			interfaceSendResults_t results;
+			return send(pData, length, ttl, results);
+		}
 
-			NetadapterList::tAdapters adapters = m_netadapterList.get();
+		int MulticastServer::send(const void* pData, size_t length, unsigned int ttl, interfaceSendResults_t& results) const
+		{
+			results.clear();
+			if (length==0) {
+				return ERR_SUCCESS;
+			}
+			if (pData==NULL) {
+				return ERR_NO_SUCCESS;
+			}
+			if (ttl>MAX_TTL) {
+				::syslog(LOG_ERR, "Invalid ttl %u!", ttl);
+				return ERR_NO_SUCCESS;
+			}
+
+			// the snapshot is not copied
+			NetadapterList::tAdaptersPtr pAdapters = m_netadapterList.getAdapters();
+			results.reserve(pAdapters->size());
 
-			for (NetadapterList::tAdapters::const_iterator iter = adapters.begin(); iter != adapters.end(); ++iter) {
+	#ifdef _WIN32
+			for (NetadapterList::tAdapters::const_iterator iter = pAdapters->begin(); iter != pAdapters->end(); ++iter) {
+				interfaceSendResult_t result;
+				result.adapterIndex = iter->first;
+				result.result = sendOverInterface(iter->second, pData, length, ttl);
+				results.push_back(result);
+			}
+	#else
+			// all messages carry the same datagram
+			struct iovec iov;
+			iov.iov_base = const_cast < void* > (pData);
+			iov.iov_len = length;
+
+			struct mmsghdr msgs[MAX_TELEGRAMS_PER_BATCH];
+			sendControl_t controls[MAX_TELEGRAMS_PER_BATCH];
+			size_t resultPositions[MAX_TELEGRAMS_PER_BATCH];
+			unsigned int count = 0;
+
+			for (NetadapterList::tAdapters::const_iterator iter = pAdapters->begin(); iter != pAdapters->end(); ++iter) {
 				const Netadapter& adapter = iter->second;
+				interfaceSendResult_t result;
+				result.adapterIndex = iter->first;
+				result.result = ERR_SUCCESS;
+
+				const communication::addressesWithNetmask_t& addressesWithNetmask = adapter.getIpv4Addresses();
+				struct in_addr interfaceAddress;
+				if (addressesWithNetmask.empty()) {
+					::syslog(LOG_ERR, "%s interface %s does not have an ipv4 address!", __FUNCTION__, adapter.getName().c_str());
+					result.result = ERR_INVALIDADAPTER;
+				} else if (inet_aton(addressesWithNetmask.front().address.c_str(), &interfaceAddress) == 0) {
+					::syslog(LOG_ERR, "%s is not a valid interface IP address!", addressesWithNetmask.front().address.c_str());
+					result.result = ERR_INVALIDIPADDRESS;
+				} else {
+					memset(&msgs[count], 0, sizeof(msgs[count]));
+					struct msghdr& msg = msgs[count].msg_hdr;
+					msg.msg_name = const_cast < struct sockaddr_in* > (&m_sendAddr);
+					msg.msg_namelen = sizeof(m_sendAddr);
+					msg.msg_iov = &iov;
+					msg.msg_iovlen = 1;
+					setSendControl(msg, controls[count], interfaceAddress, iter->first, ttl);
+					resultPositions[count] = results.size();
+					++count;
+				}
+				results.push_back(result);
 
-				retValIntern = sendOverInterface(adapter, pData, length, ttl);
-				if (retValIntern != 0) {
-					retVal = retValIntern;
+				if (count==MAX_TELEGRAMS_PER_BATCH) {
+					sendMessages(m_SendSocket, msgs, count, length, resultPositions, results);
+					count = 0;
 				}
 			}
 
+			if (count>0) {
+				sendMessages(m_SendSocket, msgs, count, length, resultPositions, results);
+			}
+	#endif
+
+			int retVal = ERR_SUCCESS;
+			for (interfaceSendResults_t::const_iterator iter = results.begin(); iter != results.end(); ++iter) {
+				if (iter->result != ERR_SUCCESS) {
+					retVal = iter->result;
+				}
+			}
 			return retVal;
 		}
 
@@ -474,7 +910,7 @@ namespace hbm {
 
 			int retVal = 0;
 
-			const communication::addressesWithNetmask_t addressesWithNetmask = adapter.getIpv4Addresses();
+			const communication::addressesWithNetmask_t& addressesWithNetmask = adapter.getIpv4Addresses();
 			if(addressesWithNetmask.empty()) {
 				return communication::ERR_ADAPTERISDOWN;
 			} else {
@@ -491,14 +927,12 @@ namespace hbm {
 			}
 
 			// IPV6_MULTICAST_IF does not work. It is not possible to send via a desired interface index. We have to select the interface by IP address using IP_MULTICAST_IF
-			int retVal;
-			try {
-				communication::Netadapter adapter = m_netadapterList.getAdapterByInterfaceIndex(interfaceIndex);
-				retVal = sendOverInterface(adapter, data, ttl);
-			} catch( const hbm::exception::exception&) {
-				retVal = communication::ERR_INVALIDADAPTER;
+			NetadapterList::tAdaptersPtr pAdapters = m_netadapterList.getAdapters();
+			NetadapterList::tAdapters::const_iterator iter = pAdapters->find(interfaceIndex);
+			if (iter==pAdapters->end()) {
+				return communication::ERR_INVALIDADAPTER;
 			}
-			return retVal;
+			return sendOverInterface(iter->second, data, ttl);
 		}
 
 		int MulticastServer::sendOverInterface(int interfaceIndex, const void* pData, size_t length, unsigned int ttl) const
@@ -509,14 +943,12 @@ namespace hbm {
 
 			// IPV6_MULTICAST_IF does not work. It is not possible to send via a desired interface index. We have to select the interface by IP address using IP_MULTICAST_IF
 
-			int retVal;
-			try {
-				Netadapter adapter = m_netadapterList.getAdapterByInterfaceIndex(interfaceIndex);
-				retVal = sendOverInterface(adapter, pData, length, ttl);
-			} catch( const hbm::exception::exception&) {
-				retVal = ERR_INVALIDADAPTER;
+			NetadapterList::tAdaptersPtr pAdapters = m_netadapterList.getAdapters();
+			NetadapterList::tAdapters::const_iterator iter = pAdapters->find(interfaceIndex);
+			if (iter==pAdapters->end()) {
+				return ERR_INVALIDADAPTER;
 			}
-			return retVal;
+			return sendOverInterface(iter->second, pData, length, ttl);
 		}
 
 		int MulticastServer::sendOverInterface(const Netadapter& adapter, const void* pData, size_t length, unsigned int ttl) const
@@ -526,7 +958,7 @@ namespace hbm {
 				if (pData==NULL) {
 					retVal = ERR_NO_SUCCESS;
 				} else {
-					const communication::addressesWithNetmask_t addressesWithNetmask = adapter.getIpv4Addresses();
+					const communication::addressesWithNetmask_t& addressesWithNetmask = adapter.getIpv4Addresses();
 					if(addressesWithNetmask.empty()==false) {
 						retVal = sendOverInterfaceByAddress(addressesWithNetmask.front().address, pData, length, ttl);
 					} else {
@@ -548,72 +980,77 @@ namespace hbm {
 			return sendOverInterfaceByAddress(interfaceIp, data.c_str(), data.length(), ttl);
 		}
 
-		int MulticastServer::sendOverInterfaceByAddress(const std::string& interfaceIp, const void* pData, size_t length, unsigned int ttl) const
+		int MulticastServer::prepareSendOverInterface(const std::string& interfaceIp, unsigned int ttl, struct in_addr& interfaceAddress) const
 		{
-			if (pData==NULL) {
-				if(length>0) {
-					return ERR_NO_SUCCESS;
-				} else {
-					return ERR_SUCCESS;
-				}
-			}
-
-			struct in_addr ifAddr;
-			memset(&ifAddr, 0, sizeof(ifAddr));
+			memset(&interfaceAddress, 0, sizeof(interfaceAddress));
 
 
 	#ifdef _WIN32
-			ifAddr.s_addr = inet_addr(interfaceIp.c_str());
+			interfaceAddress.s_addr = inet_addr(interfaceIp.c_str());
 
-			if (ifAddr.s_addr == INADDR_NONE) {
+			if (interfaceAddress.s_addr == INADDR_NONE) {
 	#else
 
-			if (inet_aton(interfaceIp.c_str(), &ifAddr) == 0) {
+			if (inet_aton(interfaceIp.c_str(), &interfaceAddress) == 0) {
 	#endif
 				::syslog(LOG_ERR, "%s is not a valid interface IP address!", interfaceIp.c_str());
 				return ERR_INVALIDIPADDRESS;
 			}
 
-	#ifdef _WIN32
-			if (setsockopt(m_SendSocket, IPPROTO_IP, IP_MULTICAST_IF, reinterpret_cast < char* >(&ifAddr), sizeof(ifAddr))) {
-	#else
+			if (ttl>MAX_TTL) {
+				::syslog(LOG_ERR, "Invalid ttl %u!", ttl);
+				return ERR_NO_SUCCESS;
+			}
 
-			if (setsockopt(m_SendSocket, IPPROTO_IP, IP_MULTICAST_IF, &ifAddr, sizeof(ifAddr))) {
-	#endif
+	#ifdef _WIN32
+			// there is no IP_PKTINFO for sending with sendto
+			if (setsockopt(m_SendSocket, IPPROTO_IP, IP_MULTICAST_IF, reinterpret_cast < char* >(&interfaceAddress), sizeof(interfaceAddress))) {
 				::syslog(LOG_ERR, "Error setsockopt IP_MULTICAST_IF for interface %s!", interfaceIp.c_str());
 				return ERR_INVALIDADAPTER;
 			};
 
-	#ifdef _WIN32
 			if (setsockopt(m_SendSocket, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast < char* >(&ttl), sizeof(ttl))) {
-	#else
-
-			if (setsockopt(m_SendSocket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl))) {
-	#endif
-				::syslog(LOG_ERR, "%s: Error setsockopt IPV6_MULTICAST_HOPS to %u!", interfaceIp.c_str(), ttl);
+				::syslog(LOG_ERR, "Error setsockopt IP_MULTICAST_TTL to %u!", ttl);
 				return ERR_NO_SUCCESS;
 			}
+	#endif
 
-			struct sockaddr_in sendAddr;
-			memset(&sendAddr, 0, sizeof(sendAddr));
-			sendAddr.sin_family = AF_INET;
-			sendAddr.sin_port = htons(m_port);
-	#ifdef _WIN32
-			sendAddr.sin_addr.s_addr = inet_addr(m_address.c_str());
+			return ERR_SUCCESS;
+		}
 
-			if (sendAddr.sin_addr.s_addr == INADDR_NONE) {
-	#else
+		int MulticastServer::sendOverInterfaceByAddress(const std::string& interfaceIp, const void* pData, size_t length, unsigned int ttl) const
+		{
+			if (pData==NULL) {
+				if(length>0) {
+					return ERR_NO_SUCCESS;
+				} else {
+					return ERR_SUCCESS;
+				}
+			}
 
-			if (inet_aton(m_address.c_str(), &sendAddr.sin_addr) == 0) {
-	#endif
-				::syslog(LOG_ERR, "Not a valid multicast IP address!");
-				return ERR_NO_SUCCESS;
+			struct in_addr interfaceAddress;
+			int retVal = prepareSendOverInterface(interfaceIp, ttl, interfaceAddress);
+			if (retVal != ERR_SUCCESS) {
+				return retVal;
 			}
 
 	#ifdef _WIN32
-			ssize_t nbytes = sendto(m_SendSocket, reinterpret_cast < const char* > (pData), static_cast < int > (length), 0, reinterpret_cast < struct sockaddr* >(&sendAddr), sizeof(sendAddr));
+			ssize_t nbytes = sendto(m_SendSocket, reinterpret_cast < const char* > (pData), static_cast < int > (length), 0, reinterpret_cast < const struct sockaddr* >(&m_sendAddr), sizeof(m_sendAddr));
 	#else
-			ssize_t nbytes = sendto(m_SendSocket, pData, length, 0, reinterpret_cast < struct sockaddr* >(&sendAddr), sizeof(sendAddr));
+			struct iovec iov;
+			iov.iov_base = const_cast < void* > (pData);
+			iov.iov_len = length;
+
+			sendControl_t control;
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_name = const_cast < struct sockaddr_in* > (&m_sendAddr);
+			msg.msg_namelen = sizeof(m_sendAddr);
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			setSendControl(msg, control, interfaceAddress, 0, ttl);
+
+			ssize_t nbytes = ::sendmsg(m_SendSocket, &msg, 0);
 	#endif
 
 			if (static_cast < size_t >(nbytes) != length) {
@@ -624,6 +1061,66 @@ namespace hbm {
 			return ERR_SUCCESS;
 		}
 
+		ssize_t MulticastServer::sendTelegramsOverInterfaceByAddress(const std::string& interfaceIp, const sendTelegram_t* telegrams, unsigned int count, unsigned int ttl) const
+		{
+			if (count > MAX_TELEGRAMS_PER_BATCH) {
+				count = MAX_TELEGRAMS_PER_BATCH;
+			}
+
+			struct in_addr interfaceAddress;
+			if (prepareSendOverInterface(interfaceIp, ttl, interfaceAddress) != ERR_SUCCESS) {
+				return -1;
+			}
+
+	#ifdef _WIN32
+			// there is no sendmmsg under windows. Send one after the other.
+			unsigned int sent = 0;
+			while (sent < count) {
+				const sendTelegram_t& telegram = telegrams[sent];
+				int nbytes = sendto(m_SendSocket, reinterpret_cast < const char* > (telegram.pData), static_cast < int > (telegram.length), 0, reinterpret_cast < const struct sockaddr* >(&m_sendAddr), sizeof(m_sendAddr));
+				if (nbytes < 0) {
+					break;
+				}
+				++sent;
+			}
+	#else
+			struct mmsghdr msgs[MAX_TELEGRAMS_PER_BATCH];
+			struct iovec iovs[MAX_TELEGRAMS_PER_BATCH];
+			// all telegrams go out via the same interface. They share the control message.
+			sendControl_t control;
+
+			memset(msgs, 0, sizeof(msgs[0])*count);
+			for (unsigned int i = 0; i < count; ++i) {
+				iovs[i].iov_base = const_cast < void* > (telegrams[i].pData);
+				iovs[i].iov_len = telegrams[i].length;
+
+				struct msghdr& msg = msgs[i].msg_hdr;
+				msg.msg_name = const_cast < struct sockaddr_in* > (&m_sendAddr);
+				msg.msg_namelen = sizeof(m_sendAddr);
+				msg.msg_iov = &iovs[i];
+				msg.msg_iovlen = 1;
+				setSendControl(msg, control, interfaceAddress, 0, ttl);
+			}
+
+			int sent = ::sendmmsg(m_SendSocket, msgs, count, 0);
+	#endif
+			if (sent <= 0) {
+				::syslog(LOG_ERR, "error sending messages over interface %s!", interfaceIp.c_str());
+				return -1;
+			}
+			return sent;
+		}
+
+
+		void MulticastServer::setReceiveAllMemberships(bool receiveAll)
+		{
+			m_receiveAllMemberships = receiveAll;
+		}
+
+		void MulticastServer::setMulticastLoop(bool loop)
+		{
+			m_multicastLoop = loop;
+		}
 
 		int MulticastServer::start(const std::string& address, unsigned int port, const DataHandler_t dataHandler)
 		{
@@ -682,6 +1179,12 @@ namespace hbm {
 	#endif
 				m_ReceiveSocket = NO_SOCKET;
 			}
+
+			{
+				// closing the socket left all groups
+				std::lock_guard < std::mutex > lock(m_membershipsMtx);
+				m_memberships.clear();
+			}
 		}
 	}
 }
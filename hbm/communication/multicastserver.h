@@ -6,8 +6,13 @@
 #define _MULTICASTSERVER_H
 
 
+#include <atomic>
+#include <mutex>
+#include <set>
 #include <string>
 #include <chrono>
+#include <vector>
+#include <stdint.h>
 
 
 
@@ -39,6 +44,47 @@ namespace hbm {
 		/// The maximum datagram size supported by UDP
 		const unsigned int MAX_DATAGRAM_SIZE = 65536;
 
+		/// Default size of the receive buffer of the socket
+		const int DEFAULT_RECEIVE_BUFFER_SIZE = 128000;
+
+		/// Maximum number of telegrams received by one call of MulticastServer::receiveTelegrams() or sent by one call of MulticastServer::sendTelegramsOverInterfaceByAddress()
+		const unsigned int MAX_TELEGRAMS_PER_BATCH = 64;
+
+		/// Highest ttl to send with. A ttl of 0 keeps the datagrams on this host.
+		const unsigned int MAX_TTL = 255;
+
+		/// describes one datagram received by MulticastServer::receiveTelegrams()
+		struct receivedTelegram_t {
+			/// buffer for the datagram, to be provided by the caller
+			void* pBuffer;
+			/// size of the buffer, to be provided by the caller
+			size_t bufferSize;
+			/// number of bytes received
+			size_t length;
+			/// index of the interface the datagram was received on
+			int adapterIndex;
+			/// ttl in the ip header (the value set by the last sender(router))
+			int ttl;
+			/// Under Linux, the time the datagram arrived at the socket (SO_TIMESTAMPNS). Otherwise the time it was fetched from the socket.
+			std::chrono::system_clock::time_point timeOfArrival;
+		};
+
+		/// describes one datagram to be sent by MulticastServer::sendTelegramsOverInterfaceByAddress()
+		struct sendTelegram_t {
+			const void* pData;
+			size_t length;
+		};
+
+		/// what happened when sending a datagram over one interface by MulticastServer::send()
+		struct interfaceSendResult_t {
+			/// index of the interface
+			unsigned int adapterIndex;
+			/// ERR_SUCCESS or the error code
+			int result;
+		};
+
+		typedef std::vector < interfaceSendResult_t > interfaceSendResults_t;
+
 		class Netadapter;
 
 		/// for receiving/sending UDP packets from/to multicast groups
@@ -47,6 +93,9 @@ namespace hbm {
 		public:
 			typedef std::function < ssize_t (MulticastServer* mcs) > DataHandler_t;
 
+			/// IPv4 addresses of receiving interfaces
+			typedef std::set < std::string > interfaceAddresses_t;
+
 			/// @param address the multicast group
 			MulticastServer(NetadapterList& netadapterList, sys::EventLoop &eventLoop);
 
@@ -59,37 +108,114 @@ namespace hbm {
 
 			int dropInterface(const std::string& interfaceAddress);
 
-			/// all interfaces known to the internal netadapter list are dropped as receiving interfaces.
+			/// the multicast group is left via all interfaces it was joined via.
 			void dropAllInterfaces();
 
+			/// \brief joins the multicast group via the interfaces given and leaves it via all others joined before.
+			/// Memberships that stay are not touched. Hence this is cheap if little has changed.
+			/// \param interfaceAddresses interfaces to receive from
+			void updateInterfaces(const interfaceAddresses_t& interfaceAddresses);
+
+			/// updateInterfaces() with the first IPv4 address of each interface known to the internal netadapter list
+			void updateAllInterfaces();
+
+			/// \return the interfaces the multicast group is joined via
+			interfaceAddresses_t getInterfaces() const;
+
+			/// Under Linux, a socket receives the datagrams of all multicast groups joined by any socket on any interface of the host.
+			/// Call with false before start() to receive only the datagrams arriving via the interfaces added to this object.
+			/// Several objects are able to split the traffic of the same multicast group by interface this way.
+			/// Under Windows, a socket receives via the interfaces added to it only anyway.
+			void setReceiveAllMemberships(bool receiveAll);
+
+			/// By default, datagrams sent are not received by sockets of the same host.
+			/// Call with true before start() to have them delivered locally too (IP_MULTICAST_LOOP). Useful for simulating devices.
+			void setMulticastLoop(bool loop);
+
+			/// To be called before start(). Many devices announcing at once (i.e. after power failure) might overflow the default buffer.
+			/// Under Linux, SO_RCVBUFFORCE is used if the process is privileged (CAP_NET_ADMIN). Otherwise the size is limited by net.core.rmem_max.
+			/// \param size size of the receive buffer in bytes
+			/// \param maxSize if larger than size, the buffer is doubled up to this size whenever the kernel drops datagrams because the buffer is full. Linux only.
+			void setReceiveBufferSize(int size, int maxSize = 0);
+
+			/// \return the size of the receive buffer as reported by the kernel (Linux reports twice the requested size). -1 if not started.
+			int getReceiveBufferSize() const;
+
+			/// Under Linux, datagrams dropped by the kernel because the receive buffer was full are counted (SO_RXQ_OVFL).
+			/// The counter is updated whenever a datagram is received. It is not reset on restart. Always 0 under Windows.
+			/// \return number of datagrams dropped since construction
+			uint64_t getKernelDropCount() const
+			{
+				return m_kernelDropCount.load(std::memory_order_relaxed);
+			}
+
+			/// Under Linux, datagrams whose control messages did not fit into the control buffer are counted (MSG_CTRUNC).
+			/// Their interface index, ttl or time of arrival might be missing. Anything but 0 is a bug. Always 0 under Windows.
+			/// \return number of datagrams with truncated control messages since construction
+			uint64_t getControlTruncatedCount() const
+			{
+				return m_controlTruncatedCount.load(std::memory_order_relaxed);
+			}
+
 			/// @param dataHandler set to empty(DataHandler_t()) if object is used as sender only.
 			int start(const std::string& address, unsigned int port, DataHandler_t dataHandler);
 
 			void stop();
 
 			/// Send over all interfaces
+			/// @param ttl 0 to MAX_TTL
 			int send(const std::string& data, unsigned int ttl=1) const;
 
+			/// @param ttl 0 to MAX_TTL
 			int send(const void *pData, size_t length, unsigned int ttl=1) const;
 
+			/// Send over all interfaces. Under Linux, up to MAX_TELEGRAMS_PER_BATCH interfaces are served by one system call (sendmmsg).
+			/// Under Linux, the ttl is carried by each datagram. Concurrent calls with different ttls do not interfere.
+			/// @param ttl 0 to MAX_TTL
+			/// @param[out] results one element for each interface known to the internal netadapter list
+			/// @return ERR_SUCCESS or the last error of results
+			int send(const void *pData, size_t length, unsigned int ttl, interfaceSendResults_t& results) const;
+
 			/// send over specific interface
+			/// @param ttl 0 to MAX_TTL
 			int sendOverInterface(const Netadapter& adapter, const std::string& data, unsigned int ttl=1) const;
+			/// @param ttl 0 to MAX_TTL
 			int sendOverInterface(const Netadapter &adapter, const void* pData, size_t length, unsigned int ttl=1) const;
 
+			/// @param ttl 0 to MAX_TTL
 			int sendOverInterface(int interfaceIndex, const std::string& data, unsigned int ttl=1) const;
+			/// @param ttl 0 to MAX_TTL
 			int sendOverInterface(int interfaceIndex, const void* pData, size_t length, unsigned int ttl=1) const;
 
 
 			/// send over specific interface.
 			/// @param interfaceIp IP address of the interface to use
+			/// @param ttl 0 to MAX_TTL
 			int sendOverInterfaceByAddress(const std::string& interfaceIp, const std::string& data, unsigned int ttl=1) const;
+			/// @param interfaceIp IP address of the interface to use
+			/// @param ttl 0 to MAX_TTL
 			int sendOverInterfaceByAddress(const std::string& interfaceIp, const void* pData, size_t length, unsigned int ttl=1) const;
 
+			/// sends up to count telegrams over a specific interface with one system call (sendmmsg under Linux).
+			/// @param interfaceIp IP address of the interface to use
+			/// @param count number of elements in telegrams. At most MAX_TELEGRAMS_PER_BATCH telegrams are sent at once.
+			/// @param ttl 0 to MAX_TTL
+			/// @return number of telegrams sent. -1 if nothing was sent.
+			ssize_t sendTelegramsOverInterfaceByAddress(const std::string& interfaceIp, const sendTelegram_t* telegrams, unsigned int count, unsigned int ttl=1) const;
+
 			ssize_t receiveTelegram(void* msgbuf, size_t len, Netadapter& adapter, int &ttl);
+
+			/// the name of the interface is taken from a snapshot. Nothing is locked or copied besides the name.
 			ssize_t receiveTelegram(void* msgbuf, size_t len, std::string& adapterName, int& ttl);
 
 			/// @param[out] ttl ttl in the ip header (the value set by the last sender(router))
 			ssize_t receiveTelegram(void* msgbuf, size_t len, int& adapterIndex, int &ttl);
+
+			/// receives up to count telegrams with one system call (recvmmsg under Linux).
+			/// @param[in, out] telegrams pBuffer and bufferSize of each element are to be set by the caller. length, adapterIndex and ttl are set for each received telegram.
+			/// @param count number of elements in telegrams. At most MAX_TELEGRAMS_PER_BATCH telegrams are received at once.
+			/// @return number of telegrams received. -1 if nothing was received.
+			ssize_t receiveTelegrams(receivedTelegram_t* telegrams, unsigned int count);
 		private:
 
 			MulticastServer(const MulticastServer&);
@@ -102,11 +228,34 @@ namespace hbm {
 
 			int dropOrAddInterface(const std::string& interfaceAddress, bool add);
 
+			/// Under Windows, sets the outgoing interface and the ttl of the sending socket. Under Linux, both are carried by each datagram.
+			/// Fails for a ttl above MAX_TTL.
+			/// @param[out] interfaceAddress the address of the outgoing interface
+			int prepareSendOverInterface(const std::string& interfaceIp, unsigned int ttl, struct in_addr& interfaceAddress) const;
+
+			/// sets the size of the receive buffer of the receiving socket
+			int applyReceiveBufferSize(int size);
+
+			/// \param socketDropCount number of datagrams dropped by the receiving socket as told by SO_RXQ_OVFL
+			void updateKernelDropCount(uint32_t socketDropCount);
+
+			/// \param truncated number of datagrams received with MSG_CTRUNC set
+			void countControlTruncation(unsigned int truncated);
+
 			/// called by eventloop
 			int process();
 
+			/// \return the first IPv4 address of each interface known to the internal netadapter list
+			interfaceAddresses_t getAllInterfaceAddresses() const;
+
+			/// takes a new snapshot of the interface identities if the adapters got updated since the last call.
+			/// \return NULL if there is no interface with this index. Valid until the next call.
+			const NetadapterList::interfaceIdentity_t* findInterfaceIdentity(unsigned int interfaceIndex);
+
 			/// The All Hosts multicast group addresses all hosts on the same network segment.
 			std::string m_address;
+			/// m_address resolved once on start()
+			struct in_addr m_groupAddress;
 
 			unsigned int m_port;
 
@@ -114,14 +263,41 @@ namespace hbm {
 
 			SOCKET m_ReceiveSocket;
 			SOCKET m_SendSocket;
+			/// the destination of all datagrams sent (multicast group and port). Set on start().
+			struct sockaddr_in m_sendAddr;
 	#ifdef _WIN32
 			WSAEVENT m_event;
 	#endif
 
 			struct sockaddr_in m_receiveAddr;
 
+			/// IP_MULTICAST_ALL
+			bool m_receiveAllMemberships;
+
+			/// IP_MULTICAST_LOOP
+			bool m_multicastLoop;
+
+			/// current size of the receive buffer
+			int m_receiveBufferSize;
+			/// the receive buffer grows up to this size on overflow
+			int m_receiveBufferMaxSize;
+
+			/// drop count of the current receiving socket as of the last received datagram
+			uint32_t m_socketDropCount;
+			std::atomic < uint64_t > m_kernelDropCount;
+			std::atomic < uint64_t > m_controlTruncatedCount;
+
+			/// the interfaces the multicast group is joined via
+			interfaceAddresses_t m_memberships;
+			mutable std::mutex m_membershipsMtx;
+
 			const NetadapterList& m_netadapterList;
 
+			/// snapshot used by the receive path
+			NetadapterList::tInterfaceIdentitiesPtr m_interfaceIdentities;
+			/// generation of m_netadapterList the snapshot belongs to
+			uint64_t m_interfaceIdentitiesGeneration;
+
 			sys::EventLoop& m_eventLoop;
 			DataHandler_t m_dataHandler;
 		};
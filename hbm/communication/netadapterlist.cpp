@@ -8,6 +8,7 @@
 #include <string>
 #include <stdint.h>
 #include <iterator>
+#include <memory>
 #include <mutex>
 #include <cstring>
 
@@ -36,6 +37,10 @@
 namespace hbm {
 	namespace communication {
 		NetadapterList::NetadapterList()
+			: m_adapters(new tAdapters())
+			, m_interfaceIdentities(new tInterfaceIdentities())
+			, m_updateMtx()
+			, m_generation(0)
 		{
 			enumAdapters();
 		}
@@ -57,8 +62,7 @@ namespace hbm {
 			}
 
 			if (erradapt == ERROR_SUCCESS) {
-				std::lock_guard < std::mutex > lock(m_adaptersMtx);
-				m_adapters.clear();
+				std::shared_ptr < tAdapters > pAdapters(new tAdapters());
 				// initialize the pointer we use the move through
 				// the list.
 				pNextAd = pAdptInfo;
@@ -112,13 +116,14 @@ namespace hbm {
 					if (addressWithNetmask.address != "0.0.0.0") { // HBM only wants connected Interfaces to be enumerated
 
 						Adapt.m_name = pNextAd->Description;
-						m_adapters[adapterIndex] = Adapt;
+						(*pAdapters)[adapterIndex] = Adapt;
 					}
 
 					// move forward to the next adapter in the list so
 					// that we can collect its information.
 					pNextAd = pNextAd->Next;
 				}
+				publish(pAdapters);
 			}
 
 			// free any memory we allocated from the heap before exit.
@@ -191,7 +196,8 @@ namespace hbm {
 			sa_family_t family;
 			char buf[INET6_ADDRSTRLEN];
 
-			tAdapters adapterMap;
+			std::shared_ptr < tAdapters > pAdapters(new tAdapters());
+			tAdapters& adapterMap = *pAdapters;
 
 			if (::getifaddrs(&interfaces) < 0) {
 				::syslog(LOG_ERR, "Error calling getifaddrs!");
@@ -262,28 +268,89 @@ namespace hbm {
 				interface = interface->ifa_next;
 			}
 
-			{
-				std::lock_guard < std::mutex > lock(m_adaptersMtx);
-				m_adapters = adapterMap;
-			}
+			publish(pAdapters);
 
 			::freeifaddrs(interfaces);
 		}
 	#endif
 
+		/// \return false if the address is known already
+		template < typename addresses_t, typename address_t >
+		static bool insertAddress(addresses_t& addresses, const address_t& address)
+		{
+			for (typename addresses_t::iterator iter = addresses.begin(); iter != addresses.end(); ++iter) {
+				if (iter->address==address.address) {
+					// netmask or prefix might have changed
+					if (iter->equal(address)) {
+						return false;
+					}
+					*iter = address;
+					return true;
+				}
+			}
+			addresses.push_back(address);
+			return true;
+		}
+
+		/// \return false if there is no such address
+		template < typename addresses_t >
+		static bool eraseAddress(addresses_t& addresses, const std::string& address)
+		{
+			for (typename addresses_t::iterator iter = addresses.begin(); iter != addresses.end(); ++iter) {
+				if (iter->address==address) {
+					addresses.erase(iter);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void NetadapterList::publish(const std::shared_ptr < tAdapters >& pAdapters)
+		{
+			std::shared_ptr < tInterfaceIdentities > pIdentities(new tInterfaceIdentities());
+			for (tAdapters::const_iterator iter = pAdapters->begin(); iter != pAdapters->end(); ++iter) {
+				interfaceIdentity_t& identity = (*pIdentities)[iter->first];
+				identity.name = iter->second.getName();
+				const addressesWithNetmask_t& addresses = iter->second.getIpv4Addresses();
+				if (addresses.empty()==false) {
+					identity.ipv4Address = addresses.front().address;
+				}
+			}
+			// readers holding the previous snapshots keep them until they let go
+			std::atomic_store(&m_adapters, tAdaptersPtr(pAdapters));
+			std::atomic_store(&m_interfaceIdentities, tInterfaceIdentitiesPtr(pIdentities));
+			++m_generation;
+		}
+
+		void NetadapterList::publishAdapter(const Netadapter& adapter)
+		{
+			std::shared_ptr < tAdapters > pAdapters(new tAdapters(*getAdapters()));
+			(*pAdapters)[adapter.getIndex()] = adapter;
+			publish(pAdapters);
+		}
+
+		NetadapterList::tAdaptersPtr NetadapterList::getAdapters() const
+		{
+			return std::atomic_load(&m_adapters);
+		}
+
+		NetadapterList::tInterfaceIdentitiesPtr NetadapterList::getInterfaceIdentities() const
+		{
+			return std::atomic_load(&m_interfaceIdentities);
+		}
+
 		NetadapterList::tAdapters NetadapterList::get() const
 		{
-			std::lock_guard < std::mutex > lock(m_adaptersMtx);
-			return m_adapters;
+			return *getAdapters();
 		}
 
 		NetadapterList::tAdapterArray NetadapterList::getArray() const
 		{
-			std::lock_guard < std::mutex > lock(m_adaptersMtx);
+			tAdaptersPtr pAdapters = getAdapters();
 			tAdapterArray result;
-			result.reserve(m_adapters.size());
+			result.reserve(pAdapters->size());
 
-			for(tAdapters::const_iterator iter = m_adapters.begin(); iter!=m_adapters.end(); ++iter) {
+			for(tAdapters::const_iterator iter = pAdapters->begin(); iter!=pAdapters->end(); ++iter) {
 				result.push_back(iter->second);
 			}
 
@@ -292,9 +359,9 @@ namespace hbm {
 
 		Netadapter NetadapterList::getAdapterByName(const std::string& adapterName) const
 		{
-			std::lock_guard < std::mutex > lock(m_adaptersMtx);
+			tAdaptersPtr pAdapters = getAdapters();
 
-			for (tAdapters::const_iterator iter = m_adapters.begin(); iter != m_adapters.end(); ++iter) {
+			for (tAdapters::const_iterator iter = pAdapters->begin(); iter != pAdapters->end(); ++iter) {
 				if (iter->second.getName().compare(adapterName) == 0) {
 					return iter->second;
 				}
@@ -306,10 +373,10 @@ namespace hbm {
 
 		Netadapter NetadapterList::getAdapterByInterfaceIndex(unsigned int interfaceIndex) const
 		{
-			std::lock_guard < std::mutex > lock(m_adaptersMtx);
+			tAdaptersPtr pAdapters = getAdapters();
 
-			tAdapters::const_iterator iter = m_adapters.find(interfaceIndex);
-			if(iter==m_adapters.end()) {
+			tAdapters::const_iterator iter = pAdapters->find(interfaceIndex);
+			if(iter==pAdapters->end()) {
 				throw hbm::exception::exception("invalid interface");
 			}
 
@@ -318,8 +385,105 @@ namespace hbm {
 
 		void NetadapterList::update()
 		{
+			std::lock_guard < std::mutex > lock(m_updateMtx);
 			enumAdapters();
 		}
+
+		void NetadapterList::addIpv4Address(unsigned int interfaceIndex, const ipv4Address_t& address)
+		{
+			std::lock_guard < std::mutex > lock(m_updateMtx);
+			tAdaptersPtr pAdapters = getAdapters();
+			tAdapters::const_iterator iter = pAdapters->find(interfaceIndex);
+			if (iter==pAdapters->end()) {
+				return;
+			}
+
+			Netadapter adapter = iter->second;
+			if (insertAddress(adapter.m_ipv4Addresses, address)) {
+				publishAdapter(adapter);
+			}
+		}
+
+		void NetadapterList::removeIpv4Address(unsigned int interfaceIndex, const std::string& address)
+		{
+			std::lock_guard < std::mutex > lock(m_updateMtx);
+			tAdaptersPtr pAdapters = getAdapters();
+			tAdapters::const_iterator iter = pAdapters->find(interfaceIndex);
+			if (iter==pAdapters->end()) {
+				return;
+			}
+
+			Netadapter adapter = iter->second;
+			if (eraseAddress(adapter.m_ipv4Addresses, address)) {
+				publishAdapter(adapter);
+			}
+		}
+
+		void NetadapterList::addIpv6Address(unsigned int interfaceIndex, const ipv6Address_t& address)
+		{
+			std::lock_guard < std::mutex > lock(m_updateMtx);
+			tAdaptersPtr pAdapters = getAdapters();
+			tAdapters::const_iterator iter = pAdapters->find(interfaceIndex);
+			if (iter==pAdapters->end()) {
+				return;
+			}
+
+			// IPv6 addresses are announced again each time their lifetime gets refreshed. Those are no changes.
+			Netadapter adapter = iter->second;
+			if (insertAddress(adapter.m_ipv6Addresses, address)) {
+				publishAdapter(adapter);
+			}
+		}
+
+		void NetadapterList::removeIpv6Address(unsigned int interfaceIndex, const std::string& address)
+		{
+			std::lock_guard < std::mutex > lock(m_updateMtx);
+			tAdaptersPtr pAdapters = getAdapters();
+			tAdapters::const_iterator iter = pAdapters->find(interfaceIndex);
+			if (iter==pAdapters->end()) {
+				return;
+			}
+
+			Netadapter adapter = iter->second;
+			if (eraseAddress(adapter.m_ipv6Addresses, address)) {
+				publishAdapter(adapter);
+			}
+		}
+
+		bool NetadapterList::updateAdapter(unsigned int interfaceIndex, const std::string& name, bool usable)
+		{
+			if (usable==false) {
+				removeAdapter(interfaceIndex);
+				return true;
+			}
+
+			std::lock_guard < std::mutex > lock(m_updateMtx);
+			tAdaptersPtr pAdapters = getAdapters();
+			tAdapters::const_iterator iter = pAdapters->find(interfaceIndex);
+			if (iter==pAdapters->end()) {
+				return false;
+			}
+
+			if (iter->second.getName()!=name) {
+				Netadapter adapter = iter->second;
+				adapter.m_name = name;
+				publishAdapter(adapter);
+			}
+			return true;
+		}
+
+		void NetadapterList::removeAdapter(unsigned int interfaceIndex)
+		{
+			std::lock_guard < std::mutex > lock(m_updateMtx);
+			tAdaptersPtr pAdapters = getAdapters();
+			if (pAdapters->find(interfaceIndex)==pAdapters->end()) {
+				return;
+			}
+
+			std::shared_ptr < tAdapters > pChanged(new tAdapters(*pAdapters));
+			pChanged->erase(interfaceIndex);
+			publish(pChanged);
+		}
 	}
 }
 
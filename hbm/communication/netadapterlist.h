@@ -7,8 +7,12 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <mutex>
+#include <atomic>
+#include <stdint.h>
 
 #include "netadapter.h"
 
@@ -21,9 +25,29 @@ namespace hbm {
 			/// interface index is the key
 			typedef std::map < unsigned int, Netadapter > tAdapters;
 			typedef std::vector < Netadapter > tAdapterArray;
+			typedef std::shared_ptr < const tAdapters > tAdaptersPtr;
+
+			/// what the receive path needs to know about an interface
+			struct interfaceIdentity_t {
+				std::string name;
+				/// the first IPv4 address of the interface, empty if there is none
+				std::string ipv4Address;
+			};
+
+			/// interface index is the key
+			typedef std::unordered_map < unsigned int, interfaceIdentity_t > tInterfaceIdentities;
+			typedef std::shared_ptr < const tInterfaceIdentities > tInterfaceIdentitiesPtr;
 
 			NetadapterList();
 
+			/// \brief all adapters.
+			/// Updating replaces the snapshot as a whole. A snapshot never changes. Hence it might be kept and read without any locking.
+			/// Getting it takes no lock and copies nothing.
+			/// \return never NULL
+			tAdaptersPtr getAdapters() const;
+
+			/// \return copy of all adapters
+			/// \see getAdapters()
 			tAdapters get() const;
 
 			/// the same order as returned by get()
@@ -36,14 +60,51 @@ namespace hbm {
 			/// \throws hbm::exception
 			Netadapter getAdapterByInterfaceIndex(unsigned int interfaceIndex) const;
 
+			/// \brief name and first IPv4 address of all interfaces.
+			/// The snapshot is replaced on update and never changes afterwards. Hence it might be kept and read without any locking.
+			/// Getting it takes no lock and copies nothing.
+			/// \return never NULL
+			tInterfaceIdentitiesPtr getInterfaceIdentities() const;
+
+			/// complete enumeration of all adapters
 			void update();
 
+			/// \brief incremental updates as told by the operating system (netlink under Linux).
+			/// Addresses of interfaces not known are ignored. Those interfaces are not up.
+			/// A new snapshot is published only if something did change.
+			void addIpv4Address(unsigned int interfaceIndex, const ipv4Address_t& address);
+			void removeIpv4Address(unsigned int interfaceIndex, const std::string& address);
+			void addIpv6Address(unsigned int interfaceIndex, const ipv6Address_t& address);
+			void removeIpv6Address(unsigned int interfaceIndex, const std::string& address);
+
+			/// \param usable false if the interface is down, a loopback or does not support broadcast. It is removed then.
+			/// \return false if the interface is usable but not known. Its addresses are not known either. Call update() then.
+			bool updateAdapter(unsigned int interfaceIndex, const std::string& name, bool usable);
+
+			void removeAdapter(unsigned int interfaceIndex);
+
+			/// incremented on each update. Anything derived from the adapters (i.e. cached names) is outdated if it changed.
+			uint64_t getGeneration() const
+			{
+				return m_generation;
+			}
+
 		private:
 
 			void enumAdapters();
 
-			tAdapters m_adapters;
-			mutable std::mutex m_adaptersMtx;
+			/// replaces the snapshots and increments the generation
+			void publish(const std::shared_ptr < tAdapters >& pAdapters);
+
+			/// publishes a copy of the current adapters with one adapter replaced. To be called with m_updateMtx locked.
+			void publishAdapter(const Netadapter& adapter);
+
+			/// snapshots, only to be accessed by std::atomic_load() and std::atomic_store()
+			tAdaptersPtr m_adapters;
+			tInterfaceIdentitiesPtr m_interfaceIdentities;
+			/// one update at a time. Otherwise an older enumeration might replace a newer one.
+			std::mutex m_updateMtx;
+			std::atomic < uint64_t > m_generation;
 		};
 	}
 }
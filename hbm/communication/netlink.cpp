@@ -0,0 +1,43 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+
+#include <chrono>
+#include <functional>
+
+#include "hbm/communication/netlink.h"
+
+// the parts common to all platforms
+
+namespace hbm {
+	const std::chrono::milliseconds Netlink::DEFAULT_DEBOUNCE_TIME(100);
+
+	void Netlink::scheduleChange(bool resync)
+	{
+		if (resync) {
+			m_resyncPending = true;
+		}
+		if (m_changePending) {
+			// the change will be told together with the others of this burst
+			return;
+		}
+		m_changePending = true;
+		m_debounceTimer.set(m_debounceTime, false, std::bind(&Netlink::debounceTimerCb, this, std::placeholders::_1));
+	}
+
+	void Netlink::debounceTimerCb(bool fired)
+	{
+		if (fired==false) {
+			return;
+		}
+		m_changePending = false;
+		if (m_resyncPending) {
+			m_resyncPending = false;
+			m_netadapterlist.update();
+		}
+		if (m_eventHandler) {
+			m_eventHandler(COMPLETE);
+		}
+	}
+}
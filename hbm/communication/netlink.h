@@ -5,27 +5,30 @@
 #ifndef _NETLINK_H
 #define _NETLINK_H
 
+#include <chrono>
 #include <functional>
 
 #include "hbm/exception/exception.hpp"
 #include "hbm/communication/netadapterlist.h"
 #include "hbm/sys/defines.h"
 #include "hbm/sys/eventloop.h"
+#include "hbm/sys/timer.h"
+
+#ifndef _WIN32
+struct nlmsghdr;
+#endif
 
 namespace hbm {
 	class Netlink {
 	public:
 		enum event_t {
-			/// not supported under Windows
-			NEW,
-			/// not supported under Windows
-			DEL,
 			/// happens on initial start.
-			/// windows version does not tell what happened it always sends COMPLETE to tell that something has happened.
+			/// Afterwards it tells that the netadapter list did change. All changes happening within the debounce time are told at once.
 			COMPLETE
 		};
 
-		typedef std::function < void(event_t event, unsigned int adapterIndex, const std::string& ipv4Address) > cb_t;
+		/// single interfaces are not told. Compare the netadapter list with what is known already.
+		typedef std::function < void(event_t event) > cb_t;
 
 		/// \throws hbm::exception
 		Netlink(communication::NetadapterList &netadapterlist, sys::EventLoop &eventLoop);
@@ -36,9 +39,24 @@ namespace hbm {
 
 		int stop();
 
+		/// an interface flap causes a burst of events. They are told at once after this time.
+		static const std::chrono::milliseconds DEFAULT_DEBOUNCE_TIME;
+
+		/// changes are told after this time has elapsed since the first change of a burst
+		void setDebounceTime(std::chrono::milliseconds debounceTime)
+		{
+			m_debounceTime = debounceTime;
+		}
+
 	private:
 		ssize_t process();
 
+		/// arms the debounce timer unless it is running already
+		/// \param resync true if the netadapter list is to be enumerated completely before telling the change
+		void scheduleChange(bool resync);
+
+		void debounceTimerCb(bool fired);
+
 #ifdef _WIN32
 		OVERLAPPED m_overlap;
 #else
@@ -47,7 +65,13 @@ namespace hbm {
 		/// receive events from netlink. Adapt netadapter list and mulicast server accordingly
 		/// \param[in, out] netadapterlist will be adapted when processing netlink events
 		/// \param[in, out] mcs will be adapted when processing netlink events
-		void processNetlinkTelegram(void *pReadBuffer, size_t bufferSize) const;
+		void processNetlinkTelegram(void *pReadBuffer, size_t bufferSize);
+
+		/// RTM_NEWLINK, RTM_DELLINK: the netadapter list is changed directly. An interface coming up requires a complete enumeration.
+		void processLinkMessage(const struct nlmsghdr* pHeader);
+
+		/// RTM_NEWADDR, RTM_DELADDR: the address is added to or removed from the netadapter list directly
+		void processAddressMessage(const struct nlmsghdr* pHeader) const;
 
 		event m_fd;
 #endif
@@ -55,6 +79,13 @@ namespace hbm {
 
 		sys::EventLoop& m_eventloop;
 		cb_t m_eventHandler;
+
+		sys::Timer m_debounceTimer;
+		std::chrono::milliseconds m_debounceTime;
+		/// the debounce timer is running
+		bool m_changePending;
+		/// the netadapter list is to be enumerated completely when the debounce timer fires
+		bool m_resyncPending;
 	};
 }
 #endif
@@ -13,6 +13,11 @@
 #include <thread>
 #include <chrono>
 #include <functional>
+#include <set>
+
+#ifndef _WIN32
+#include <net/if.h>
+#endif
 
 #include <boost/test/unit_test.hpp>
 
@@ -97,3 +102,192 @@ BOOST_AUTO_TEST_CASE(start_send_stop_test)
 
 	std::cout << __FUNCTION__ << " done" << std::endl;
 }
+
+BOOST_AUTO_TEST_CASE(receive_buffer_size_test)
+{
+	static const char MULTICASTGROUP[] = "239.255.77.177";
+	static const unsigned int UDP_PORT = 22222;
+	static const int RECEIVE_BUFFER_SIZE = 4096;
+
+	hbm::sys::EventLoop eventloop;
+	hbm::communication::NetadapterList adapters;
+	hbm::communication::MulticastServer mcsReceiver(adapters, eventloop);
+
+	BOOST_CHECK_EQUAL(mcsReceiver.getReceiveBufferSize(), -1);
+
+	mcsReceiver.setReceiveBufferSize(RECEIVE_BUFFER_SIZE);
+	mcsReceiver.start(MULTICASTGROUP, UDP_PORT, std::bind(&receiveAndDiscard, std::placeholders::_1));
+	// the kernel might round up and adds room for its bookkeeping
+	BOOST_CHECK_GE(mcsReceiver.getReceiveBufferSize(), RECEIVE_BUFFER_SIZE);
+	BOOST_CHECK_EQUAL(mcsReceiver.getKernelDropCount(), 0);
+	mcsReceiver.stop();
+	BOOST_CHECK_EQUAL(mcsReceiver.getReceiveBufferSize(), -1);
+}
+
+BOOST_AUTO_TEST_CASE(update_interfaces_test)
+{
+	static const char MULTICASTGROUP[] = "239.255.77.177";
+	static const unsigned int UDP_PORT = 22222;
+	static const char LOOPBACK[] = "127.0.0.1";
+
+	hbm::sys::EventLoop eventloop;
+	hbm::communication::NetadapterList adapters;
+	hbm::communication::MulticastServer mcsReceiver(adapters, eventloop);
+
+	mcsReceiver.start(MULTICASTGROUP, UDP_PORT, std::bind(&receiveAndDiscard, std::placeholders::_1));
+	BOOST_CHECK(mcsReceiver.getInterfaces().empty());
+
+	hbm::communication::MulticastServer::interfaceAddresses_t interfaceAddresses;
+	interfaceAddresses.insert(LOOPBACK);
+	// not an address, the group can not be joined via it
+	interfaceAddresses.insert("no address");
+	mcsReceiver.updateInterfaces(interfaceAddresses);
+	hbm::communication::MulticastServer::interfaceAddresses_t memberships = mcsReceiver.getInterfaces();
+	BOOST_CHECK_EQUAL(memberships.size(), 1);
+	BOOST_CHECK_EQUAL(memberships.count(LOOPBACK), 1);
+
+	// joining again is no error
+	BOOST_CHECK_EQUAL(mcsReceiver.addInterface(LOOPBACK), 0);
+	BOOST_CHECK_EQUAL(mcsReceiver.getInterfaces().size(), 1);
+
+	mcsReceiver.updateInterfaces(hbm::communication::MulticastServer::interfaceAddresses_t());
+	BOOST_CHECK(mcsReceiver.getInterfaces().empty());
+
+	mcsReceiver.addInterface(LOOPBACK);
+	mcsReceiver.stop();
+	BOOST_CHECK(mcsReceiver.getInterfaces().empty());
+}
+
+BOOST_AUTO_TEST_CASE(add_drop_all_interfaces_test)
+{
+	static const char MULTICASTGROUP[] = "239.255.77.177";
+	static const unsigned int UDP_PORT = 22222;
+	static const char LOOPBACK[] = "127.0.0.1";
+
+	hbm::sys::EventLoop eventloop;
+	hbm::communication::NetadapterList adapters;
+	hbm::communication::MulticastServer mcsReceiver(adapters, eventloop);
+
+	// not started yet
+	BOOST_CHECK_EQUAL(mcsReceiver.addInterface(LOOPBACK), -1);
+	BOOST_CHECK(mcsReceiver.getInterfaces().empty());
+
+	mcsReceiver.start(MULTICASTGROUP, UDP_PORT, std::bind(&receiveAndDiscard, std::placeholders::_1));
+	mcsReceiver.addInterface(LOOPBACK);
+	mcsReceiver.addAllInterfaces();
+	hbm::communication::MulticastServer::interfaceAddresses_t memberships = mcsReceiver.getInterfaces();
+	BOOST_CHECK_EQUAL(memberships.count(LOOPBACK), 1);
+
+	// nothing changed
+	mcsReceiver.addAllInterfaces();
+	BOOST_CHECK(mcsReceiver.getInterfaces()==memberships);
+
+	// leaves the group via interfaces that are not in the netadapter list as well
+	mcsReceiver.dropAllInterfaces();
+	BOOST_CHECK(mcsReceiver.getInterfaces().empty());
+	mcsReceiver.stop();
+}
+
+BOOST_AUTO_TEST_CASE(send_over_interface_test)
+{
+	static const char MULTICASTGROUP[] = "239.255.77.178";
+	static const unsigned int UDP_PORT = 22223;
+	static const char LOOPBACK[] = "127.0.0.1";
+	static const std::string MSG = "testest";
+	// 0 keeps the datagram on this host
+	static const unsigned int TTLS[] = { 1, 1, 2, 0, 1 };
+
+	hbm::sys::EventLoop eventloop;
+	hbm::communication::NetadapterList adapters;
+	hbm::communication::MulticastServer mcsReceiver(adapters, eventloop);
+	hbm::communication::MulticastServer mcsSender(adapters, eventloop);
+
+	mcsReceiver.setReceiveAllMemberships(false);
+	mcsReceiver.start(MULTICASTGROUP, UDP_PORT, std::bind(&receiveAndDiscard, std::placeholders::_1));
+	BOOST_CHECK_EQUAL(mcsReceiver.addInterface(LOOPBACK), 0);
+
+	mcsSender.setMulticastLoop(true);
+	mcsSender.start(MULTICASTGROUP, UDP_PORT, hbm::communication::MulticastServer::DataHandler_t());
+
+	BOOST_CHECK_EQUAL(mcsSender.sendOverInterfaceByAddress("no address", MSG), hbm::communication::ERR_INVALIDIPADDRESS);
+	BOOST_CHECK_EQUAL(mcsSender.sendOverInterfaceByAddress(LOOPBACK, MSG, hbm::communication::MAX_TTL+1), hbm::communication::ERR_NO_SUCCESS);
+	BOOST_CHECK_EQUAL(mcsSender.send(MSG, hbm::communication::MAX_TTL+1), hbm::communication::ERR_NO_SUCCESS);
+
+	// the ttl is changed back and forth
+	for (unsigned int i = 0; i < sizeof(TTLS)/sizeof(TTLS[0]); ++i) {
+		BOOST_CHECK_EQUAL(mcsSender.sendOverInterfaceByAddress(LOOPBACK, MSG, TTLS[i]), 0);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	// the datagrams went out via the selected interface
+	for (unsigned int i = 0; i < sizeof(TTLS)/sizeof(TTLS[0]); ++i) {
+		char buf[1024];
+		int adapterIndex = 0;
+		int ttl = 0;
+		ssize_t result = mcsReceiver.receiveTelegram(buf, sizeof(buf), adapterIndex, ttl);
+		BOOST_REQUIRE_EQUAL(result, static_cast < ssize_t > (MSG.length()));
+		BOOST_CHECK(MSG==std::string(buf, result));
+#ifndef _WIN32
+		BOOST_CHECK_EQUAL(adapterIndex, static_cast < int > (if_nametoindex("lo")));
+#endif
+	}
+	// all control messages fit
+	BOOST_CHECK_EQUAL(mcsReceiver.getControlTruncatedCount(), 0);
+
+	mcsSender.stop();
+	mcsReceiver.stop();
+}
+
+BOOST_AUTO_TEST_CASE(send_fan_out_test)
+{
+	static const char MULTICASTGROUP[] = "239.255.77.179";
+	static const unsigned int UDP_PORT = 22224;
+	static const std::string MSG = "testest";
+
+	hbm::sys::EventLoop eventloop;
+	hbm::communication::NetadapterList adapters;
+	hbm::communication::MulticastServer mcsReceiver(adapters, eventloop);
+	hbm::communication::MulticastServer mcsSender(adapters, eventloop);
+
+	mcsReceiver.setReceiveAllMemberships(false);
+	mcsReceiver.start(MULTICASTGROUP, UDP_PORT, std::bind(&receiveAndDiscard, std::placeholders::_1));
+	mcsReceiver.addAllInterfaces();
+
+	mcsSender.setMulticastLoop(true);
+	mcsSender.start(MULTICASTGROUP, UDP_PORT, hbm::communication::MulticastServer::DataHandler_t());
+
+	hbm::communication::interfaceSendResults_t results;
+	mcsSender.send(MSG.c_str(), MSG.length(), 1, results);
+
+	hbm::communication::NetadapterList::tAdaptersPtr pAdapters = adapters.getAdapters();
+	// the number of memberships is limited by the system
+	hbm::communication::MulticastServer::interfaceAddresses_t memberships = mcsReceiver.getInterfaces();
+	BOOST_CHECK_EQUAL(results.size(), pAdapters->size());
+	size_t expected = 0;
+	for (hbm::communication::interfaceSendResults_t::const_iterator iter = results.begin(); iter != results.end(); ++iter) {
+		hbm::communication::NetadapterList::tAdapters::const_iterator adapter = pAdapters->find(iter->adapterIndex);
+		BOOST_REQUIRE(adapter!=pAdapters->end());
+		if (adapter->second.getIpv4Addresses().empty()) {
+			BOOST_CHECK_EQUAL(iter->result, hbm::communication::ERR_INVALIDADAPTER);
+		} else {
+			BOOST_CHECK_EQUAL(iter->result, hbm::communication::ERR_SUCCESS);
+			expected += memberships.count(adapter->second.getIpv4Addresses().front().address);
+		}
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	// one datagram per interface
+	std::set < int > receivedVia;
+	for (size_t i = 0; i < expected; ++i) {
+		char buf[1024];
+		int adapterIndex = 0;
+		int ttl = 0;
+		ssize_t result = mcsReceiver.receiveTelegram(buf, sizeof(buf), adapterIndex, ttl);
+		BOOST_REQUIRE_EQUAL(result, static_cast < ssize_t > (MSG.length()));
+		receivedVia.insert(adapterIndex);
+	}
+	BOOST_CHECK_EQUAL(receivedVia.size(), expected);
+
+	mcsSender.stop();
+	mcsReceiver.stop();
+}
@@ -13,6 +13,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include "hbm/communication/netadapter.h"
+#include "hbm/communication/netadapterlist.h"
 
 BOOST_AUTO_TEST_CASE(check_valid_ipaddresses_test)
 {
@@ -40,3 +41,96 @@ BOOST_AUTO_TEST_CASE(check_forbidden_ipaddresses_test)
 	result = hbm::communication::Netadapter::isValidManualIpV4Address("254.4.7.1"); // experimental
 	BOOST_CHECK_EQUAL(result, false);
 }
+
+
+BOOST_AUTO_TEST_CASE(interface_identities_test)
+{
+	hbm::communication::NetadapterList adapterList;
+	hbm::communication::NetadapterList::tInterfaceIdentitiesPtr pIdentities = adapterList.getInterfaceIdentities();
+	hbm::communication::NetadapterList::tAdapters adapters = adapterList.get();
+	BOOST_CHECK_EQUAL(pIdentities->size(), adapters.size());
+	for (hbm::communication::NetadapterList::tAdapters::const_iterator iter = adapters.begin(); iter != adapters.end(); ++iter) {
+		hbm::communication::NetadapterList::tInterfaceIdentities::const_iterator identity = pIdentities->find(iter->first);
+		BOOST_REQUIRE(identity!=pIdentities->end());
+		BOOST_CHECK_EQUAL(identity->second.name, iter->second.getName());
+	}
+
+	// an update publishes a new snapshot. The one held stays untouched.
+	uint64_t generation = adapterList.getGeneration();
+	adapterList.update();
+	BOOST_CHECK(adapterList.getGeneration()!=generation);
+	BOOST_CHECK(adapterList.getInterfaceIdentities()!=pIdentities);
+	BOOST_CHECK_EQUAL(pIdentities->size(), adapters.size());
+}
+
+BOOST_AUTO_TEST_CASE(adapter_snapshot_test)
+{
+	hbm::communication::NetadapterList adapterList;
+
+	// nothing is copied as long as nothing gets updated
+	hbm::communication::NetadapterList::tAdaptersPtr pAdapters = adapterList.getAdapters();
+	BOOST_CHECK(adapterList.getAdapters()==pAdapters);
+	BOOST_CHECK_EQUAL(adapterList.get().size(), pAdapters->size());
+	BOOST_CHECK_EQUAL(adapterList.getArray().size(), pAdapters->size());
+
+	// the snapshot held stays valid after the update
+	adapterList.update();
+	BOOST_CHECK(adapterList.getAdapters()!=pAdapters);
+	for (hbm::communication::NetadapterList::tAdapters::const_iterator iter = pAdapters->begin(); iter != pAdapters->end(); ++iter) {
+		BOOST_CHECK_EQUAL(adapterList.getAdapterByInterfaceIndex(iter->first).getName(), iter->second.getName());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(incremental_update_test)
+{
+	static const unsigned int unknownIndex = 0xffffff;
+	hbm::communication::NetadapterList adapterList;
+
+	// an interface coming up requires a complete enumeration
+	BOOST_CHECK_EQUAL(adapterList.updateAdapter(unknownIndex, "unknown", true), false);
+	BOOST_CHECK_EQUAL(adapterList.updateAdapter(unknownIndex, "unknown", false), true);
+
+	hbm::communication::NetadapterList::tAdaptersPtr pAdapters = adapterList.getAdapters();
+	if (pAdapters->empty()) {
+		BOOST_TEST_MESSAGE("no interface to test with");
+		return;
+	}
+	unsigned int interfaceIndex = pAdapters->begin()->first;
+
+	hbm::communication::ipv4Address_t address;
+	address.address = "172.31.255.254";
+	address.netmask = "255.255.0.0";
+	adapterList.addIpv4Address(interfaceIndex, address);
+	hbm::communication::NetadapterList::tAdaptersPtr pChanged = adapterList.getAdapters();
+	const hbm::communication::addressesWithNetmask_t& addresses = pChanged->at(interfaceIndex).getIpv4Addresses();
+	BOOST_CHECK_EQUAL(addresses.size(), pAdapters->at(interfaceIndex).getIpv4Addresses().size()+1);
+	BOOST_CHECK_EQUAL(addresses.back().address, address.address);
+
+	// nothing changed, nothing published
+	uint64_t generation = adapterList.getGeneration();
+	adapterList.addIpv4Address(interfaceIndex, address);
+	adapterList.addIpv4Address(unknownIndex, address);
+	BOOST_CHECK_EQUAL(adapterList.getGeneration(), generation);
+
+	adapterList.removeIpv4Address(interfaceIndex, address.address);
+	BOOST_CHECK_EQUAL(adapterList.getAdapters()->at(interfaceIndex).getIpv4Addresses().size(), pAdapters->at(interfaceIndex).getIpv4Addresses().size());
+
+	hbm::communication::ipv6Address_t ipv6Address;
+	ipv6Address.address = "fd00::1";
+	ipv6Address.prefix = 64;
+	adapterList.addIpv6Address(interfaceIndex, ipv6Address);
+	BOOST_CHECK_EQUAL(adapterList.getAdapters()->at(interfaceIndex).getIpv6Addresses().back().address, ipv6Address.address);
+	adapterList.removeIpv6Address(interfaceIndex, ipv6Address.address);
+	BOOST_CHECK_EQUAL(adapterList.getAdapters()->at(interfaceIndex).getIpv6Addresses().size(), pAdapters->at(interfaceIndex).getIpv6Addresses().size());
+
+	BOOST_CHECK_EQUAL(adapterList.updateAdapter(interfaceIndex, "renamed", true), true);
+	BOOST_CHECK_EQUAL(adapterList.getAdapterByInterfaceIndex(interfaceIndex).getName(), "renamed");
+	BOOST_CHECK_EQUAL(adapterList.getInterfaceIdentities()->at(interfaceIndex).name, "renamed");
+
+	// going down removes the interface
+	BOOST_CHECK_EQUAL(adapterList.updateAdapter(interfaceIndex, "renamed", false), true);
+	BOOST_CHECK(adapterList.getAdapters()->find(interfaceIndex)==adapterList.getAdapters()->end());
+
+	// the snapshot held did not change
+	BOOST_CHECK_EQUAL(pAdapters->at(interfaceIndex).getIpv4Addresses().size(), addresses.size()-1);
+}
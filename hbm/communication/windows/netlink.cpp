@@ -6,7 +6,9 @@
 #include <WinSock2.h>
 #include <IPHlpApi.h>
 
+#include <chrono>
 #include <cstring>
+#include <functional>
 
 #include "hbm/communication/netlink.h"
 #include "hbm/exception/exception.hpp"
@@ -16,6 +18,11 @@ namespace hbm {
 	Netlink::Netlink(communication::NetadapterList &netadapterlist, sys::EventLoop &eventLoop)
 		: m_netadapterlist(netadapterlist)
 		, m_eventloop(eventLoop)
+		, m_eventHandler()
+		, m_debounceTimer(eventLoop)
+		, m_debounceTime(DEFAULT_DEBOUNCE_TIME)
+		, m_changePending(false)
+		, m_resyncPending(false)
 	{
 		HANDLE handle = NULL;
 		m_overlap.hEvent = WSACreateEvent();
@@ -35,10 +42,8 @@ namespace hbm {
 
 	ssize_t Netlink::process()
 	{
-		m_netadapterlist.update();
-		if (m_eventHandler) {
-			m_eventHandler(COMPLETE, 0, "");
-		}
+		// we do not know what did change. The netadapter list is enumerated once when the burst of notifications is over.
+		scheduleChange(true);
 
 		HANDLE handle = NULL;
 		DWORD ret = NotifyAddrChange(&handle, &m_overlap);
@@ -55,7 +60,7 @@ namespace hbm {
 	{
 		m_eventHandler = eventHandler;
 		if (m_eventHandler) {
-			m_eventHandler(COMPLETE, 0, "");
+			m_eventHandler(COMPLETE);
 		}
 		m_eventloop.addEvent(m_overlap.hEvent, std::bind(&Netlink::process, this));
 		return 0;
@@ -63,6 +68,9 @@ namespace hbm {
 
 	int Netlink::stop()
 	{
+		m_debounceTimer.cancel();
+		m_changePending = false;
+		m_resyncPending = false;
 		m_eventloop.eraseEvent(m_overlap.hEvent);
 		return CloseHandle(m_overlap.hEvent);
 	}
@@ -0,0 +1,103 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "interner.h"
+
+namespace hbm {
+	namespace string {
+		const Interner::id_t Interner::NO_ID;
+
+		Interner::Interner()
+			: m_index()
+			, m_entries()
+			, m_freeIds()
+		{
+		}
+
+		uint64_t Interner::hash(const char* pString, size_t length)
+		{
+			// FNV-1a
+			uint64_t value = 14695981039346656037ULL;
+			for (size_t i = 0; i < length; ++i) {
+				value ^= static_cast < unsigned char > (pString[i]);
+				value *= 1099511628211ULL;
+			}
+			return value;
+		}
+
+		Interner::id_t Interner::find(const char* pString, size_t length) const
+		{
+			std::pair < index_t::const_iterator, index_t::const_iterator > range = m_index.equal_range(hash(pString, length));
+			for (index_t::const_iterator iter = range.first; iter != range.second; ++iter) {
+				const std::string& string = m_entries[iter->second].string;
+				if ((string.length()==length) && (memcmp(string.c_str(), pString, length)==0)) {
+					return iter->second;
+				}
+			}
+			return NO_ID;
+		}
+
+		Interner::id_t Interner::find(const std::string& string) const
+		{
+			return find(string.c_str(), string.length());
+		}
+
+		Interner::id_t Interner::acquire(const char* pString, size_t length)
+		{
+			id_t id = find(pString, length);
+			if (id!=NO_ID) {
+				++m_entries[id].referenceCount;
+				return id;
+			}
+
+			if (m_freeIds.empty()) {
+				id = static_cast < id_t > (m_entries.size());
+				m_entries.push_back(entry_t());
+			} else {
+				id = m_freeIds.back();
+				m_freeIds.pop_back();
+			}
+
+			entry_t& entry = m_entries[id];
+			entry.string.assign(pString, length);
+			entry.referenceCount = 1;
+			entry.hash = hash(pString, length);
+			m_index.insert(index_t::value_type(entry.hash, id));
+			return id;
+		}
+
+		Interner::id_t Interner::acquire(const std::string& string)
+		{
+			return acquire(string.c_str(), string.length());
+		}
+
+		void Interner::addReference(id_t id)
+		{
+			++m_entries[id].referenceCount;
+		}
+
+		void Interner::release(id_t id)
+		{
+			entry_t& entry = m_entries[id];
+			if (--entry.referenceCount>0) {
+				return;
+			}
+
+			std::pair < index_t::iterator, index_t::iterator > range = m_index.equal_range(entry.hash);
+			for (index_t::iterator iter = range.first; iter != range.second; ++iter) {
+				if (iter->second==id) {
+					m_index.erase(iter);
+					break;
+				}
+			}
+			// frees the memory of long strings
+			std::string().swap(entry.string);
+			m_freeIds.push_back(id);
+		}
+	}
+}
@@ -0,0 +1,86 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#ifndef __HBM__STRING__INTERNER_H
+#define __HBM__STRING__INTERNER_H
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace hbm {
+	namespace string {
+
+		/// \brief keeps one copy of each string and identifies it by a small number.
+		///
+		/// Comparing or hashing ids is much cheaper than doing so with the strings.
+		/// Each id is reference counted. The string is forgotten once the last reference is released. Its id is reused afterwards.
+		/// Looking up a string does not need a std::string. Hence, strings can be looked up directly in a receive buffer.
+		/// \warning not thread-safe!
+		class Interner
+		{
+		public:
+			typedef uint32_t id_t;
+
+			static const id_t NO_ID = 0xffffffff;
+
+			Interner();
+
+			/// adds the string if not known yet
+			/// \return id of the string. Its reference count is incremented.
+			id_t acquire(const char* pString, size_t length);
+			id_t acquire(const std::string& string);
+
+			/// increments the reference count of a known id
+			void addReference(id_t id);
+
+			/// decrements the reference count. The string is forgotten if there are no references left.
+			void release(id_t id);
+
+			/// the reference count is not changed
+			/// \return NO_ID if the string is not known
+			id_t find(const char* pString, size_t length) const;
+			id_t find(const std::string& string) const;
+
+			/// the string stays at the same address until it is forgotten
+			const std::string& getString(id_t id) const
+			{
+				return m_entries[id].string;
+			}
+
+			/// \return number of strings known
+			size_t size() const
+			{
+				return m_entries.size() - m_freeIds.size();
+			}
+
+		private:
+			struct entry_t {
+				std::string string;
+				/// 0 if the id is not in use
+				uint32_t referenceCount;
+				uint64_t hash;
+			};
+
+			/// the hash of the string is the key. Different strings might have the same hash.
+			typedef std::unordered_multimap < uint64_t, id_t > index_t;
+
+			/// elements of a deque do not move in memory when adding elements at the end
+			typedef std::deque < entry_t > entries_t;
+
+			static uint64_t hash(const char* pString, size_t length);
+
+			index_t m_index;
+			/// indexed by id
+			entries_t m_entries;
+			/// ids not in use
+			std::vector < id_t > m_freeIds;
+		};
+	}
+}
+
+#endif // __HBM__STRING__INTERNER_H
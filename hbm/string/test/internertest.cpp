@@ -0,0 +1,71 @@
+// Copyright 2014 Hottinger Baldwin Messtechnik
+// Distributed under MIT license
+// See file LICENSE provided
+
+#include <string>
+
+
+#ifndef _WIN32
+#define BOOST_TEST_DYN_LINK
+#endif
+#define BOOST_TEST_MODULE StringInternerTest
+#include <boost/test/unit_test.hpp>
+
+#include "../interner.h"
+
+
+namespace hbm {
+	namespace string {
+		namespace test {
+
+			BOOST_AUTO_TEST_CASE( test_case_same_string_same_id )
+			{
+				Interner interner;
+				Interner::id_t id = interner.acquire("eth0");
+				BOOST_CHECK_EQUAL(interner.acquire(std::string("eth0")), id);
+				BOOST_CHECK(interner.acquire("eth1")!=id);
+				BOOST_CHECK_EQUAL(interner.size(), 2);
+				BOOST_CHECK_EQUAL(interner.getString(id), "eth0");
+			}
+
+			BOOST_AUTO_TEST_CASE( test_case_find_in_buffer )
+			{
+				Interner interner;
+				Interner::id_t id = interner.acquire("0009E50013C3");
+				const char buffer[] = "\"uuid\":\"0009E50013C3\"";
+				BOOST_CHECK_EQUAL(interner.find(buffer+8, 12), id);
+				BOOST_CHECK_EQUAL(interner.find(buffer+8, 11), Interner::NO_ID);
+				BOOST_CHECK_EQUAL(interner.find(""), Interner::NO_ID);
+			}
+
+			BOOST_AUTO_TEST_CASE( test_case_reference_count )
+			{
+				Interner interner;
+				Interner::id_t id = interner.acquire("eth0");
+				interner.addReference(id);
+				interner.release(id);
+				BOOST_CHECK_EQUAL(interner.find("eth0"), id);
+
+				// the last reference is gone
+				interner.release(id);
+				BOOST_CHECK_EQUAL(interner.find("eth0"), Interner::NO_ID);
+				BOOST_CHECK_EQUAL(interner.size(), 0);
+
+				// the id gets reused
+				BOOST_CHECK_EQUAL(interner.acquire("eth1"), id);
+				BOOST_CHECK_EQUAL(interner.getString(id), "eth1");
+			}
+
+			BOOST_AUTO_TEST_CASE( test_case_stable_address )
+			{
+				Interner interner;
+				Interner::id_t id = interner.acquire("eth0");
+				const std::string* pString = &interner.getString(id);
+				for (unsigned int i=0; i<10000; ++i) {
+					interner.acquire(std::to_string(i));
+				}
+				BOOST_CHECK_EQUAL(&interner.getString(id), pString);
+			}
+		}
+	}
+}
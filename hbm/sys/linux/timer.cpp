@@ -74,6 +74,24 @@ namespace hbm {
 			return timerfd_settime(m_fd, 0, &timespec, nullptr);
 		}
 
+		int Timer::set(std::chrono::steady_clock::time_point deadline, Cb_t eventHandler)
+		{
+			// std::chrono::steady_clock is based on CLOCK_MONOTONIC, the clock used for our timer fd.
+			std::chrono::nanoseconds sinceEpoch = std::chrono::duration_cast < std::chrono::nanoseconds > (deadline.time_since_epoch());
+
+			struct itimerspec timespec;
+			memset (&timespec, 0, sizeof(timespec));
+			if (sinceEpoch.count()>0) {
+				timespec.it_value.tv_sec = sinceEpoch.count() / 1000000000;
+				timespec.it_value.tv_nsec = sinceEpoch.count() % 1000000000;
+			} else {
+				// zero would disarm the timer. Any point in time that has passed lets the timer fire immediately.
+				timespec.it_value.tv_nsec = 1;
+			}
+			m_eventHandler = eventHandler;
+			return timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &timespec, nullptr);
+		}
+
 		int Timer::cancel()
 		{
 			int retval = 0;
@@ -169,6 +169,32 @@ BOOST_AUTO_TEST_CASE(oneshottimer_test)
 	worker.join();
 }
 
+BOOST_AUTO_TEST_CASE(deadlinetimer_test)
+{
+	static const std::chrono::milliseconds timeToDeadline(100);
+	static const std::chrono::milliseconds duration(300);
+	hbm::sys::EventLoop eventLoop;
+
+	unsigned int counter = 0;
+	bool canceled = false;
+
+	hbm::sys::Timer timer(eventLoop);
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeToDeadline;
+	timer.set(deadline, std::bind(&timerEventHandlerIncrement, std::placeholders::_1, std::ref(counter), std::ref(canceled)));
+
+	// the timer fires once, not before the deadline
+	eventLoop.execute_for(timeToDeadline / 2);
+	BOOST_CHECK_EQUAL(counter, 0);
+	eventLoop.execute_for(duration);
+	BOOST_CHECK_EQUAL(counter, 1);
+
+	// a deadline that has already passed lets the timer fire immediately
+	timer.set(std::chrono::steady_clock::now() - timeToDeadline, std::bind(&timerEventHandlerIncrement, std::placeholders::_1, std::ref(counter), std::ref(canceled)));
+	eventLoop.execute_for(timeToDeadline);
+	BOOST_CHECK_EQUAL(counter, 2);
+	BOOST_CHECK_EQUAL(canceled, false);
+}
+
 BOOST_AUTO_TEST_CASE(cyclictimer_test)
 {
 	static const unsigned int excpectedMinimum = 10;
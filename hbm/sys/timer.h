@@ -33,6 +33,10 @@ namespace hbm {
 			int set(unsigned int period_ms, bool repeated, Cb_t eventHandler);
 			int set(std::chrono::milliseconds period, bool repeated, Cb_t eventHandler);
 
+			/// single shot timer firing at a point in time. If the point in time has already passed, the timer fires immediately.
+			/// @param deadline point in time when the timer is to fire
+			int set(std::chrono::steady_clock::time_point deadline, Cb_t eventHandler);
+
 			/// if timer is running, callback routine will be called with fired=false
 			/// \return 1 success, timer was running; 0 success
 			int cancel();
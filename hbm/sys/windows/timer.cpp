@@ -64,6 +64,18 @@ namespace hbm {
 			return 0;
 		}
 
+		int Timer::set(std::chrono::steady_clock::time_point deadline, Cb_t eventHandler)
+		{
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			unsigned int period_ms = 0;
+			if (deadline>now) {
+				// round up, we must not fire too early
+				std::chrono::microseconds timeToWait = std::chrono::duration_cast < std::chrono::microseconds > (deadline-now);
+				period_ms = static_cast < unsigned int > ((timeToWait.count()+999) / 1000);
+			}
+			return set(period_ms, false, eventHandler);
+		}
+
 		int Timer::process()
 		{
 			if (m_eventHandler) {